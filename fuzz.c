@@ -20,6 +20,37 @@ struct fuzz_type_info;
 #define AUTOSHRINK_ENV_TAG      0xa5
 #define AUTOSHRINK_BIT_POOL_TAG 'B'
 
+// Incremental 128-bit hash of whole words, for when the odds of a 64-bit
+// hash colliding are too high. Words are hashed in blocks of four; buf
+// holds a partial block.
+struct fuzz_hash128 {
+	uint64_t a;
+	uint64_t b;
+	uint64_t count;
+	uint64_t buf[4];
+	uint8_t  buffered;
+};
+
+void fuzz_hash128_init(struct fuzz_hash128* h);
+void fuzz_hash128_sink(
+		struct fuzz_hash128* h, const uint64_t* words, size_t count);
+void fuzz_hash128_finish(struct fuzz_hash128* h, uint64_t res[2]);
+
+// SIZE bits of a copy-on-write pool, starting at OFFSET, which are
+// base's bits starting at SRC.
+struct pool_span {
+	size_t offset;
+	size_t src;
+	size_t size;
+};
+
+// SIZE (at most 64) bits written to a copy-on-write pool at OFFSET.
+struct pool_patch {
+	size_t   offset;
+	uint8_t  size;
+	uint64_t bits;
+};
+
 struct autoshrink_bit_pool {
 	// Bits will always be rounded up to a multiple of 64 bits,
 	// and be aligned as a uint64_t.
@@ -27,6 +58,7 @@ struct autoshrink_bit_pool {
 	bool     shrinking;   // is this pool shrinking?
 	size_t   bits_filled; // how many bits are available
 	size_t   bits_ceil;   // ceiling for bit buffer
+	size_t   bits_alloc;  // bits allocated, at least bits_ceil
 	size_t   limit;       // after limit bytes, return 0
 
 	size_t    consumed;
@@ -35,7 +67,33 @@ struct autoshrink_bit_pool {
 	uint32_t* requests;
 
 	size_t  generation;
+	size_t  ddmin_chunk; // chunk deleted by ddmin, or DDMIN_NONE
 	size_t* index;
+	size_t  index_ceil;
+	bool    indexed; // is index built for the current requests?
+
+	// Hash of the consumed bits, sunk a whole word at a time as they
+	// are consumed. hash_words words are in hash_state; hash is the
+	// finished hash of all the consumed bits, while hash_cached is set.
+	struct fuzz_hash128 hash_state;
+	size_t              hash_words;
+	bool                hash_cached;
+	uint64_t            hash[2];
+
+	// Next pool in struct fuzz's list of spare pools.
+	struct autoshrink_bit_pool* next;
+
+	// Shrink candidates are copy-on-write: while base is set, the bits
+	// aren't in the bits buffer, but are the spans of base's bits, in
+	// order, followed by zeroes, with the patches written over them.
+	// They are only copied into bits when the candidate is committed.
+	const struct autoshrink_bit_pool* base;
+	struct pool_span*                 spans;
+	size_t                            span_count;
+	size_t                            span_ceil;
+	struct pool_patch*                patches;
+	size_t                            patch_count;
+	size_t                            patch_ceil;
 };
 
 // How large should the default autoshrink bit pool be?
@@ -44,12 +102,15 @@ struct autoshrink_bit_pool {
 // reallocs in quick succession.
 #define DEF_POOL_SIZE (64 * 8 * sizeof(uint64_t))
 
+// How many freed pools to keep for reuse, rather than freeing them.
+#define AUTOSHRINK_SPARE_POOLS 8
+
 // How large should the buffer for request sizes be by default?
 #define DEF_REQUESTS_CEIL2 4 // constrain to a power of 2
 #define DEF_REQUESTS_CEIL  (1 << DEF_REQUESTS_CEIL2)
 
-// Default: Decide we've reached a local minimum after
-// this many unsuccessful shrinks in a row.
+// Default: Decide we've reached a local minimum once fewer
+// than 1 in this many shrinks are succeeding.
 #define DEF_MAX_FAILED_SHRINKS 100
 
 // When attempting to drop records, default to odds of
@@ -67,14 +128,6 @@ struct autoshrink_bit_pool {
 
 typedef uint64_t autoshrink_prng_fun(uint8_t bits, void* udata);
 
-#define TWO_EVENLY  0x80
-#define FOUR_EVENLY 0x40
-#define MODEL_MIN   0x08
-#define MODEL_MAX   0x80
-
-#define DROPS_MIN 0x10
-#define DROPS_MAX 0xA0
-
 enum autoshrink_action {
 	ASA_DROP  = 0x01,
 	ASA_SHIFT = 0x02,
@@ -83,19 +136,42 @@ enum autoshrink_action {
 	ASA_SUB   = 0x10,
 };
 
-enum autoshrink_weight {
-	WEIGHT_DROP  = 0x00,
-	WEIGHT_SHIFT = 0x01,
-	WEIGHT_MASK  = 0x02,
-	WEIGHT_SWAP  = 0x03,
-	WEIGHT_SUB   = 0x04,
-};
+// Each shrinking attempt uses one tactic, chosen as a multi-armed bandit
+// with UCB1-Tuned: the tactic with the best average reward so far (see
+// fuzz_autoshrink_weights), plus a bonus for how uncertain it is. The
+// counts live in the run's fuzz_autoshrink_weights, so what is learned
+// shrinking one failure carries over to the next. Once an argument's
+// counts add up to WEIGHTS_MAX_TRIES, they are halved.
+#define WEIGHTS_MAX_TRIES 4096
+
+// Shrinking stops once a moving average of the attempts' successes falls
+// below 1 in max_failed_shrinks. Its window is max_failed_shrinks / 2
+// attempts, so the more often shrinks have been working, the more misses
+// in a row it takes -- after a run of successes, about 2.3 times
+// max_failed_shrinks, for the default. GAIN_ONE is 1.0 for the average.
+#define GAIN_ONE (1LLU << 32)
 
 struct autoshrink_model {
-	enum autoshrink_action cur_tried;
-	enum autoshrink_action cur_set;
-	enum autoshrink_action next_action;
-	uint8_t                weights[5];
+	uint8_t                cur_tactic;  // made the current candidate
+	uint8_t                cur_reward;  // earned if it fails
+	enum autoshrink_action next_action; // set by tests
+	uint64_t               gain;        // average successes
+	uint64_t               gain_window;
+};
+
+// Besides the random tactics, autoshrink systematically tries deleting
+// runs of requests, like delta debugging's ddmin: split the requests into
+// CHUNKS runs, and try deleting each one in turn. When a deletion works,
+// carry on from the same run with one fewer chunk; when a whole pass
+// deletes nothing, split them into twice as many runs, until it's down to
+// single requests.
+#define DDMIN_NONE ((size_t)-1)
+
+struct autoshrink_ddmin {
+	size_t generation; // generation of the pool it's working on
+	size_t chunks;     // 0: not started yet
+	size_t next;       // next chunk to try deleting
+	bool   done;       // no single request can be deleted
 };
 
 struct autoshrink_env {
@@ -109,6 +185,7 @@ struct autoshrink_env {
 	uint8_t  drop_bits;
 
 	struct autoshrink_model     model;
+	struct autoshrink_ddmin     ddmin;
 	struct autoshrink_bit_pool* bit_pool;
 
 	// allow injecting a fake prng, for testing
@@ -153,24 +230,45 @@ enum fuzz_autoshrink_wrap fuzz_autoshrink_wrap(struct fuzz* t,
 		struct fuzz_type_info*                      type_info,
 		struct fuzz_type_info*                      wrapper);
 
+// Free a bit pool, or keep it in T's spare pools for reuse, if T is
+// non-NULL.
 void fuzz_autoshrink_free_bit_pool(
 		struct fuzz* t, struct autoshrink_bit_pool* pool);
 
+// Free T's spare bit pools.
+void fuzz_autoshrink_free_spare_pools(struct fuzz* t);
+
+// Copy a shrink candidate's bits out of the pool it was made from, so that
+// pool can be freed. Returns false if allocating its bit buffer fails.
+bool fuzz_autoshrink_commit_bit_pool(struct autoshrink_bit_pool* pool);
+
+// Read the first BIT_COUNT bits of POOL into DST, whether or not it has
+// been committed.
+void fuzz_autoshrink_read_bit_pool(const struct autoshrink_bit_pool* pool,
+		size_t bit_count, uint64_t* dst);
+
 void fuzz_autoshrink_bit_pool_random(struct fuzz* t,
 		struct autoshrink_bit_pool* pool, uint32_t bit_count,
 		bool save_request, uint64_t* buf);
 
+// Has the pool reached its limit, so it will only yield 0 bits from now on?
+bool fuzz_autoshrink_bit_pool_exhausted(
+		const struct autoshrink_bit_pool* pool);
+
 void fuzz_autoshrink_get_real_args(struct fuzz* t, void** dst, void** src);
 
-void fuzz_autoshrink_update_model(
-		struct fuzz* t, uint8_t arg_id, int res, uint8_t adjustment);
+// Update the tactic weights with the result of calling the property with
+// arg ARG_ID's current shrink candidate.
+void fuzz_autoshrink_update_model(struct fuzz* t, uint8_t arg_id, int res);
 
 // Alloc callback, with autoshrink_env passed along.
 int fuzz_autoshrink_alloc(
 		struct fuzz* t, struct autoshrink_env* env, void** instance);
 
-uint64_t fuzz_autoshrink_hash(struct fuzz* t, const void* instance,
-		struct autoshrink_env* env, void* type_env);
+// Hash an instance: with the type's hash callback, if it has one, in
+// HASH[0], otherwise with a 128-bit hash of its bit pool.
+void fuzz_autoshrink_hash(struct fuzz* t, const void* instance,
+		struct autoshrink_env* env, void* type_env, uint64_t hash[2]);
 
 void fuzz_autoshrink_print(struct fuzz* t, FILE* f, struct autoshrink_env* env,
 		const void* instance, void* type_env);
@@ -221,6 +319,62 @@ struct fuzz_run_report {
 	size_t fail;
 	size_t skip;
 	size_t dup;
+
+	// Failures that were timeouts, out of memory, or crashes. These are
+	// also counted in fail.
+	size_t timeout;
+	size_t oom;
+	size_t crash;
+};
+
+// A failing trial, which can be run again on its own with its seed.
+struct fuzz_failure {
+	size_t   trial_id;
+	uint64_t trial_seed;
+	int      result; // FUZZ_RESULT_FAIL, _TIMEOUT, _OOM or _CRASH(sig)
+};
+
+// Report of a run, or of several shards of one run merged together with
+// fuzz_report_merge.
+struct fuzz_report {
+	uint64_t               run_seed;
+	size_t                 shard_count;   // shards the run was split into
+	size_t                 shards;        // shards merged into this report
+	size_t*                shard_indices; // which shards, ascending
+	struct fuzz_run_report report;
+
+	// Failing trials, ordered by trial_id.
+	size_t               failure_count;
+	struct fuzz_failure* failures;
+};
+
+// How a run's bloom filter, which skips trials whose arguments were already
+// tried, was sized and used. It's a table of fingerprints of the arguments'
+// hashes, in lines of slots the size of a cache line. Each entry goes in
+// its home line, or if that's full, one of the next few lines, so these
+// lines are like a short hash chain.
+struct fuzz_dedup_stats {
+	bool    enabled;          // false if some argument can't be hashed
+	bool    shared;           // shared between threads
+	size_t  bytes;            // memory used by the table
+	size_t  lines;            // lines in the table
+	size_t  slots;            // slots in the table
+	size_t  used;             // slots used, one per entry
+	size_t  full_lines;       // lines with no free slots left
+	size_t  displaced[4];     // entries 0, 1, 2 and 3 lines past home
+	size_t  grows;            // times the table doubled in size
+	size_t  forgotten;        // entries that didn't fit, so may run again
+	uint8_t fingerprint_bits; // bits kept of each entry's hash
+
+	size_t checks; // arguments checked, including while shrinking
+	size_t hits;   // checks that found them, e.g. DUP trials
+
+	uint32_t fill_ppm; // used / slots, in millionths
+	uint32_t hit_ppm;  // hits / checks, in millionths
+	// Estimated odds of arguments being wrongly found, as one in this
+	// many, or 0 if the table is empty: a false positive, which skips a
+	// trial that wasn't actually tried.
+	uint64_t fp_one_in;
 };
 
 #define FUZZ_RESULT_OK        (0) // No failure
@@ -231,6 +385,20 @@ struct fuzz_run_report {
 #define FUZZ_RESULT_ERROR_MEMORY (-1) // Memory allocation failure
 #define FUZZ_RESULT_ERROR        (-2)
 
+// Ways a call in a worker process can fail without returning. These are
+// never returned by property functions, but are passed to hooks in place of
+// FUZZ_RESULT_FAIL and count as failures in the same way. Use
+// FUZZ_RESULT_IS_FAIL to check for any kind of failure.
+#define FUZZ_RESULT_TIMEOUT (4) // exceeded fork.timeout or fork.cpu_limit
+#define FUZZ_RESULT_OOM     (5) // ran out of memory
+#define FUZZ_RESULT_CRASH(SIGNAL) (0x100 + (SIGNAL)) // killed by SIGNAL
+
+#define FUZZ_RESULT_IS_CRASH(RES)     ((RES) >= 0x100)
+#define FUZZ_RESULT_CRASH_SIGNAL(RES) ((RES)-0x100)
+#define FUZZ_RESULT_IS_FAIL(RES)                                               \
+	((RES) == FUZZ_RESULT_FAIL || (RES) == FUZZ_RESULT_TIMEOUT ||          \
+			(RES) == FUZZ_RESULT_OOM || FUZZ_RESULT_IS_CRASH(RES))
+
 // Default number of trials to run.
 #define FUZZ_DEF_TRIALS 100
 
@@ -245,6 +413,47 @@ struct fuzz_run_report {
 // be given to terminate and exit before sending kill(pid, SIGKILL).
 #define FUZZ_DEF_EXIT_TIMEOUT_MSEC 100
 
+// How many trials a persistent worker process runs before being replaced by
+// a fresh one, by default.
+#define FUZZ_DEF_PERSISTENT_CALLS 1000
+
+// Which PRNG backend runs use when `fuzz_run_config.rng` is
+// FUZZ_RNG_DEFAULT. Define this as FUZZ_RNG_MT19937 when building the library
+// to make every run reproduce seeds saved by earlier releases.
+#ifndef FUZZ_DEF_RNG
+#define FUZZ_DEF_RNG FUZZ_RNG_XOSHIRO256
+#endif
+
+// Size of the buffer filled by `fuzz_diag`, including the terminating 0.
+#define FUZZ_CALL_DIAG_SIZE 256
+
+// Measurements from a single call of the property function. When forking,
+// the worker process writes these to memory shared with the parent, so they
+// survive the worker crashing or being killed.
+struct fuzz_call_info {
+	// Time spent in the property function, and peak RSS of the process
+	// that called it. Both are 0 if the call didn't return.
+	//
+	// The peak RSS is the process's peak over its whole lifetime so far,
+	// from getrusage(2), not just during this call: a persistent
+	// worker's includes its earlier calls, a worker forked for each call
+	// may start from the parent's, and without forking it's the peak of
+	// the test process itself. Only a rise from one call to the next is
+	// sure to come from the later call.
+	uint64_t duration_usec;
+	size_t   max_rss_kb;
+
+	// If the worker process crashed, the signal that killed it, and
+	// errno and the faulting address (si_addr, for faults such as
+	// SIGSEGV) when it was caught. Otherwise 0.
+	int       crash_signal;
+	uintptr_t crash_addr;
+	int       crash_errno;
+
+	// Text written by the property function with `fuzz_diag`.
+	char diag[FUZZ_CALL_DIAG_SIZE];
+};
+
 // This struct contains callbacks used to specify how to allocate, free, hash,
 // print, and/or shrink the property test input.
 //
@@ -302,12 +511,39 @@ struct fuzz_autoshrink_config {
 	size_t                          pool_size;
 	enum fuzz_autoshrink_print_mode print_mode;
 
-	// How many unsuccessful shrinking attempts to try in a row before
-	// deciding a local minimum has been reached.
+	// How unlikely shrinking attempts need to get before deciding a
+	// local minimum has been reached: autoshrinking stops once its
+	// running estimate of the odds of an attempt succeeding falls below
+	// 1 in max_failed_shrinks, and no more requests can be deleted
+	// systematically.
 	// Default: DEF_MAX_FAILED_SHRINKS.
 	size_t max_failed_shrinks;
 };
 
+// Tactics autoshrinking chooses between for each shrinking attempt.
+enum fuzz_autoshrink_tactic {
+	FUZZ_AUTOSHRINK_TACTIC_DROP,  // drop random requests
+	FUZZ_AUTOSHRINK_TACTIC_SHIFT, // shift requests' bits right
+	FUZZ_AUTOSHRINK_TACTIC_MASK,  // clear random bits
+	FUZZ_AUTOSHRINK_TACTIC_SWAP,  // swap requests into order
+	FUZZ_AUTOSHRINK_TACTIC_SUB,   // subtract from requests
+	FUZZ_AUTOSHRINK_TACTIC_DDMIN, // delete runs of requests in turn
+	FUZZ_AUTOSHRINK_TACTIC_COUNT,
+};
+
+// How often each autoshrink tactic has been tried on each of a property's
+// arguments, and the rewards it earned for shrinks that still failed: 1,
+// plus up to FUZZ_AUTOSHRINK_MAX_REWARD - 1 more in proportion to how much
+// of the input's random bits the shrink did away with. Tactics that earn
+// more per try are tried more often. Older counts are halved as new ones
+// come in, so the weights keep adapting.
+#define FUZZ_AUTOSHRINK_MAX_REWARD 16
+
+struct fuzz_autoshrink_weights {
+	uint32_t tries[FUZZ_MAX_ARITY][FUZZ_AUTOSHRINK_TACTIC_COUNT];
+	uint32_t rewards[FUZZ_MAX_ARITY][FUZZ_AUTOSHRINK_TACTIC_COUNT];
+};
+
 // Callbacks used for testing with random instances of a type.
 // For more information, see comments on their typedefs.
 struct fuzz_type_info {
@@ -451,6 +687,10 @@ struct fuzz_post_trial_info {
 	void**       args;
 	int          result;
 	bool         repeat;
+
+	// The property function's call, or NULL if it wasn't called (the
+	// result is SKIP, DUPLICATE or ERROR from generating arguments).
+	const struct fuzz_call_info* call;
 };
 
 // The default post-trial hook. Calls `fuzz_print_trial_result` with an
@@ -552,6 +792,33 @@ struct fuzz_post_shrink_trial_info {
 	int         result;
 };
 
+// How each trial's seed is chosen, after any always_seeds.
+enum fuzz_seed_schedule {
+	// Each trial's seed is drawn from the PRNG once the previous trial
+	// has finished, after whatever generating, calling and shrinking it
+	// drew, so reaching trial N means running all the trials before it.
+	// This is the default, and what seeds from earlier runs expect.
+	FUZZ_SEED_SCHEDULE_CHAINED = 0,
+	// Trial N's seed is fuzz_trial_seed(seed, N), so any trial can be
+	// generated on its own.
+	FUZZ_SEED_SCHEDULE_COUNTER = 1,
+};
+
+// Pseudorandom number generator behind a run's random bits. Each backend
+// gives a different stream for the same seed, so saved seeds only reproduce
+// a failure when run with the backend that found them.
+enum fuzz_rng_kind {
+	// FUZZ_DEF_RNG, which is FUZZ_RNG_XOSHIRO256 unless the library was
+	// built with it defined otherwise.
+	FUZZ_RNG_DEFAULT = 0,
+	// xoshiro256**: 32 bytes of state and constant-time seeding.
+	FUZZ_RNG_XOSHIRO256 = 1,
+	// 64-bit Mersenne Twister, which every run used before xoshiro256**
+	// became the default. Reseeding it for each trial fills 2.5 KB of
+	// state, but it reproduces seeds saved by earlier releases.
+	FUZZ_RNG_MT19937 = 2,
+};
+
 // Configuration struct for a fuzz run.
 struct fuzz_run_config {
 	// A test property function.
@@ -596,21 +863,178 @@ struct fuzz_run_config {
 	// Seed for the random number generator.
 	uint64_t seed;
 
+	// How each trial's seed is derived from `seed`. Defaults to
+	// FUZZ_SEED_SCHEDULE_CHAINED.
+	enum fuzz_seed_schedule seed_schedule;
+
+	// PRNG backend. Defaults to FUZZ_DEF_RNG.
+	enum fuzz_rng_kind rng;
+
+	// Only run one shard of the trials, so several processes can split a
+	// run between them without overlapping: out of `trials` trials,
+	// shard K of N runs trials K, K+N, K+2N, and so on. Sharded runs
+	// always use FUZZ_SEED_SCHEDULE_COUNTER. A shard_count of 0 or 1 runs
+	// all of the trials. See also fuzz_parse_shard.
+	size_t shard_index;
+	size_t shard_count;
+
+	// If non-NULL, this is filled in with a report of the run and its
+	// failing seeds when the run finishes without error. Shards' reports
+	// can be saved with fuzz_report_write and combined with
+	// fuzz_report_merge. Free it with fuzz_report_free.
+	struct fuzz_report* report;
+
+	// If non-NULL, autoshrinking starts from these tactic weights,
+	// rather than learning them from scratch, and updates them as it
+	// goes. Since they depend on the property and its argument types,
+	// each property should have its own. They can be saved between runs
+	// with fuzz_autoshrink_weights_write.
+	struct fuzz_autoshrink_weights* autoshrink_weights;
+
 	// Bits to use for the bloom filter -- this field is no longer used,
-	// and will be removed in a future release.
+	// and will be removed in a future release. See dedup_max_bytes.
 	uint8_t bloom_bits;
 
+	// Most memory the bloom filter that skips trials whose arguments
+	// were already tried can use, in bytes, or 0 for no limit. The
+	// filter is sized for `trials`, and doubles in size as it fills up,
+	// so this keeps it from growing past the limit; once it would, new
+	// entries go in the remaining free slots, and those that don't fit
+	// are forgotten, so their arguments may be run again. Each 64
+	// bytes holds up to 16 entries, and it uses at least 128 bytes.
+	size_t dedup_max_bytes;
+
+	// If non-NULL, this is filled in with stats about the bloom filter
+	// when the run is freed. Print them with fuzz_print_dedup_stats.
+	struct fuzz_dedup_stats* dedup_stats;
+
+	// If non-NULL, the bloom filter that skips trials whose arguments
+	// were already tried is loaded from this file when the run starts,
+	// and saved back to it when the run is freed, so later runs skip
+	// arguments that earlier ones already tried, too. Trials from
+	// always_seeds are never skipped. Arguments that failed (including
+	// while shrinking) are left out of the saved filter, so they're tried
+	// again next time. A saved filter larger than dedup_max_bytes is
+	// ignored.
+	//
+	// The file is keyed by the property's name and what fuzz can tell
+	// about its arguments' types, and is replaced if those don't match.
+	// It can't tell what a type_info's env does, though, so if that
+	// changes how arguments are generated -- say, a builtin type's
+	// limit -- use another file. Runs on the same seed generate the
+	// same arguments, so to try new ones there, raise `trials` each
+	// time: skipping the trials already tried only costs generating
+	// their arguments. Shards of a run should each have their own file.
+	const char* dedup_path;
+
+	// Number of threads to run trials on, in-process. 0 or 1 runs one
+	// trial at a time. Ignored when forking (see fork.workers), and on
+	// platforms without threads.
+	//
+	// Each thread has its own `struct fuzz`, with its own PRNG and trial
+	// state, so the property function and type_info callbacks must be
+	// safe to call from several threads at once. Hooks are never called
+	// concurrently. Halting stops new trials from being started; ones
+	// already running on other threads still finish.
+	//
+	// With FUZZ_SEED_SCHEDULE_CHAINED, arguments are still generated
+	// one trial at a time, in order, and trials are reported in trial
+	// order, so a run gets the same results and counterexamples as a
+	// serial one. Trials are started before the ones before them have
+	// finished, assuming they won't fail. When one does, shrinking it
+	// changes the seeds of the trials after it, so those are dropped
+	// and started again, and their pre_gen_args and pre_trial hooks can
+	// be called more than once.
+	//
+	// With FUZZ_SEED_SCHEDULE_COUNTER, threads generate arguments and
+	// shrink failures in parallel too, and trials from different threads
+	// may be reported out of trial order. Trials get the same seeds and
+	// results as in a serial run, but which trials are counted as
+	// duplicates can vary from run to run, and so can shrunk
+	// counterexamples, since shrinking skips arguments the bloom filter
+	// has already seen, from whichever trials got there first, and
+	// autoshrinking learns from every thread's shrinks as they happen.
+	size_t threads;
+
 	// Fork before running the property test, in case generated arguments
 	// can cause the code under test to crash.
 	struct {
 		bool   enable;
 		size_t timeout; // in milliseconds (or 0, for none)
+		// Once a few calls have passed, time out calls that take more
+		// than this many times as long as recent passing calls did on
+		// average, so inputs that are unusually slow are reported as
+		// FUZZ_RESULT_TIMEOUT. The timeout never exceeds the one
+		// above, if set. 0 disables this.
+		//
+		// Since this depends on timing, which trials time out can
+		// vary from run to run.
+		size_t adaptive_timeout;
 		// signal to send after timeout, defaults to SIGTERM
 		int signal;
 		// For workers sent a timeout signal, how long should fuzz
 		// wait for them to actually exit (in msec). Defaults to
 		// FUZZ_DEF_EXIT_TIMEOUT_MSEC.
 		size_t exit_timeout;
+		// Number of worker processes running trials at once. 0 or 1
+		// runs one trial at a time.
+		//
+		// With more than one worker, arguments are generated and
+		// calls are started in trial order as workers become free,
+		// but trials are retired strictly in trial order: counters,
+		// shrinking, and the pre-trial, counter-example, and
+		// post-trial hooks see the same sequence regardless of which
+		// worker finishes first. The pre-trial hook is called just
+		// before a trial's result is used, so its property call may
+		// already have run; halting there discards that result and
+		// any later trials still in flight.
+		//
+		// With FUZZ_SEED_SCHEDULE_CHAINED, trials are started before
+		// the ones before them have finished, assuming they won't
+		// fail. When one does, shrinking it changes the seeds of the
+		// trials after it, so those are dropped and started again,
+		// and their pre_gen_args hook can be called more than once.
+		size_t workers;
+		// Keep worker processes running between trials, rather than
+		// forking one for every trial. Each worker is forked once,
+		// then sent the seed of each trial to run, regenerates its
+		// arguments, and reports the result back. It is only replaced
+		// after it crashes, times out, or has run persistent_calls
+		// trials.
+		//
+		// While shrinking, autoshrinking arguments are sent as their
+		// bit pools; if any argument uses its own shrink callback,
+		// shrinking forks for every trial, as usual.
+		//
+		// The type_info callbacks must generate the same arguments
+		// from the same seed in the worker as they do in the parent,
+		// so they shouldn't depend on state changed in the parent
+		// after the worker started. The post-fork hook is called
+		// before each trial, not just once per worker.
+		bool persistent;
+		// Defaults to FUZZ_DEF_PERSISTENT_CALLS.
+		size_t persistent_calls;
+		// Limit each worker's address space to this many bytes more
+		// than it had when it was forked (RLIMIT_AS), and each call's
+		// CPU time to this many seconds (RLIMIT_CPU). 0 means no
+		// limit. (Where the address space's size isn't known, the
+		// memory limit is the whole size.) Calls that run out of
+		// memory fail with FUZZ_RESULT_OOM, and calls that run out of
+		// CPU time with FUZZ_RESULT_TIMEOUT.
+		//
+		// Sanitizers reserve far more address space than they use,
+		// so memory_limit usually can't be used with them.
+		size_t memory_limit;
+		size_t cpu_limit;
+		// While shrinking, generate this many candidates at a time,
+		// and run the property on all of them at once, each in its
+		// own worker. 0 or 1 tries one candidate at a time.
+		//
+		// Candidates are still judged in tactic order: the first one
+		// that fails is kept and the rest are thrown away, so results
+		// are deterministic for a given number of shrink workers,
+		// though they can differ from shrinking one at a time.
+		size_t shrink_workers;
 	} fork;
 
 	// These functions are called in several contexts to report on
@@ -675,20 +1099,41 @@ void fuzz_random_bits_bulk(struct fuzz* t, uint32_t bits, uint64_t* buf);
 // Get a random double from the test runner's PRNG.
 FUZZ_PUBLIC
 double fuzz_random_double(struct fuzz* t);
+#endif
 
 // Get a random uint64_t less than CEIL.
 // For example, `fuzz_random_choice(t, 5)` will return
-// approximately evenly distributed values from [0, 1, 2, 3, 4].
+// evenly distributed values from [0, 1, 2, 3, 4]. Fewer random bits give
+// smaller values, so autoshrinking moves choices towards 0.
 FUZZ_PUBLIC
 uint64_t fuzz_random_choice(struct fuzz* t, uint64_t ceil);
 
 // Get a random uint64_t in the range [min, max].
-// For example, `fuzz_random_range(f, 7, 18)` will return approximately evenly
+// For example, `fuzz_random_range(f, 7, 18)` will return evenly
 // distributed values from [7, 8, 9, 10, 11, 12, 13, 14, 15, 16, 17, 18].
 FUZZ_PUBLIC
 uint64_t fuzz_random_range(
 		struct fuzz* f, const uint64_t min, const uint64_t max);
-#endif
+
+// Fill OUT with COUNT random values in the range [min, max], drawing their
+// bits from the PRNG at once. Each value is generated the same way as by
+// `fuzz_random_range`, except that the rare biased samples are not redrawn,
+// so this usually gives the same values as calling it COUNT times. When
+// autoshrinking, the whole array is recorded as one large request (or a few,
+// for very large arrays) rather than one request per value, and shrinking
+// its bits still makes individual values smaller.
+FUZZ_PUBLIC
+void fuzz_random_range_bulk_u8(struct fuzz* t, uint8_t min, uint8_t max,
+		size_t count, uint8_t* out);
+FUZZ_PUBLIC
+void fuzz_random_range_bulk_u16(struct fuzz* t, uint16_t min, uint16_t max,
+		size_t count, uint16_t* out);
+FUZZ_PUBLIC
+void fuzz_random_range_bulk_u32(struct fuzz* t, uint32_t min, uint32_t max,
+		size_t count, uint32_t* out);
+FUZZ_PUBLIC
+void fuzz_random_range_bulk_u64(struct fuzz* t, uint64_t min, uint64_t max,
+		size_t count, uint64_t* out);
 
 // Hash a buffer in one pass. (Wraps the below functions.)
 FUZZ_PUBLIC uint64_t fuzz_hash_onepass(const uint8_t* data, size_t bytes);
@@ -706,6 +1151,12 @@ void fuzz_hash_sink(uint64_t* h, const uint8_t* data, size_t bytes);
 FUZZ_PUBLIC
 uint64_t fuzz_hash_finish(uint64_t* h);
 
+// Hash a buffer in one pass into two words, res[0] and res[1]. This reads
+// the buffer a word at a time, so it's much faster than the functions above
+// on large buffers, and gives different hashes.
+FUZZ_PUBLIC
+void fuzz_hash128_onepass(const uint8_t* data, size_t bytes, uint64_t res[2]);
+
 // Print a trial result in the default format.
 //
 // To use this, add a `struct fuzz_print_trial_result_env` to the env in the
@@ -741,6 +1192,52 @@ void fuzz_print_pre_run_info(FILE* f, const struct fuzz_pre_run_info* info);
 FUZZ_PUBLIC
 void fuzz_print_post_run_info(FILE* f, const struct fuzz_post_run_info* info);
 
+// Print stats about a run's bloom filter.
+FUZZ_PUBLIC
+void fuzz_print_dedup_stats(FILE* f, const struct fuzz_dedup_stats* stats);
+
+// Parse a shard given as "K/N", as in `--shard K/N`, into *INDEX and *COUNT.
+// Returns false if STR isn't of that form with K < N.
+FUZZ_PUBLIC
+bool fuzz_parse_shard(const char* str, size_t* index, size_t* count);
+
+// Write REPORT to F, in a text format fuzz_report_read can parse. Returns
+// false on error, or if REPORT doesn't say which shards it has, as with
+// some reports read from older versions.
+FUZZ_PUBLIC
+bool fuzz_report_write(FILE* f, const struct fuzz_report* report);
+
+// Read a report written by fuzz_report_write from F into *REPORT. Returns
+// false if it couldn't be read; otherwise it must be freed with
+// fuzz_report_free.
+FUZZ_PUBLIC
+bool fuzz_report_read(FILE* f, struct fuzz_report* report);
+
+// Add the counts and failures of SRC, from other shards of the same run, to
+// DST. Returns false, leaving DST unchanged, if they have different run
+// seeds or shard counts, if they have any shard in common (say, the same
+// report is merged twice), or on allocation failure. Reports written by
+// versions that didn't record which shards they have can't be merged.
+FUZZ_PUBLIC
+bool fuzz_report_merge(struct fuzz_report* dst, const struct fuzz_report* src);
+
+// Free the failures and shard indices in REPORT.
+FUZZ_PUBLIC
+void fuzz_report_free(struct fuzz_report* report);
+
+// Write WEIGHTS to F, in a text format fuzz_autoshrink_weights_read can
+// parse. Returns false on error.
+FUZZ_PUBLIC
+bool fuzz_autoshrink_weights_write(
+		FILE* f, const struct fuzz_autoshrink_weights* weights);
+
+// Read weights written by fuzz_autoshrink_weights_write from F into
+// *WEIGHTS. Returns false, leaving *WEIGHTS unchanged, if they couldn't be
+// read.
+FUZZ_PUBLIC
+bool fuzz_autoshrink_weights_read(
+		FILE* f, struct fuzz_autoshrink_weights* weights);
+
 // Halt trials after the first failure.
 FUZZ_PUBLIC
 int fuzz_hook_first_fail_halt(
@@ -755,10 +1252,23 @@ void* fuzz_hook_get_env(struct fuzz* t);
 FUZZ_PUBLIC
 void fuzz_set_output_stream(struct fuzz* t, FILE* out);
 
+// Append printf-style text to the current call's diagnostic buffer, which is
+// passed to the post-trial hook as `info->call->diag`. Text past
+// FUZZ_CALL_DIAG_SIZE is dropped. This only makes sense from inside the
+// property function, and works whether or not it runs in a worker process.
+FUZZ_PUBLIC
+void fuzz_diag(struct fuzz* t, const char* fmt, ...);
+
 // Get a seed based on the hash of the current timestamp.
 FUZZ_PUBLIC
 uint64_t fuzz_seed_of_time(void);
 
+// Get the seed used by trial TRIAL_ID of a run with RUN_SEED, with
+// FUZZ_SEED_SCHEDULE_COUNTER. (Trials that use always_seeds are counted
+// too, so the first trial after 3 always_seeds is trial 3.)
+FUZZ_PUBLIC
+uint64_t fuzz_trial_seed(uint64_t run_seed, size_t trial_id);
+
 // Generic free callback: just call free(instance).
 FUZZ_PUBLIC
 void fuzz_generic_free_cb(void* instance, void* env);
@@ -847,6 +1357,7 @@ const struct fuzz_type_info* fuzz_get_builtin_type_info(
 
 struct fuzz;
 struct autoshrink_bit_pool;
+struct prng_info;
 
 // Inject a bit pool for autoshrinking -- Get the random bit stream from
 // it, rather than the PRNG, because we'll shrink by shrinking the bit
@@ -862,6 +1373,14 @@ void fuzz_random_stop_using_bit_pool(struct fuzz* t);
 // This stops using the current bit pool.
 void fuzz_random_set_seed(struct fuzz* t, uint64_t seed);
 
+// Save the PRNG's place in its stream into SAVED, whose rng must be of
+// the same kind, so it can be picked up again later.
+void fuzz_random_save(struct fuzz* t, struct prng_info* saved);
+
+// Go back to the place in the stream saved in SAVED.
+// This stops using the current bit pool.
+void fuzz_random_restore(struct fuzz* t, const struct prng_info* saved);
+
 #endif
 
 // SPDX-License-Identifier: ISC
@@ -871,26 +1390,35 @@ void fuzz_random_set_seed(struct fuzz* t, uint64_t seed);
 
 #include <inttypes.h>
 
-// Wrapper for Mersenne Twister.
+// PRNG backends: xoshiro256** and Mersenne Twister.
 // See copyright and license in fuzz_rng.c, more details at:
+//     https://prng.di.unimi.it/
 //     http://www.math.sci.hiroshima-u.ac.jp/~m-mat/MT/emt.html
 //
 // Local modifications are described in fuzz_mt.c.
 
-// Opaque type for a Mersenne Twister PRNG.
+// Opaque type for a PRNG.
 struct fuzz_rng;
 
-// Heap-allocate a mersenne twister struct.
-struct fuzz_rng* fuzz_rng_init(uint64_t seed);
+// Heap-allocate a PRNG of the given kind, which must not be
+// FUZZ_RNG_DEFAULT.
+struct fuzz_rng* fuzz_rng_init(enum fuzz_rng_kind kind, uint64_t seed);
 
-// Free a heap-allocated mersenne twister struct.
-void fuzz_rng_free(struct fuzz_rng* mt);
+// Free a heap-allocated PRNG.
+void fuzz_rng_free(struct fuzz_rng* r);
 
-// Reset a mersenne twister struct, possibly stack-allocated.
-void fuzz_rng_reset(struct fuzz_rng* mt, uint64_t seed);
+// Reset a PRNG to the start of SEED's stream.
+void fuzz_rng_reset(struct fuzz_rng* r, uint64_t seed);
+
+// Copy SRC's place in its stream into DST, which must be the same kind.
+void fuzz_rng_copy(struct fuzz_rng* dst, const struct fuzz_rng* src);
 
 // Get a 64-bit random number.
-uint64_t fuzz_rng_random(struct fuzz_rng* mt);
+uint64_t fuzz_rng_random(struct fuzz_rng* r);
+
+// Fill DST with the next COUNT 64-bit random numbers, the same ones COUNT
+// calls to fuzz_rng_random would return.
+void fuzz_rng_fill(struct fuzz_rng* r, uint64_t* dst, size_t count);
 
 // Convert a uint64_t to a number on the [0,1]-real-interval.
 double fuzz_rng_uint64_to_double(uint64_t x);
@@ -911,6 +1439,7 @@ double fuzz_rng_uint64_to_double(uint64_t x);
 #include <stdio.h>
 
 #if !defined(_WIN32)
+#include <pthread.h>
 #include <sys/types.h>
 #endif
 
@@ -954,11 +1483,13 @@ struct fuzz_pre_shrink_info;
 struct fuzz_post_shrink_info;
 struct fuzz_post_shrink_trial_info;
 
-struct fuzz_bloom; // bloom filter
-struct fuzz_rng;   // pseudorandom number generator
+struct fuzz_bloom;  // bloom filter
+struct fuzz_rng;    // pseudorandom number generator
+struct shrink_memo; // calls made while shrinking
 
 struct seed_info {
-	const uint64_t run_seed;
+	const uint64_t                run_seed;
+	const enum fuzz_seed_schedule schedule;
 
 	// Optional array of seeds to always run.
 	// Can be used for regression tests.
@@ -969,8 +1500,15 @@ struct seed_info {
 struct fork_info {
 	const bool   enable;
 	const size_t timeout;
+	const size_t adaptive_timeout;
 	const int    signal;
 	const size_t exit_timeout;
+	const size_t workers;
+	const bool   persistent;
+	const size_t persistent_calls;
+	const size_t memory_limit;
+	const size_t cpu_limit;
+	const size_t shrink_workers; // 0 if not shrinking speculatively
 };
 
 struct prop_info {
@@ -1039,10 +1577,42 @@ struct counter_info {
 	size_t fail;
 	size_t skip;
 	size_t dup;
+	size_t timeout;
+	size_t oom;
+	size_t crash;
+};
+
+struct shard_info {
+	const size_t index;
+	const size_t count; // 1 if not sharded
+};
+
+struct dedup_info {
+	const char* path;   // where to save the bloom filter, or NULL
+	uint64_t    key[2]; // saved along with it
+	bool        save;   // set once the run has finished
+
+	// Hashes of the arguments of calls that failed, or whose results
+	// weren't used, to take back out of the bloom filter before it's
+	// saved, so a later run tries them again. Each thread has its own,
+	// added to the run's once the threads are done.
+	uint64_t* forget;
+	size_t    forget_count; // calls, 2 * arity words each
+	size_t    forget_ceil;
+
+	struct fuzz_dedup_stats* stats; // filled in when freed, if non-NULL
+};
+
+// Failing trials, saved for fuzz_run_config.report.
+struct failure_log {
+	size_t               count;
+	size_t               ceil;
+	struct fuzz_failure* failures;
 };
 
 struct prng_info {
-	struct fuzz_rng* rng; // random number generator
+	enum fuzz_rng_kind kind; // which backend RNG uses
+	struct fuzz_rng*   rng;  // random number generator
 	uint64_t         buf; // buffer for PRNG bits
 	uint8_t          bits_available;
 	// Bit pool, only used during autoshrinking.
@@ -1073,6 +1643,9 @@ struct trial_info {
 	size_t          successful_shrinks;
 	size_t          failed_shrinks;
 	struct arg_info args[FUZZ_MAX_ARITY];
+
+	// While shrinking, the hashes of the arguments called so far.
+	struct shrink_memo* memo;
 };
 
 enum worker_state {
@@ -1081,11 +1654,85 @@ enum worker_state {
 	WS_STOPPED,
 };
 
+// Written by a worker process to memory it shares with the parent, which
+// reads it once the call has finished.
+struct worker_result {
+	bool                  done;   // the call returned, and result is set
+	int                   result; // FUZZ_RESULT_*
+	struct fuzz_call_info info;
+};
+
 struct worker_info {
-	enum worker_state state;
-	int               fds[2];
-	pid_t             pid;
-	int               wstatus;
+	enum worker_state     state;
+	struct worker_result* shm;
+	bool                  piped; // fds[0] is readable once a call is done
+	int                   fds[2];
+	pid_t                 pid;
+	int                   pidfd; // readable once pid exits, or -1
+	int                   wstatus;
+
+	// Only used by workers started with fuzz_call_start.
+	bool   busy;     // running a call, or holding its result
+	bool   done;     // call has finished and result is set
+	int    result;   // FUZZ_RESULT_* from the call
+	size_t deadline; // in msec, or 0 for no timeout
+
+	// Only used by persistent workers (see fork.persistent).
+	bool   persistent; // waiting for requests on req_fd
+	bool   replied;    // wrote a result for the last call
+	int    req_fd;     // write end of the worker's request pipe
+	size_t calls;      // calls started so far
+};
+
+// State shared by the threads of a run with more than one thread.
+struct thread_info {
+	struct fuzz* run;        // the run's own handle, with the counters
+	struct fuzz* handles;    // the threads' own handles
+	size_t       count;      // number of threads
+	size_t       next_trial; // next trial to generate
+	size_t       limit;
+	uint64_t     seed;      // seed for next_trial
+	bool         halted;    // don't start any more trials
+	size_t       halted_at; // the trial that halted the run
+	bool         error;
+
+	// With the chained schedule, trials are retired in trial order, and
+	// next_retire is the next one. While a trial whose seed for the
+	// next trial isn't known yet is retired, seed_pending is set, and no
+	// trials are generated. generating is set while a thread generates
+	// a trial, which only one does at a time, so their seeds chain just
+	// like in a serial run.
+	size_t next_retire;
+	bool   seed_pending;
+	bool   generating;
+
+#if !defined(_WIN32)
+	// Held while changing the fields above.
+	pthread_mutex_t gen_lock;
+	// Signalled with gen_lock when next_retire, seed_pending or
+	// generating change, or a trial is dropped.
+	pthread_cond_t gen_cond;
+	// Held while calling hooks and updating the run's counters and
+	// report.
+	pthread_mutex_t run_lock;
+	// Held while using the run's autoshrink weights, which threads
+	// update as they shrink.
+	pthread_mutex_t weights_lock;
+#endif
+};
+
+// With the chained schedule, a thread's trial from when it's generated
+// until it's retired or dropped. Only changed while holding gen_lock.
+struct thread_trial {
+	bool     live;      // generated, and not retired or dropped yet
+	size_t   index;     // the trial's index among the shard's trials
+	uint64_t next_seed; // seed the trial after it was generated with
+	// Set if its arguments were added to the bloom filter, with their
+	// hashes, so they can be taken back out if it's dropped.
+	bool     marked;
+	uint64_t hashes[2 * FUZZ_MAX_ARITY];
+	// The PRNG's place right after generating it.
+	struct prng_info saved;
 };
 
 // Handle to state for the entire run.
@@ -1097,11 +1744,64 @@ struct fuzz {
 	struct prng_info    prng;
 	struct prop_info    prop;
 	struct seed_info    seeds;
+	struct shard_info   shard;
 	struct fork_info    fork;
 	struct hook_info    hooks;
 	struct counter_info counters;
 	struct trial_info   trial;
-	struct worker_info  workers[1];
+	struct dedup_info   dedup;
+
+	// workers[0] is used for one call at a time (see fuzz_call), then
+	// come the pool used when fork.workers > 1, and the workers for
+	// speculative shrinking, when fork.shrink_workers > 1.
+	size_t              worker_count;
+	struct worker_info* workers;
+
+	// Blocks the workers write their results to, mapped before forking
+	// so they're shared with the workers. If pidfds is set, workers not
+	// running persistently are waited for with a pidfd, without a pipe.
+	struct worker_result* results;
+	bool                  pidfds;
+
+	// Set while SIGPIPE is ignored for persistent workers' request pipes.
+	bool ignoring_sigpipe;
+
+	// Measurements of the last call, of the call that made the current
+	// trial's (shrunk) arguments fail, and where the call that's running
+	// writes its measurements (for fuzz_diag).
+	struct fuzz_call_info  call_info;
+	struct fuzz_call_info  fail_call_info;
+	struct fuzz_call_info* call_out;
+
+	// The result of the call described by fail_call_info, which says how
+	// the current trial failed.
+	int fail_result;
+
+	// Passing calls in worker processes so far, and a moving average of
+	// their durations, for fork.adaptive_timeout.
+	size_t   passing_calls;
+	uint64_t avg_passing_usec;
+
+	// For runs with more than one thread, each thread gets its own copy
+	// of this struct, with thread pointing to their shared state.
+	size_t              thread_count;
+	struct thread_info* thread;
+	struct thread_trial thread_trial;
+
+	// Where to put the report at the end of the run, and the failures
+	// for it so far (shared with the run's threads), if requested.
+	struct fuzz_report* report;
+	struct failure_log* failures;
+
+	// Autoshrink's tactic weights, learned over the run (shared with the
+	// run's threads): either the caller's, or default_autoshrink_weights.
+	struct fuzz_autoshrink_weights* autoshrink_weights;
+	struct fuzz_autoshrink_weights  default_autoshrink_weights;
+
+	// Bit pools freed while autoshrinking, kept so the next ones can
+	// reuse their buffers rather than going through malloc and free.
+	struct autoshrink_bit_pool* spare_pools;
+	size_t                      spare_pool_count;
 };
 
 #endif
@@ -1109,9 +1809,12 @@ struct fuzz {
 #define GET_DEF(X, DEF) (X ? X : DEF)
 #define LOG_AUTOSHRINK  0
 
-static struct autoshrink_bit_pool* alloc_bit_pool(
+static struct autoshrink_bit_pool* alloc_bit_pool(struct fuzz* t,
 		size_t size, size_t limit, size_t request_ceil);
 
+static struct autoshrink_bit_pool* reuse_bit_pool(struct fuzz* t,
+		size_t alloc_size, size_t limit, size_t request_ceil);
+
 static int alloc_from_bit_pool(struct fuzz* t, struct autoshrink_env* env,
 		struct autoshrink_bit_pool* bit_pool, void** output,
 		bool shrinking);
@@ -1119,14 +1822,29 @@ static int alloc_from_bit_pool(struct fuzz* t, struct autoshrink_env* env,
 static bool append_request(
 		struct autoshrink_bit_pool* pool, uint32_t bit_count);
 
-static void drop_from_bit_pool(struct fuzz* t, struct autoshrink_env* env,
+static bool drop_from_bit_pool(struct fuzz* t, struct autoshrink_env* env,
 		const struct autoshrink_bit_pool* orig,
 		struct autoshrink_bit_pool*       pool);
 
-static void mutate_bit_pool(struct fuzz* t, struct autoshrink_env* env,
+static bool mutate_bit_pool(struct fuzz* t, struct autoshrink_env* env,
 		const struct autoshrink_bit_pool* orig,
 		struct autoshrink_bit_pool*       pool);
 
+static bool sync_ddmin(struct autoshrink_env* env,
+		const struct autoshrink_bit_pool* orig);
+
+static bool ddmin_from_bit_pool(const struct autoshrink_bit_pool* orig,
+		struct autoshrink_bit_pool* pool, size_t chunk,
+		size_t chunk_count);
+
+static bool add_span(
+		struct autoshrink_bit_pool* pool, size_t src, size_t size);
+
+static bool reserve_patches(struct autoshrink_bit_pool* pool, size_t count);
+
+static void read_cow_bits(const struct autoshrink_bit_pool* pool,
+		size_t bit_offset, size_t count, uint64_t* dst);
+
 static bool choose_and_mutate_request(struct fuzz* t,
 		struct autoshrink_env*             env,
 		const struct autoshrink_bit_pool*  orig,
@@ -1137,8 +1855,14 @@ static bool build_index(struct autoshrink_bit_pool* pool);
 static size_t offset_of_pos(
 		const struct autoshrink_bit_pool* orig, size_t pos);
 
-static void convert_bit_offset(
-		size_t bit_offset, size_t* byte_offset, uint8_t* bit);
+static uint64_t read_word_bits(
+		const uint64_t* words, size_t bit_offset, uint8_t size);
+
+static void write_word_bits(uint64_t* words, size_t bit_offset, uint8_t size,
+		uint64_t bits);
+
+static void copy_bits(uint64_t* dst, size_t dst_offset, const uint64_t* src,
+		size_t src_offset, size_t count);
 
 static uint64_t read_bits_at_offset(const struct autoshrink_bit_pool* pool,
 		size_t bit_offset, uint8_t size);
@@ -1148,13 +1872,18 @@ static void write_bits_at_offset(struct autoshrink_bit_pool* pool,
 
 static void truncate_trailing_zero_bytes(struct autoshrink_bit_pool* pool);
 
-static void init_model(struct autoshrink_env* env);
+static enum fuzz_autoshrink_tactic choose_tactic(struct fuzz* t,
+		struct autoshrink_env* env, bool ddmin, bool ddmin_only);
 
-static enum mutation get_weighted_mutation(
-		struct fuzz* t, struct autoshrink_env* env);
+static enum mutation get_mutation(const struct autoshrink_env* env);
+
+static uint64_t fixed_ln(uint64_t x);
 
-static bool should_drop(struct fuzz* t, struct autoshrink_env* env,
-		size_t request_count);
+static uint64_t isqrt(uint64_t x);
+
+static void lock_weights(struct fuzz* t);
+
+static void unlock_weights(struct fuzz* t);
 
 static void lazily_fill_bit_pool(struct fuzz* t,
 		struct autoshrink_bit_pool* pool, const uint32_t bit_count);
@@ -1162,6 +1891,10 @@ static void lazily_fill_bit_pool(struct fuzz* t,
 static void fill_buf(struct autoshrink_bit_pool* pool,
 		const uint32_t bit_count, uint64_t* buf);
 
+static void sink_consumed_words(struct autoshrink_bit_pool* pool);
+
+static void hash_bit_pool(struct autoshrink_bit_pool* pool);
+
 static autoshrink_prng_fun* get_prng(
 		struct fuzz* t, struct autoshrink_env* env);
 static uint64_t get_autoshrink_mask(uint8_t bits);
@@ -1184,6 +1917,11 @@ fuzz_autoshrink_alloc_env(struct fuzz* t, uint8_t arg_i,
 					type_info->autoshrink_config
 							.max_failed_shrinks,
 	};
+
+	const size_t max_failed = GET_DEF(
+			env->max_failed_shrinks, DEF_MAX_FAILED_SHRINKS);
+	env->model.gain        = GAIN_ONE;
+	env->model.gain_window = (max_failed < 2 ? 1 : max_failed / 2);
 	return env;
 }
 
@@ -1220,9 +1958,10 @@ fuzz_autoshrink_bit_pool_random(struct fuzz* t,
 				"%s: end of bit pool, yielding zeroes\n",
 				__func__);
 		memset(buf, 0x00,
-				(bit_count / 64) +
+				((bit_count / 64) +
 						((bit_count % 64) == 0 ? 0
-								       : 1));
+								       : 1)) *
+						sizeof(uint64_t));
 		return;
 	}
 
@@ -1238,6 +1977,12 @@ fuzz_autoshrink_bit_pool_random(struct fuzz* t,
 	fill_buf(pool, bit_count, buf);
 }
 
+bool
+fuzz_autoshrink_bit_pool_exhausted(const struct autoshrink_bit_pool* pool)
+{
+	return pool->consumed == pool->limit;
+}
+
 static void
 lazily_fill_bit_pool(struct fuzz* t, struct autoshrink_bit_pool* pool,
 		const uint32_t bit_count)
@@ -1249,25 +1994,31 @@ lazily_fill_bit_pool(struct fuzz* t, struct autoshrink_bit_pool* pool,
 		size_t nceil = 2 * pool->bits_ceil;
 		LOG(1, "growing pool: from bits %p, ceil %zd, ",
 				(void*)pool->bits, pool->bits_ceil);
-		uint64_t* nbits = realloc(
-				pool->bits, nceil / (64 / sizeof(uint64_t)));
-		LOG(1, "nbits %p, nceil %zd\n", (void*)nbits, nceil);
-		if (nbits == NULL) {
-			assert(false); // alloc fail
-			return;
+		if (nceil > pool->bits_alloc) {
+			uint64_t* nbits = realloc(pool->bits,
+					nceil / (64 / sizeof(uint64_t)));
+			LOG(1, "nbits %p, nceil %zd\n", (void*)nbits, nceil);
+			if (nbits == NULL) {
+				assert(false); // alloc fail
+				return;
+			}
+			pool->bits       = (uint8_t*)nbits;
+			pool->bits_alloc = nceil;
 		}
-		pool->bits      = (uint8_t*)nbits;
 		pool->bits_ceil = nceil;
 	}
 
-	while (pool->consumed + bit_count > pool->bits_filled) {
-		uint64_t* bits64 = (uint64_t*)pool->bits;
-		size_t    offset = pool->bits_filled / 64;
-		assert(offset * 64 < pool->bits_ceil);
-		bits64[offset] = fuzz_rng_random(t->prng.rng);
-		LOG(3, "filling bit64[%zd]: 0x%016" PRIx64 "\n", offset,
-				bits64[offset]);
-		pool->bits_filled += 64;
+	if (pool->consumed + bit_count > pool->bits_filled) {
+		uint64_t*    bits64 = (uint64_t*)pool->bits;
+		size_t       offset = pool->bits_filled / 64;
+		const size_t words  = (pool->consumed + bit_count -
+						      pool->bits_filled + 63) /
+				     64;
+		assert((offset + words) * 64 <= pool->bits_ceil);
+		fuzz_rng_fill(t->prng.rng, &bits64[offset], words);
+		LOG(3, "filling bit64[%zd..%zd]\n", offset,
+				offset + words - 1);
+		pool->bits_filled += 64 * words;
 	}
 }
 
@@ -1275,6 +2026,13 @@ static void
 fill_buf(struct autoshrink_bit_pool* pool, const uint32_t bit_count,
 		uint64_t* dst)
 {
+	if (pool->base != NULL) {
+		read_cow_bits(pool, pool->consumed, bit_count, dst);
+		pool->consumed += bit_count;
+		sink_consumed_words(pool);
+		return;
+	}
+
 	const uint64_t* src        = (const uint64_t*)pool->bits;
 	size_t          src_offset = pool->consumed / 64;
 	uint8_t         src_bit    = (pool->consumed & 0x3f);
@@ -1332,6 +2090,36 @@ fill_buf(struct autoshrink_bit_pool* pool, const uint32_t bit_count,
 	}
 
 	pool->consumed += bit_count;
+	sink_consumed_words(pool);
+}
+
+// Sink the words POOL has consumed since the last call into its hash,
+// while they're still in cache.
+static void
+sink_consumed_words(struct autoshrink_bit_pool* pool)
+{
+	pool->hash_cached = false;
+	const size_t words = pool->consumed / 64;
+	if (pool->base == NULL) {
+		const uint64_t* bits64 = (const uint64_t*)pool->bits;
+		if (words > pool->hash_words) {
+			fuzz_hash128_sink(&pool->hash_state,
+					&bits64[pool->hash_words],
+					words - pool->hash_words);
+		}
+	} else {
+		uint64_t buf[64];
+		for (size_t done = pool->hash_words; done < words;) {
+			size_t count = words - done;
+			if (count > 64) {
+				count = 64;
+			}
+			read_cow_bits(pool, 64 * done, 64 * count, buf);
+			fuzz_hash128_sink(&pool->hash_state, buf, count);
+			done += count;
+		}
+	}
+	pool->hash_words = words;
 }
 
 static uint64_t
@@ -1350,7 +2138,7 @@ get_aligned_size(size_t size, uint8_t alignment)
 }
 
 static struct autoshrink_bit_pool*
-alloc_bit_pool(size_t size, size_t limit, size_t request_ceil)
+alloc_bit_pool(struct fuzz* t, size_t size, size_t limit, size_t request_ceil)
 {
 	uint8_t*                    bits     = NULL;
 	uint32_t*                   requests = NULL;
@@ -1359,14 +2147,22 @@ alloc_bit_pool(size_t size, size_t limit, size_t request_ceil)
 	size_t alloc_size = get_aligned_size(size, 64);
 	assert((alloc_size % 64) == 0);
 
+	if (t != NULL && t->spare_pools != NULL) {
+		return reuse_bit_pool(t, alloc_size, limit, request_ceil);
+	}
+
 	// Ensure that the allocation size is aligned to 64 bits, so we can
-	// work in 64-bit steps later on.
+	// work in 64-bit steps later on. Copy-on-write candidates are
+	// allocated without a bit buffer until they're committed.
 	LOG(3, "Allocating alloc_size %zd => %zd bytes\n", alloc_size,
 			(alloc_size / 64) * sizeof(uint64_t));
-	uint64_t* aligned_bits = calloc(alloc_size / 64, sizeof(uint64_t));
-	bits                   = (uint8_t*)aligned_bits;
-	if (bits == NULL) {
-		goto fail;
+	if (alloc_size > 0) {
+		uint64_t* aligned_bits =
+				calloc(alloc_size / 64, sizeof(uint64_t));
+		bits = (uint8_t*)aligned_bits;
+		if (bits == NULL) {
+			goto fail;
+		}
 	}
 
 	res = calloc(1, sizeof(*res));
@@ -1382,11 +2178,14 @@ alloc_bit_pool(size_t size, size_t limit, size_t request_ceil)
 	*res = (struct autoshrink_bit_pool){
 			.bits          = bits,
 			.bits_ceil     = alloc_size,
+			.bits_alloc    = alloc_size,
 			.limit         = limit,
 			.request_count = 0,
 			.request_ceil  = request_ceil,
 			.requests      = requests,
+			.ddmin_chunk   = DDMIN_NONE,
 	};
+	fuzz_hash128_init(&res->hash_state);
 	return res;
 
 fail:
@@ -1402,6 +2201,62 @@ fail:
 	return NULL;
 }
 
+// Take a pool from T's spare pools, growing its buffers if needed, and
+// reset it to look just like a newly allocated one. Its buffers are never
+// shrunk, so pools settle at the largest size needed, but only the ALLOC_SIZE
+// bits in use are zeroed.
+static struct autoshrink_bit_pool*
+reuse_bit_pool(struct fuzz* t, size_t alloc_size, size_t limit,
+		size_t request_ceil)
+{
+	struct autoshrink_bit_pool* pool = t->spare_pools;
+	t->spare_pools                   = pool->next;
+	t->spare_pool_count--;
+
+	if (pool->bits_alloc < alloc_size) {
+		uint64_t* nbits = realloc(pool->bits, alloc_size / 8);
+		if (nbits == NULL) {
+			goto fail;
+		}
+		pool->bits       = (uint8_t*)nbits;
+		pool->bits_alloc = alloc_size;
+	}
+	if (pool->request_ceil < request_ceil) {
+		uint32_t* nrequests = realloc(pool->requests,
+				request_ceil * sizeof(*nrequests));
+		if (nrequests == NULL) {
+			goto fail;
+		}
+		pool->requests     = nrequests;
+		pool->request_ceil = request_ceil;
+	}
+
+	if (alloc_size > 0) {
+		memset(pool->bits, 0x00, alloc_size / 8);
+	}
+	pool->bits_ceil     = alloc_size;
+	pool->shrinking     = false;
+	pool->bits_filled   = 0;
+	pool->limit         = limit;
+	pool->consumed      = 0;
+	pool->request_count = 0;
+	pool->generation    = 0;
+	pool->ddmin_chunk   = DDMIN_NONE;
+	pool->indexed       = false;
+	pool->hash_words    = 0;
+	pool->hash_cached   = false;
+	pool->next          = NULL;
+	pool->base          = NULL;
+	pool->span_count    = 0;
+	pool->patch_count   = 0;
+	fuzz_hash128_init(&pool->hash_state);
+	return pool;
+
+fail:
+	fuzz_autoshrink_free_bit_pool(NULL, pool);
+	return NULL;
+}
+
 void
 fuzz_autoshrink_free_bit_pool(struct fuzz* t, struct autoshrink_bit_pool* pool)
 {
@@ -1410,15 +2265,33 @@ fuzz_autoshrink_free_bit_pool(struct fuzz* t, struct autoshrink_bit_pool* pool)
 		assert(t->prng.bit_pool == NULL);
 	}
 	assert(pool);
-	assert(pool->bits);
+	if (t != NULL && t->spare_pool_count < AUTOSHRINK_SPARE_POOLS) {
+		pool->next     = t->spare_pools;
+		t->spare_pools = pool;
+		t->spare_pool_count++;
+		return;
+	}
 	if (pool->index) {
 		free(pool->index);
 	}
 	free(pool->bits);
 	free(pool->requests);
+	free(pool->spans);
+	free(pool->patches);
 	free(pool);
 }
 
+void
+fuzz_autoshrink_free_spare_pools(struct fuzz* t)
+{
+	while (t->spare_pools != NULL) {
+		struct autoshrink_bit_pool* pool = t->spare_pools;
+		t->spare_pools                   = pool->next;
+		fuzz_autoshrink_free_bit_pool(NULL, pool);
+	}
+	t->spare_pool_count = 0;
+}
+
 static int
 alloc_from_bit_pool(struct fuzz* t, struct autoshrink_env* env,
 		struct autoshrink_bit_pool* bit_pool, void** output,
@@ -1443,7 +2316,7 @@ fuzz_autoshrink_alloc(
 	const size_t pool_limit = GET_DEF(env->pool_limit, DEF_POOL_LIMIT);
 
 	struct autoshrink_bit_pool* pool = alloc_bit_pool(
-			pool_size, pool_limit, DEF_REQUESTS_CEIL);
+			t, pool_size, pool_limit, DEF_REQUESTS_CEIL);
 	if (pool == NULL) {
 		return FUZZ_RESULT_ERROR;
 	}
@@ -1459,42 +2332,56 @@ fuzz_autoshrink_alloc(
 	return FUZZ_RESULT_OK;
 }
 
-uint64_t
+void
 fuzz_autoshrink_hash(struct fuzz* t, const void* instance,
-		struct autoshrink_env* env, void* type_env)
+		struct autoshrink_env* env, void* type_env, uint64_t hash[2])
 {
 
 	// If the user has a hash callback defined, use it on
 	// the instance, otherwise hash the bit pool.
 	const struct fuzz_type_info* ti = t->prop.type_info[env->arg_i];
 	if (ti->hash != NULL) {
-		return ti->hash(instance, type_env);
+		hash[0] = ti->hash(instance, type_env);
+		hash[1] = 0;
 	} else {
 		struct autoshrink_bit_pool* pool = env->bit_pool;
 		assert(pool);
-		// Hash the consumed bits from the bit pool
-		uint64_t h = 0;
-		fuzz_hash_init(&h);
-		LOG(5 - LOG_AUTOSHRINK, "@@@ SINKING: [ ");
-		for (size_t i = 0; i < pool->consumed / 8; i++) {
-			LOG(5 - LOG_AUTOSHRINK, "%02x ", pool->bits[i]);
-		}
-		fuzz_hash_sink(&h, pool->bits, pool->consumed / 8);
-		const uint8_t rem_bits = pool->consumed % 8;
-		if (rem_bits > 0) {
-			const uint8_t last_byte =
-					pool->bits[pool->consumed / 8];
-			const uint8_t mask = ((1U << rem_bits) - 1);
-			uint8_t       rem  = last_byte & mask;
-			LOG(5 - LOG_AUTOSHRINK, "%02x/%d", rem, rem_bits);
-			fuzz_hash_sink(&h, &rem, 1);
-		}
-		LOG(5 - LOG_AUTOSHRINK, " ]\n");
-		uint64_t res = fuzz_hash_finish(&h);
-		LOG(2 - LOG_AUTOSHRINK, "%s: 0x%016" PRIx64 "\n", __func__,
-				res);
-		return res;
+		if (!pool->hash_cached) {
+			hash_bit_pool(pool);
+		}
+		hash[0] = pool->hash[0];
+		hash[1] = pool->hash[1];
+		LOG(2 - LOG_AUTOSHRINK,
+				"%s: 0x%016" PRIx64 "%016" PRIx64 "\n",
+				__func__, hash[1], hash[0]);
+	}
+}
+
+// Finish the hash of POOL's consumed bits: the whole words were already
+// sunk as they were consumed, so only the last partial word and the
+// number of bits are left.
+static void
+hash_bit_pool(struct autoshrink_bit_pool* pool)
+{
+	LOG(5 - LOG_AUTOSHRINK, "@@@ SINKING: [ ");
+	for (size_t i = 0; i < pool->consumed / 8; i++) {
+		LOG(5 - LOG_AUTOSHRINK, "%02x ",
+				(uint8_t)read_bits_at_offset(pool, 8 * i, 8));
+	}
+	LOG(5 - LOG_AUTOSHRINK, " ]\n");
+
+	assert(pool->hash_words == pool->consumed / 64);
+	struct fuzz_hash128 h   = pool->hash_state;
+	const uint8_t       rem = pool->consumed % 64;
+	if (rem != 0) {
+		const uint64_t last = read_bits_at_offset(
+				pool, pool->consumed - rem, rem);
+		fuzz_hash128_sink(&h, &last, 1);
 	}
+	const uint64_t consumed = pool->consumed;
+	fuzz_hash128_sink(&h, &consumed, 1);
+	fuzz_hash128_finish(&h, pool->hash);
+	pool->hash_cached = true;
 }
 
 int
@@ -1505,21 +2392,30 @@ fuzz_autoshrink_shrink(struct fuzz* t, struct autoshrink_env* env,
 	struct autoshrink_bit_pool* orig = env->bit_pool;
 	assert(orig);
 
-	if (tactic >= GET_DEF(env->max_failed_shrinks,
-				      DEF_MAX_FAILED_SHRINKS)) {
-		return FUZZ_SHRINK_NO_MORE_TACTICS;
-	}
-
 	if (!build_index(orig)) {
 		return FUZZ_SHRINK_ERROR;
 	}
 
-	// Make a copy of the bit pool to shrink
-	struct autoshrink_bit_pool* copy = alloc_bit_pool(
-			orig->bits_filled, orig->limit, orig->request_ceil);
+	// Once shrinks have stopped coming, give up, unless ddmin still has
+	// runs of requests to try deleting -- then only use ddmin.
+	const uint64_t min_gain =
+			GAIN_ONE / GET_DEF(env->max_failed_shrinks,
+						   DEF_MAX_FAILED_SHRINKS);
+	const bool ddmin   = sync_ddmin(env, orig);
+	const bool give_up = (env->model.gain < min_gain);
+	if (give_up && !ddmin) {
+		return FUZZ_SHRINK_NO_MORE_TACTICS;
+	}
+
+	// Make a copy-on-write copy of the bit pool to shrink. Its bits are
+	// only copied out of orig if it ends up being committed.
+	struct autoshrink_bit_pool* copy =
+			alloc_bit_pool(t, 0, orig->limit, orig->request_ceil);
 	if (copy == NULL) {
 		return FUZZ_SHRINK_ERROR;
 	}
+	copy->base            = orig;
+	copy->bits_ceil       = get_aligned_size(orig->bits_filled, 64);
 	copy->generation      = orig->generation + 1;
 	size_t total_consumed = 0;
 	for (size_t i = 0; i < orig->request_count; i++) {
@@ -1528,24 +2424,28 @@ fuzz_autoshrink_shrink(struct fuzz* t, struct autoshrink_env* env,
 	assert(total_consumed == orig->consumed);
 	copy->limit = orig->limit;
 
-	env->model.cur_tried = 0x00;
-	env->model.cur_set   = 0x00;
-
 	LOG(3 - LOG_AUTOSHRINK, "========== BEFORE (tactic %u)\n", tactic);
 	if (3 - LOG_AUTOSHRINK <= FUZZ_LOG_LEVEL) {
 		fuzz_autoshrink_dump_bit_pool(stdout, orig->bits_filled, orig,
 				FUZZ_AUTOSHRINK_PRINT_ALL);
 	}
 
-	if (env->model.weights[WEIGHT_DROP] == 0) {
-		init_model(env);
+	bool built;
+	switch (choose_tactic(t, env, ddmin, give_up)) {
+	case FUZZ_AUTOSHRINK_TACTIC_DDMIN:
+		built = ddmin_from_bit_pool(orig, copy, env->ddmin.next++,
+				env->ddmin.chunks);
+		break;
+	case FUZZ_AUTOSHRINK_TACTIC_DROP:
+		built = drop_from_bit_pool(t, env, orig, copy);
+		break;
+	default:
+		built = mutate_bit_pool(t, env, orig, copy);
+		break;
 	}
-
-	if (should_drop(t, env, orig->request_count)) {
-		env->model.cur_set |= ASA_DROP;
-		drop_from_bit_pool(t, env, orig, copy);
-	} else {
-		mutate_bit_pool(t, env, orig, copy);
+	if (!built) {
+		fuzz_autoshrink_free_bit_pool(t, copy);
+		return FUZZ_SHRINK_ERROR;
 	}
 	LOG(3 - LOG_AUTOSHRINK, "========== AFTER\n");
 	if (3 - LOG_AUTOSHRINK <= FUZZ_LOG_LEVEL) {
@@ -1568,71 +2468,304 @@ fuzz_autoshrink_shrink(struct fuzz* t, struct autoshrink_env* env,
 	}
 
 	assert(ares == FUZZ_RESULT_OK);
+	// Reward shrinks in proportion to how many fewer bits they use.
+	env->model.cur_reward = 1;
+	if (copy->consumed < orig->consumed) {
+		const size_t removed = orig->consumed - copy->consumed;
+		env->model.cur_reward += (FUZZ_AUTOSHRINK_MAX_REWARD - 1) *
+					 removed / orig->consumed;
+	}
 	*output          = res;
 	*output_bit_pool = copy;
 	return FUZZ_SHRINK_OK;
 }
 
-static void
-truncate_trailing_zero_bytes(struct autoshrink_bit_pool* pool)
-{
-	size_t       nsize     = 0;
-	const size_t byte_size = (pool->bits_filled / 8) +
-				 ((pool->bits_filled % 8) == 0 ? 0 : 1);
-	if (byte_size > 0) {
-		size_t i = byte_size;
-		do {
-			i--;
-			if (pool->bits[i] != 0x00) {
-				nsize = i + 1;
-				break;
-			}
-		} while (i > 0);
+// Catch ddmin up with ORIG, moving on to smaller runs of requests when it
+// has tried deleting each of the current ones. Returns false once no
+// single request can be deleted; otherwise, env->ddmin.next is the run to
+// try next.
+static bool
+sync_ddmin(struct autoshrink_env* env, const struct autoshrink_bit_pool* orig)
+{
+	struct autoshrink_ddmin* dd = &env->ddmin;
+	if (dd->chunks == 0) { // start with halves
+		dd->chunks = 2;
+		dd->next   = 0;
+	} else if (dd->generation != orig->generation) {
+		if (orig->ddmin_chunk != DDMIN_NONE) {
+			// A deletion worked: continue from the same place.
+			dd->chunks = (dd->chunks > 2 ? dd->chunks - 1 : 2);
+			dd->next   = orig->ddmin_chunk;
+		} else { // another tactic worked: start the pass over
+			dd->next = 0;
+		}
+		dd->done = false;
 	}
-	nsize *= 8;
-	LOG(2, "Truncating to nsize: %zd\n", nsize);
-	pool->bits_filled = nsize;
-	if (pool->limit > pool->bits_filled) {
-		pool->limit = pool->bits_filled;
+	dd->generation = orig->generation;
+
+	if (dd->done || orig->request_count == 0) {
+		return false;
+	}
+
+	if (dd->chunks > orig->request_count) {
+		dd->chunks = orig->request_count;
+	}
+	if (dd->next >= dd->chunks) { // nothing deleted: split them further
+		if (dd->chunks == orig->request_count) {
+			LOG(2 - LOG_AUTOSHRINK, "DDMIN: done\n");
+			dd->done = true;
+			return false;
+		}
+		dd->chunks *= 2;
+		if (dd->chunks > orig->request_count) {
+			dd->chunks = orig->request_count;
+		}
+		dd->next = 0;
 	}
+	return true;
 }
 
-static uint8_t
-popcount(uint64_t value)
+// Copy ORIG's requests into the copy-on-write pool, except for the run
+// of them in CHUNK, out of CHUNK_COUNT.
+static bool
+ddmin_from_bit_pool(const struct autoshrink_bit_pool* orig,
+		struct autoshrink_bit_pool* pool, size_t chunk,
+		size_t chunk_count)
+{
+	const size_t first = (chunk * orig->request_count) / chunk_count;
+	const size_t last = ((chunk + 1) * orig->request_count) / chunk_count;
+	const size_t from = offset_of_pos(orig, first);
+	const size_t to   = (last == orig->request_count
+					    ? orig->consumed
+					    : offset_of_pos(orig, last));
+	LOG(2 - LOG_AUTOSHRINK,
+			"DDMIN: deleting chunk %zd/%zd, requests %zd - %zd "
+			"(bits %zd - %zd)\n",
+			chunk, chunk_count, first, last, from, to);
+
+	if (!add_span(pool, 0, from) ||
+			!add_span(pool, to, orig->consumed - to)) {
+		return false;
+	}
+	pool->bits_filled = orig->consumed - (to - from);
+	pool->ddmin_chunk = chunk;
+	return true;
+}
+
+bool
+fuzz_autoshrink_commit_bit_pool(struct autoshrink_bit_pool* pool)
 {
-	uint8_t pop = 0;
-	for (uint8_t i = 0; i < 64; i++) {
-		if (value & (1LLU << i)) {
-			pop++;
+	if (pool->base == NULL) {
+		return true;
+	}
+
+	// Always give it a buffer, even if it's empty.
+	const size_t alloc_size = (pool->bits_ceil > 0 ? pool->bits_ceil : 64);
+	if (pool->bits_alloc < alloc_size) {
+		uint64_t* nbits = realloc(pool->bits, alloc_size / 8);
+		if (nbits == NULL) {
+			return false;
 		}
+		pool->bits       = (uint8_t*)nbits;
+		pool->bits_alloc = alloc_size;
 	}
-	return pop;
+
+	read_cow_bits(pool, 0, alloc_size, (uint64_t*)pool->bits);
+	pool->base        = NULL;
+	pool->span_count  = 0;
+	pool->patch_count = 0;
+	return true;
 }
 
-static uint8_t
-log2ceil(size_t value)
+void
+fuzz_autoshrink_read_bit_pool(const struct autoshrink_bit_pool* pool,
+		size_t bit_count, uint64_t* dst)
 {
-	uint8_t res = 0;
-	while ((1LLU << res) < value) {
-		res++;
+	if (pool->base != NULL) {
+		read_cow_bits(pool, 0, bit_count, dst);
+	} else {
+		const size_t words = (bit_count + 63) / 64;
+		memcpy(dst, pool->bits, words * sizeof(uint64_t));
 	}
-	return res;
 }
 
-// Copy the contents of the orig pool into the new pool, but with a
-// small probability of dropping individual requests.
-static void
-drop_from_bit_pool(struct fuzz* t, struct autoshrink_env* env,
-		const struct autoshrink_bit_pool* orig,
-		struct autoshrink_bit_pool*       copy)
+// Append SIZE bits of the base pool, starting at SRC, to a copy-on-write
+// pool, extending the last span when they directly follow it.
+static bool
+add_span(struct autoshrink_bit_pool* pool, size_t src, size_t size)
 {
-	size_t src_offset = 0;
-	size_t dst_offset = 0;
+	if (size == 0) {
+		return true;
+	}
+
+	size_t offset = 0;
+	if (pool->span_count > 0) {
+		struct pool_span* last = &pool->spans[pool->span_count - 1];
+		if (last->src + last->size == src) {
+			last->size += size;
+			return true;
+		}
+		offset = last->offset + last->size;
+	}
+
+	if (pool->span_count == pool->span_ceil) { // grow
+		const size_t nceil = (pool->span_ceil == 0
+						      ? DEF_REQUESTS_CEIL
+						      : 2 * pool->span_ceil);
+		struct pool_span* nspans =
+				realloc(pool->spans, nceil * sizeof(*nspans));
+		if (nspans == NULL) {
+			return false;
+		}
+		pool->spans     = nspans;
+		pool->span_ceil = nceil;
+	}
+
+	pool->spans[pool->span_count] = (struct pool_span){
+			.offset = offset,
+			.src    = src,
+			.size   = size,
+	};
+	pool->span_count++;
+	return true;
+}
+
+// Make room for COUNT more patches, so writing to a copy-on-write pool
+// can't fail partway through a mutation.
+static bool
+reserve_patches(struct autoshrink_bit_pool* pool, size_t count)
+{
+	if (pool->patch_count + count > pool->patch_ceil) {
+		const size_t       nceil    = pool->patch_count + count;
+		struct pool_patch* npatches = realloc(
+				pool->patches, nceil * sizeof(*npatches));
+		if (npatches == NULL) {
+			return false;
+		}
+		pool->patches    = npatches;
+		pool->patch_ceil = nceil;
+	}
+	return true;
+}
+
+// Read COUNT bits starting at BIT_OFFSET from a copy-on-write pool into
+// DST, clearing any bits past them in its last word.
+static void
+read_cow_bits(const struct autoshrink_bit_pool* pool, size_t bit_offset,
+		size_t count, uint64_t* dst)
+{
+	const struct autoshrink_bit_pool* base = pool->base;
+	assert(base != NULL && base->base == NULL);
+	const size_t end = bit_offset + count;
+	memset(dst, 0x00, ((count + 63) / 64) * sizeof(uint64_t));
+
+	// Find the first span that ends after bit_offset.
+	size_t lo = 0;
+	size_t hi = pool->span_count;
+	while (lo < hi) {
+		const size_t            mid  = lo + (hi - lo) / 2;
+		const struct pool_span* span = &pool->spans[mid];
+		if (span->offset + span->size <= bit_offset) {
+			lo = mid + 1;
+		} else {
+			hi = mid;
+		}
+	}
+
+	for (size_t i = lo; i < pool->span_count; i++) {
+		const struct pool_span* span = &pool->spans[i];
+		if (span->offset >= end) {
+			break;
+		}
+		const size_t send = span->offset + span->size;
+		const size_t from = (span->offset > bit_offset ? span->offset
+							       : bit_offset);
+		const size_t to   = (send < end ? send : end);
+		copy_bits(dst, from - bit_offset, (const uint64_t*)base->bits,
+				span->src + (from - span->offset), to - from);
+	}
+
+	// Apply the patches in order, so later writes win.
+	for (size_t i = 0; i < pool->patch_count; i++) {
+		const struct pool_patch* patch = &pool->patches[i];
+		const size_t             pend  = patch->offset + patch->size;
+		if (patch->offset >= end || pend <= bit_offset) {
+			continue;
+		}
+		const size_t from = (patch->offset > bit_offset ? patch->offset
+								: bit_offset);
+		const size_t to   = (pend < end ? pend : end);
+		write_word_bits(dst, from - bit_offset, (uint8_t)(to - from),
+				patch->bits >> (from - patch->offset));
+	}
+}
+
+static void
+truncate_trailing_zero_bytes(struct autoshrink_bit_pool* pool)
+{
+	size_t       nsize     = 0;
+	const size_t byte_size = (pool->bits_filled / 8) +
+				 ((pool->bits_filled % 8) == 0 ? 0 : 1);
+
+	// Skip zero words from the end, then find the last non-zero byte
+	// in the last non-zero word.
+	size_t word_count = (byte_size + 7) / 8;
+	while (word_count > 0) {
+		uint64_t word = read_bits_at_offset(
+				pool, 64 * (word_count - 1), 64);
+		if (word_count * 8 > byte_size) { // ignore bytes past the end
+			word &= get_autoshrink_mask(8 * (byte_size % 8));
+		}
+		if (word != 0) {
+			size_t byte = 7;
+			while ((word >> (8 * byte)) == 0) {
+				byte--;
+			}
+			nsize = 8 * (word_count - 1) + byte + 1;
+			break;
+		}
+		word_count--;
+	}
+	nsize *= 8;
+	LOG(2, "Truncating to nsize: %zd\n", nsize);
+	pool->bits_filled = nsize;
+	if (pool->limit > pool->bits_filled) {
+		pool->limit = pool->bits_filled;
+	}
+}
+
+static uint8_t
+popcount(uint64_t value)
+{
+	uint8_t pop = 0;
+	for (uint8_t i = 0; i < 64; i++) {
+		if (value & (1LLU << i)) {
+			pop++;
+		}
+	}
+	return pop;
+}
+
+static uint8_t
+log2ceil(size_t value)
+{
+	uint8_t res = 0;
+	while ((1LLU << res) < value) {
+		res++;
+	}
+	return res;
+}
 
-	size_t  src_byte = 0;
-	size_t  dst_byte = 0;
-	uint8_t src_bit  = 0x01;
-	uint8_t dst_bit  = 0x01;
+// Copy the contents of the orig pool into the new pool, but with a
+// small probability of dropping individual requests. The kept bits are
+// added to the copy-on-write pool as spans of orig.
+static bool
+drop_from_bit_pool(struct fuzz* t, struct autoshrink_env* env,
+		const struct autoshrink_bit_pool* orig,
+		struct autoshrink_bit_pool*       copy)
+{
+	size_t src_offset = 0;
+	size_t dst_offset = 0;
 
 	// If N random bits are <= DROP_THRESHOLD, then drop the
 	// current request, otherwise copy it.
@@ -1671,60 +2804,32 @@ drop_from_bit_pool(struct fuzz* t, struct autoshrink_env* env,
 						"of %u\n",
 						drop_offset, drop_size,
 						req_size);
-				for (size_t bi = 0; bi < req_size; bi++) {
-					if (bi < drop_offset ||
-							bi > drop_offset + drop_size) {
-						if (orig->bits[src_byte] &
-								src_bit) {
-							copy->bits[dst_byte] |=
-									dst_bit;
-						}
-
-						dst_bit <<= 1;
-						if (dst_bit == 0x00) {
-							dst_bit = 0x01;
-							dst_byte++;
-						}
-						dst_offset++;
-					}
 
-					src_bit <<= 1;
-					if (src_bit == 0x00) {
-						src_bit = 0x01;
-						src_byte++;
-					}
-					src_offset++;
+				// Bits [drop_offset, drop_offset + drop_size]
+				// are dropped, and the bits around them kept.
+				if (!add_span(copy, src_offset, drop_offset)) {
+					return false;
 				}
-			} else { // drop all
-				for (size_t bi = 0; bi < req_size; bi++) {
-					src_bit <<= 1;
-					if (src_bit == 0x00) {
-						src_bit = 0x01;
-						src_byte++;
+				dst_offset += drop_offset;
+				const uint64_t resume =
+						(uint64_t)drop_offset +
+						drop_size + 1;
+				if (resume < req_size) {
+					const size_t rest = req_size - resume;
+					const size_t at = src_offset + resume;
+					if (!add_span(copy, at, rest)) {
+						return false;
 					}
-					src_offset++;
+					dst_offset += rest;
 				}
 			}
+			src_offset += req_size; // else drop all
 		} else { // copy
-			for (size_t bi = 0; bi < req_size; bi++) {
-				if (orig->bits[src_byte] & src_bit) {
-					copy->bits[dst_byte] |= dst_bit;
-				}
-
-				src_bit <<= 1;
-				if (src_bit == 0x00) {
-					src_bit = 0x01;
-					src_byte++;
-				}
-				src_offset++;
-
-				dst_bit <<= 1;
-				if (dst_bit == 0x00) {
-					dst_bit = 0x01;
-					dst_byte++;
-				}
-				dst_offset++;
+			if (!add_span(copy, src_offset, req_size)) {
+				return false;
 			}
+			src_offset += req_size;
+			dst_offset += req_size;
 		}
 	}
 
@@ -1732,16 +2837,21 @@ drop_from_bit_pool(struct fuzz* t, struct autoshrink_env* env,
 			orig->bits_filled, dst_offset, drop_count);
 	(void)drop_count;
 	copy->bits_filled = dst_offset;
+	return true;
 }
 
-static void
+// Make a few random changes to the copy-on-write pool, which starts out
+// as all of orig's bits; the changes are recorded as patches over them.
+static bool
 mutate_bit_pool(struct fuzz* t, struct autoshrink_env* env,
 		const struct autoshrink_bit_pool* orig,
 		struct autoshrink_bit_pool*       pool)
 {
 	const size_t orig_bytes = (orig->bits_filled / 8) +
 				  ((orig->bits_filled % 8) == 0 ? 0 : 1);
-	memcpy(pool->bits, orig->bits, orig_bytes);
+	if (!add_span(pool, 0, 8 * orig_bytes)) {
+		return false;
+	}
 	pool->bits_filled = orig->bits_filled;
 
 	autoshrink_prng_fun* prng = get_prng(t, env);
@@ -1784,6 +2894,11 @@ mutate_bit_pool(struct fuzz* t, struct autoshrink_env* env,
 
 	uint8_t changed = 0;
 
+	// Each attempt writes at most two patches.
+	if (!reserve_patches(pool, 2 * 10U * change_count)) {
+		return false;
+	}
+
 	// Attempt to make up to CHANGE_COUNT changes, with limited retries
 	// for when the random modifications have no effect.
 	for (size_t i = 0; i < 10U * change_count; i++) {
@@ -1816,6 +2931,7 @@ mutate_bit_pool(struct fuzz* t, struct autoshrink_env* env,
 	size_t nsize = orig->consumed +
 		       (orig->bits_filled - orig->consumed) / 2;
 	pool->limit = nsize < pool->limit ? nsize : pool->limit;
+	return true;
 }
 
 static bool
@@ -1824,7 +2940,7 @@ choose_and_mutate_request(struct fuzz* t, struct autoshrink_env* env,
 		struct autoshrink_bit_pool*       pool)
 {
 	autoshrink_prng_fun* prng  = get_prng(t, env);
-	enum mutation        mtype = get_weighted_mutation(t, env);
+	enum mutation        mtype = get_mutation(env);
 
 	const uint8_t request_bits = log2ceil(orig->request_count);
 
@@ -1843,7 +2959,6 @@ choose_and_mutate_request(struct fuzz* t, struct autoshrink_env* env,
 	default:
 		assert(false);
 	case MUT_SHIFT: {
-		env->model.cur_tried |= ASA_SHIFT;
 		const uint8_t shift     = prng(2, env->udata) + 1;
 		uint64_t      new_pos   = 0;
 		uint32_t      to_change = 0;
@@ -1870,14 +2985,12 @@ choose_and_mutate_request(struct fuzz* t, struct autoshrink_env* env,
 		write_bits_at_offset(pool, bit_offset + new_pos,
 				(uint8_t)to_change, nbits);
 		if (bits != nbits) {
-			env->model.cur_set |= ASA_SHIFT;
 			return true;
 		}
 
 		return false;
 	}
 	case MUT_MASK: {
-		env->model.cur_tried |= ASA_MASK;
 		// Clear each bit with 1/4 probability
 		uint8_t  mask_size = (size <= 64 ? size : 64);
 		uint64_t mask      = prng(mask_size, env->udata) |
@@ -1912,14 +3025,12 @@ choose_and_mutate_request(struct fuzz* t, struct autoshrink_env* env,
 		write_bits_at_offset(pool, bit_offset + new_pos,
 				(uint8_t)to_change, nbits);
 		if (bits != nbits) {
-			env->model.cur_set |= ASA_MASK;
 			return true;
 		}
 
 		return false;
 	}
 	case MUT_SWAP: {
-		env->model.cur_tried |= ASA_SWAP;
 		assert(size > 0);
 		if (size > 64) {
 			// maybe swap two blocks non-overlapping within the
@@ -1956,7 +3067,6 @@ choose_and_mutate_request(struct fuzz* t, struct autoshrink_env* env,
 						to_swap, b);
 				write_bits_at_offset(pool, bit_offset + pos_b,
 						to_swap, a);
-				env->model.cur_set |= ASA_SWAP;
 				return true;
 			}
 			return false;
@@ -1989,7 +3099,6 @@ choose_and_mutate_request(struct fuzz* t, struct autoshrink_env* env,
 								other_offset,
 								(uint8_t)size,
 								bits);
-						env->model.cur_set |= ASA_SWAP;
 						return true;
 					}
 				}
@@ -2000,7 +3109,6 @@ choose_and_mutate_request(struct fuzz* t, struct autoshrink_env* env,
 		return false;
 	}
 	case MUT_SUB: {
-		env->model.cur_tried |= ASA_SUB;
 		uint8_t        sub_size  = (size <= 64 ? size : 64);
 		const uint64_t sub       = prng(sub_size, env->udata);
 		uint64_t       new_pos   = 0;
@@ -2027,7 +3135,6 @@ choose_and_mutate_request(struct fuzz* t, struct autoshrink_env* env,
 					" -> 0x%016" PRIx64 "\n",
 					sub, size, new_pos, bit_offset, bits,
 					nbits);
-			env->model.cur_set |= ASA_SUB;
 			write_bits_at_offset(pool, bit_offset + new_pos,
 					to_change, nbits);
 			return true;
@@ -2040,18 +3147,23 @@ choose_and_mutate_request(struct fuzz* t, struct autoshrink_env* env,
 static bool
 build_index(struct autoshrink_bit_pool* pool)
 {
-	if (pool->index == NULL) {
-		size_t* index = malloc(pool->request_count * sizeof(size_t));
-		if (index == NULL) {
-			return false;
+	if (!pool->indexed) {
+		if (pool->index_ceil < pool->request_count) {
+			size_t* index = realloc(pool->index,
+					pool->request_count * sizeof(size_t));
+			if (index == NULL) {
+				return false;
+			}
+			pool->index      = index;
+			pool->index_ceil = pool->request_count;
 		}
 
 		size_t total = 0;
 		for (size_t i = 0; i < pool->request_count; i++) {
-			index[i] = total;
+			pool->index[i] = total;
 			total += pool->requests[i];
 		}
-		pool->index = index;
+		pool->indexed = true;
 	}
 	return true;
 }
@@ -2059,63 +3171,109 @@ build_index(struct autoshrink_bit_pool* pool)
 static size_t
 offset_of_pos(const struct autoshrink_bit_pool* orig, size_t pos)
 {
-	assert(orig->index);
+	assert(orig->indexed);
 	return orig->index[pos];
 }
 
+// Read SIZE (at most 64) bits starting at BIT_OFFSET in WORDS, combining
+// the two words they may straddle.
+static uint64_t
+read_word_bits(const uint64_t* words, size_t bit_offset, uint8_t size)
+{
+	assert(size <= 64);
+	if (size == 0) {
+		return 0;
+	}
+	const size_t  word  = bit_offset / 64;
+	const uint8_t shift = bit_offset % 64;
+	uint64_t      acc   = words[word] >> shift;
+	if (shift + size > 64) {
+		acc |= words[word + 1] << (64 - shift);
+	}
+	return acc & get_autoshrink_mask(size);
+}
+
+// Overwrite SIZE (at most 64) bits starting at BIT_OFFSET in WORDS with the
+// low bits of BITS, leaving the bits around them alone.
 static void
-convert_bit_offset(size_t bit_offset, size_t* byte_offset, uint8_t* bit)
+write_word_bits(uint64_t* words, size_t bit_offset, uint8_t size,
+		uint64_t bits)
 {
-	*byte_offset = bit_offset / 8;
-	*bit         = bit_offset % 8;
+	assert(size <= 64);
+	if (size == 0) {
+		return;
+	}
+	const size_t   word  = bit_offset / 64;
+	const uint8_t  shift = bit_offset % 64;
+	const uint64_t mask  = get_autoshrink_mask(size);
+	bits &= mask;
+	words[word] = (words[word] & ~(mask << shift)) | (bits << shift);
+	if (shift + size > 64) {
+		const uint8_t done = 64 - shift;
+		words[word + 1]    = (words[word + 1] & ~(mask >> done)) |
+				  (bits >> done);
+	}
+}
+
+// Copy COUNT bits from SRC at SRC_OFFSET to DST at DST_OFFSET, up to a
+// word at a time. When both offsets are word-aligned, whole words are
+// copied directly.
+static void
+copy_bits(uint64_t* dst, size_t dst_offset, const uint64_t* src,
+		size_t src_offset, size_t count)
+{
+	if (count >= 64 && (dst_offset % 64) == 0 && (src_offset % 64) == 0) {
+		const size_t words = count / 64;
+		memcpy(&dst[dst_offset / 64], &src[src_offset / 64],
+				words * sizeof(uint64_t));
+		dst_offset += 64 * words;
+		src_offset += 64 * words;
+		count -= 64 * words;
+	}
+
+	while (count > 0) {
+		// Fill the rest of the current destination word.
+		uint8_t size = 64 - (dst_offset % 64);
+		if (size > count) {
+			size = (uint8_t)count;
+		}
+		write_word_bits(dst, dst_offset, size,
+				read_word_bits(src, src_offset, size));
+		dst_offset += size;
+		src_offset += size;
+		count -= size;
+	}
 }
 
 static uint64_t
 read_bits_at_offset(const struct autoshrink_bit_pool* pool, size_t bit_offset,
 		uint8_t size)
 {
-	size_t  byte = 0;
-	uint8_t bit  = 0;
-	convert_bit_offset(bit_offset, &byte, &bit);
-	uint64_t acc   = 0;
-	uint8_t  bit_i = 0x01 << bit;
-
-	for (uint8_t i = 0; i < size; i++) {
-		LOG(5, "byte %zd, size %zd\n", byte, pool->bits_filled);
-		if (pool->bits[byte] & bit_i) {
-			acc |= (1LLU << i);
-		}
-		bit_i <<= 1;
-		if (bit_i == 0) {
-			byte++;
-			bit_i = 0x01;
-		}
+	LOG(5, "offset %zd, size %u, filled %zd\n", bit_offset, size,
+			pool->bits_filled);
+	if (pool->base != NULL) {
+		uint64_t bits = 0;
+		read_cow_bits(pool, bit_offset, size, &bits);
+		return bits;
 	}
-
-	return acc;
+	return read_word_bits((const uint64_t*)pool->bits, bit_offset, size);
 }
 
 static void
 write_bits_at_offset(struct autoshrink_bit_pool* pool, size_t bit_offset,
 		uint8_t size, uint64_t bits)
 {
-	size_t  byte = 0;
-	uint8_t bit  = 0;
-	convert_bit_offset(bit_offset, &byte, &bit);
-	uint8_t bit_i = 0x01 << bit;
-
-	for (uint8_t i = 0; i < size; i++) {
-		if (bits & (1LLU << i)) {
-			pool->bits[byte] |= bit_i;
-		} else {
-			pool->bits[byte] &= ~bit_i;
-		}
-		bit_i <<= 1;
-		if (bit_i == 0) {
-			byte++;
-			bit_i = 0x01;
-		}
+	if (pool->base != NULL) {
+		assert(pool->patch_count < pool->patch_ceil);
+		pool->patches[pool->patch_count] = (struct pool_patch){
+				.offset = bit_offset,
+				.size   = size,
+				.bits   = bits & get_autoshrink_mask(size),
+		};
+		pool->patch_count++;
+		return;
 	}
+	write_word_bits((uint64_t*)pool->bits, bit_offset, size, bits);
 }
 
 void
@@ -2132,9 +3290,8 @@ fuzz_autoshrink_dump_bit_pool(FILE* f, size_t bit_count,
 
 	// Print the raw buffer.
 	if (print_mode & FUZZ_AUTOSHRINK_PRINT_BIT_POOL) {
-		prev                      = true;
-		const uint8_t* bits       = pool->bits;
-		const size_t   byte_count = bit_count / 8;
+		prev                    = true;
+		const size_t byte_count = bit_count / 8;
 		const char     prefix[]   = "raw:  ";
 		const char     left_pad[] = "      ";
 		assert(strlen(prefix) == strlen(left_pad));
@@ -2143,8 +3300,6 @@ fuzz_autoshrink_dump_bit_pool(FILE* f, size_t bit_count,
 		for (size_t i = 0; i < byte_count; i++) {
 			const uint8_t byte =
 					read_bits_at_offset(pool, 8 * i, 8);
-			const uint8_t byte2 = bits[i];
-			assert(byte == byte2);
 			fprintf(f, "%02x ", byte);
 			if ((i & 0x0f) == 0x0f) {
 				fprintf(f, "\n%s", left_pad);
@@ -2154,8 +3309,8 @@ fuzz_autoshrink_dump_bit_pool(FILE* f, size_t bit_count,
 		}
 		const uint8_t rem = bit_count % 8;
 		if (rem != 0) {
-			const uint8_t byte =
-					bits[byte_count] & ((1U << rem) - 1);
+			const uint8_t byte = read_bits_at_offset(
+					pool, 8 * byte_count, rem);
 			fprintf(f, "%02x/%d", byte, rem);
 			if ((byte_count & 0x0f) == 0x0e) {
 				fprintf(f, "\n");
@@ -2302,167 +3457,209 @@ get_prng(struct fuzz* t, struct autoshrink_env* env)
 	}
 }
 
-static void
-init_model(struct autoshrink_env* env)
-{
-	if (env->model.next_action != 0x00) {
-		return; // a test has an action scheduled
-	}
-	env->model = (struct autoshrink_model){
-			.weights =
-					{
-							[WEIGHT_DROP] = TWO_EVENLY,
-							[WEIGHT_SHIFT] =
-									FOUR_EVENLY,
-							[WEIGHT_MASK] = FOUR_EVENLY,
-							[WEIGHT_SWAP] = FOUR_EVENLY -
-									0x10,
-							[WEIGHT_SUB] = FOUR_EVENLY,
-					},
-	};
-}
-
-static bool
-should_drop(struct fuzz* t, struct autoshrink_env* env, size_t request_count)
+// Choose the tactic for the next shrink candidate, and count it as tried.
+// DDMIN says whether ddmin is still available; if DDMIN_ONLY, nothing else
+// is.
+static enum fuzz_autoshrink_tactic
+choose_tactic(struct fuzz* t, struct autoshrink_env* env, bool ddmin,
+		bool ddmin_only)
 {
-	autoshrink_prng_fun* prng = get_prng(t, env);
-	// Limit the odds of dropping when there are only a few requests
-	const int rc_mul = 8;
-	uint8_t   weight = env->model.weights[WEIGHT_DROP];
-	if (weight > rc_mul * request_count) {
-		weight = rc_mul * request_count;
-	}
-	if (env->model.next_action == 0x00) {
-		return prng(8, env->udata) < weight;
-	} else {
-		return env->model.next_action == ASA_DROP;
-	}
-}
+	struct autoshrink_model*        model   = &env->model;
+	struct fuzz_autoshrink_weights* w       = t->autoshrink_weights;
+	uint32_t*                       tries   = w->tries[env->arg_i];
+	uint32_t*                       rewards = w->rewards[env->arg_i];
 
-static enum mutation
-get_weighted_mutation(struct fuzz* t, struct autoshrink_env* env)
-{
-	if (env->model.next_action != 0x00) {
-		switch (env->model.next_action) {
+	lock_weights(t);
+	enum fuzz_autoshrink_tactic res = FUZZ_AUTOSHRINK_TACTIC_DDMIN;
+	if (model->next_action != 0x00) {
+		switch (model->next_action) {
 		default:
 			assert(false);
+		case ASA_DROP:
+			res = FUZZ_AUTOSHRINK_TACTIC_DROP;
+			break;
 		case ASA_SHIFT:
-			return MUT_SHIFT;
+			res = FUZZ_AUTOSHRINK_TACTIC_SHIFT;
+			break;
 		case ASA_MASK:
-			return MUT_MASK;
+			res = FUZZ_AUTOSHRINK_TACTIC_MASK;
+			break;
 		case ASA_SWAP:
-			return MUT_SWAP;
+			res = FUZZ_AUTOSHRINK_TACTIC_SWAP;
+			break;
 		case ASA_SUB:
-			return MUT_SUB;
+			res = FUZZ_AUTOSHRINK_TACTIC_SUB;
+			break;
+		}
+	} else if (!ddmin_only) {
+		const size_t count = (ddmin ? FUZZ_AUTOSHRINK_TACTIC_COUNT
+					    : FUZZ_AUTOSHRINK_TACTIC_DDMIN);
+		uint64_t     total = 0;
+		for (size_t i = 0; i < count; i++) {
+			total += tries[i];
+		}
+
+		// UCB1-Tuned, in 16.16 fixed point. Untried tactics go first.
+		const uint64_t ln         = fixed_ln(total == 0 ? 1 : total);
+		uint64_t       best_score = 0;
+		for (size_t i = 0; i < count; i++) {
+			if (tries[i] == 0) {
+				res = (enum fuzz_autoshrink_tactic)i;
+				break;
+			}
+			const uint64_t n    = tries[i];
+			const uint64_t mean = ((uint64_t)rewards[i] << 16) /
+					      (FUZZ_AUTOSHRINK_MAX_REWARD * n);
+			const uint64_t var  = mean - ((mean * mean) >> 16);
+			const uint64_t bias = isqrt(((2 * ln) << 16) / n);
+			uint64_t       v    = var + bias;
+			if (v > (1 << 14)) { // at most 1/4
+				v = 1 << 14;
+			}
+			const uint64_t score = mean + isqrt((ln * v) / n);
+			LOG(4 - LOG_AUTOSHRINK,
+					"%s: tactic %zd, %" PRIu32 "/%" PRIu32
+					", score 0x%05" PRIx64 "\n",
+					__func__, i, rewards[i], tries[i],
+					score);
+			if (i == 0 || score > best_score) {
+				res        = (enum fuzz_autoshrink_tactic)i;
+				best_score = score;
+			}
+		}
+	}
+	LOG(3 - LOG_AUTOSHRINK, "%s: tactic %d\n", __func__, res);
+
+	// Count it as tried now, so speculative shrinking spreads the
+	// candidates it makes before seeing any results across tactics.
+	tries[res]++;
+	uint64_t total = 0;
+	for (size_t i = 0; i < FUZZ_AUTOSHRINK_TACTIC_COUNT; i++) {
+		total += tries[i];
+	}
+	while (total > WEIGHTS_MAX_TRIES) {
+		total = 0;
+		for (size_t i = 0; i < FUZZ_AUTOSHRINK_TACTIC_COUNT; i++) {
+			tries[i] /= 2;
+			rewards[i] /= 2;
+			total += tries[i];
 		}
 	}
+	unlock_weights(t);
+
+	// Every attempt counts as a miss until its result says otherwise.
+	model->gain -= (model->gain + model->gain_window - 1) /
+		       model->gain_window;
+	model->cur_tactic = res;
+	return res;
+}
 
-	const uint16_t shift = env->model.weights[WEIGHT_SHIFT];
-	const uint16_t mask  = shift + env->model.weights[WEIGHT_MASK];
-	const uint16_t swap  = mask + env->model.weights[WEIGHT_SWAP];
-	const uint16_t sub   = swap + env->model.weights[WEIGHT_SUB];
+static enum mutation
+get_mutation(const struct autoshrink_env* env)
+{
+	switch (env->model.cur_tactic) {
+	default:
+		assert(false);
+	case FUZZ_AUTOSHRINK_TACTIC_SHIFT:
+		return MUT_SHIFT;
+	case FUZZ_AUTOSHRINK_TACTIC_MASK:
+		return MUT_MASK;
+	case FUZZ_AUTOSHRINK_TACTIC_SWAP:
+		return MUT_SWAP;
+	case FUZZ_AUTOSHRINK_TACTIC_SUB:
+		return MUT_SUB;
+	}
+}
 
-	LOG(4 - LOG_AUTOSHRINK,
-			"%s: shift %04x, mask %04x, swap %04x, sub %04x => "
-			"LIMIT %04x\n",
-			__func__, env->model.weights[WEIGHT_SHIFT],
-			env->model.weights[WEIGHT_MASK],
-			env->model.weights[WEIGHT_SWAP],
-			env->model.weights[WEIGHT_SUB], sub);
-	uint8_t bit_count = 7;
-	while ((1LU << bit_count) < sub) {
-		bit_count++;
+// Natural log of X, in 16.16 fixed point: log2, with the fraction
+// interpolated linearly between powers of 2, times ln(2).
+static uint64_t
+fixed_ln(uint64_t x)
+{
+	assert(x > 0);
+	uint8_t k = 0;
+	while ((x >> (k + 1)) != 0) {
+		k++;
 	}
-	assert(bit_count <= 16);
+	const uint64_t log2 =
+			((uint64_t)k << 16) + (((x - (1LLU << k)) << 16) >> k);
+	return (log2 * 45426) >> 16; // ln(2) * 0x10000
+}
 
-	for (;;) {
-		const uint16_t bits = fuzz_random_bits(t, bit_count);
-		LOG(4 - LOG_AUTOSHRINK, "%s: 0x%04x -- ", __func__, bits);
-		if (bits < shift) {
-			LOG(4 - LOG_AUTOSHRINK, "SHIFT\n");
-			return MUT_SHIFT;
-		} else if (bits < mask) {
-			LOG(4 - LOG_AUTOSHRINK, "MASK\n");
-			return MUT_MASK;
-		} else if (bits < swap) {
-			LOG(4 - LOG_AUTOSHRINK, "SWAP\n");
-			return MUT_SWAP;
-		} else if (bits < sub) {
-			LOG(4 - LOG_AUTOSHRINK, "SUB\n");
-			return MUT_SUB;
+static uint64_t
+isqrt(uint64_t x)
+{
+	uint64_t res = 0;
+	for (uint64_t bit = 1LLU << 62; bit != 0; bit >>= 2) {
+		if (x >= res + bit) {
+			x -= res + bit;
+			res = (res >> 1) + bit;
 		} else {
-			LOG(4 - LOG_AUTOSHRINK, "continue\n");
-			continue; // draw again
+			res >>= 1;
 		}
 	}
+	return res;
 }
 
+// The run's threads share t->autoshrink_weights, so take their lock while
+// using it. Handles that aren't a thread's don't need to.
 static void
-adjust(struct autoshrink_model* model, enum autoshrink_weight w, uint8_t min,
-		uint8_t max, int8_t adjustment)
+lock_weights(struct fuzz* t)
 {
-	enum autoshrink_action flag = (enum autoshrink_action)(1U << w);
-	uint8_t                nv   = 0;
-	if (model->cur_set & flag) {
-		nv = model->weights[w] + adjustment;
-	} else if ((model->cur_tried & flag) && adjustment > 0) {
-		// De-emphasize actions that produced no changes, but don't add
-		// emphasis to them if they caused the property to pass
-		// (leading to a negative adjustment)
-		LOG(3 - LOG_AUTOSHRINK, "DE-EMPHASIZING flag 0x%02x by %u\n",
-				flag, adjustment);
-		nv = model->weights[w] - adjustment;
-		LOG(3 - LOG_AUTOSHRINK, "  -- was %u, now %u\n",
-				model->weights[w], nv);
+#if !defined(_WIN32)
+	if (t->thread != NULL) {
+		pthread_mutex_lock(&t->thread->weights_lock);
 	}
+#else
+	(void)t;
+#endif
+}
 
-	if (nv != 0) {
-		if (nv > max) {
-			nv = max;
-		} else if (nv < min) {
-			nv = min;
-		}
-		model->weights[w] = nv;
+static void
+unlock_weights(struct fuzz* t)
+{
+#if !defined(_WIN32)
+	if (t->thread != NULL) {
+		pthread_mutex_unlock(&t->thread->weights_lock);
 	}
+#else
+	(void)t;
+#endif
 }
 
 void
-fuzz_autoshrink_update_model(
-		struct fuzz* t, uint8_t arg_id, int res, uint8_t adjustment)
+fuzz_autoshrink_update_model(struct fuzz* t, uint8_t arg_id, int res)
 {
 	// If this type isn't using autoshrink, there's nothing to do.
 	if (t->prop.type_info[arg_id]->autoshrink_config.enable == false) {
 		return;
 	}
 
-	struct autoshrink_env* env = t->trial.args[arg_id].u.as.env;
-
-	const uint8_t cur_set = env->model.cur_set;
-	if (cur_set == 0x00) {
+	struct autoshrink_env*   env   = t->trial.args[arg_id].u.as.env;
+	struct autoshrink_model* model = &env->model;
+	LOG(3 - LOG_AUTOSHRINK, "%s: res %d, arg_id %u, tactic %d\n",
+			__func__, res, arg_id, model->cur_tactic);
+	if (!FUZZ_RESULT_IS_FAIL(res)) {
 		return;
 	}
 
-	uint8_t adj = (res == FUZZ_RESULT_FAIL ? adjustment : -adjustment);
-
-	LOG(3 - LOG_AUTOSHRINK,
-			"%s: res %d, arg_id %u, adj %u, cur_set 0x%02x\n",
-			__func__, res, arg_id, adjustment, cur_set);
+	struct fuzz_autoshrink_weights* w       = t->autoshrink_weights;
+	uint32_t*                       rewards = &w->rewards[arg_id][0];
+	const uint8_t                   tactic  = model->cur_tactic;
 
-	adjust(&env->model, WEIGHT_DROP, DROPS_MIN, DROPS_MAX, adj);
-	adjust(&env->model, WEIGHT_SHIFT, MODEL_MIN, MODEL_MAX, adj);
-	adjust(&env->model, WEIGHT_MASK, MODEL_MIN, MODEL_MAX, adj);
-	adjust(&env->model, WEIGHT_SWAP, MODEL_MIN, MODEL_MAX, adj);
-	adjust(&env->model, WEIGHT_SUB, MODEL_MIN, MODEL_MAX, adj);
+	lock_weights(t);
+	const uint64_t max = FUZZ_AUTOSHRINK_MAX_REWARD *
+			     (uint64_t)w->tries[arg_id][tactic];
+	rewards[tactic] += model->cur_reward;
+	if (rewards[tactic] > max) {
+		rewards[tactic] = (uint32_t)max;
+	}
+	unlock_weights(t);
 
-	LOG(3 - LOG_AUTOSHRINK,
-			"cur_set: %02" PRIx8 " -- new weights DROP %u SHIFT "
-			"%u MASK %u SWAP %u SUB %u\n",
-			(uint8_t)env->model.cur_set,
-			env->model.weights[WEIGHT_DROP],
-			env->model.weights[WEIGHT_SHIFT],
-			env->model.weights[WEIGHT_MASK],
-			env->model.weights[WEIGHT_SWAP],
-			env->model.weights[WEIGHT_SUB]);
+	model->gain += GAIN_ONE / model->gain_window;
+	if (model->gain > GAIN_ONE) {
+		model->gain = GAIN_ONE;
+	}
 }
 
 void
@@ -2851,10 +4048,36 @@ fuzz_get_builtin_type_info(enum fuzz_builtin_type_info type)
 #include <stdbool.h>
 #include <stddef.h>
 
-#define FUZZ_POLYFILL_HAVE_FORK true
+#define FUZZ_POLYFILL_HAVE_FORK    true
+#define FUZZ_POLYFILL_HAVE_THREADS true
+
+// Linux 5.3+ can wait for a specific child process to exit with poll(2)
+// on a pidfd. Elsewhere, and if pidfd_open fails at runtime, child exits
+// are polled for with waitpid(2).
+#if defined(__linux__)
+#include <sys/syscall.h>
+#endif
+#if defined(SYS_pidfd_open)
+#define FUZZ_POLYFILL_HAVE_PIDFD true
+#else
+#define FUZZ_POLYFILL_HAVE_PIDFD false
+#endif
+
+// Threads share the dedup filter without locking it, which needs the
+// GCC/Clang atomic builtins. Without them, trials run on one thread.
+#if defined(__GNUC__) || defined(__clang__)
+#define FUZZ_POLYFILL_HAVE_ATOMICS true
+#else
+#define FUZZ_POLYFILL_HAVE_ATOMICS false
+#undef FUZZ_POLYFILL_HAVE_THREADS
+#define FUZZ_POLYFILL_HAVE_THREADS false
+#endif
+
 #if defined(_WIN32)
 #undef FUZZ_POLYFILL_HAVE_FORK
 #define FUZZ_POLYFILL_HAVE_FORK false
+#undef FUZZ_POLYFILL_HAVE_THREADS
+#define FUZZ_POLYFILL_HAVE_THREADS false
 #include "poll_windows.h"
 
 // Windows's read() function returns int.
@@ -2869,27 +4092,59 @@ struct timezone {
 
 typedef int pid_t;
 
+// Not actually used. Here to silence "incomplete type" warnings.
+typedef struct {
+	void* si_addr;
+} siginfo_t;
+
 // Not actually used. Here to silence "incomplete type" warnings.
 struct sigaction {
 	void (*sa_handler)(int);
-	void (*sa_sigaction)(int, void*, void*);
+	void (*sa_sigaction)(int, siginfo_t*, void*);
 	int sa_mask;
 	int sa_flags;
 	void (*sa_restorer)(void);
 };
 
+typedef int rlim_t;
+
 // Not actually used. Here to silence "incomplete type" warnings.
 struct rlimit {
-	int rlim_cur;
-	int rlim_max;
+	rlim_t rlim_cur;
+	rlim_t rlim_max;
+};
+
+// Not actually used. Here to silence "incomplete type" warnings.
+struct rusage {
+	struct timeval ru_utime;
+	struct timeval ru_stime;
+	long           ru_maxrss;
 };
 
-#define RLIMIT_CPU     0
-#define SIGKILL        0
-#define SIGUSR1        0
-#define WIFEXITED(x)   ((void)(x), 0)
-#define WEXITSTATUS(x) ((void)(x), 0)
-#define WNOHANG        0
+
+#define RLIMIT_CPU      0
+#define RLIMIT_AS       0
+#define RLIM_INFINITY   0
+#define SIGXCPU         0
+#define RUSAGE_SELF     0
+#define CLOCK_MONOTONIC 1
+#define PROT_READ       0
+#define PROT_WRITE      0
+#define MAP_SHARED      0
+#define MAP_PRIVATE     0
+#define MAP_ANONYMOUS   0
+#define MAP_FAILED      ((void*)-1)
+#define SA_SIGINFO      0
+#define SA_RESETHAND    0
+#define SIGBUS          0
+#define SIGKILL         0
+#define SIGPIPE         0
+#define SIGUSR1         0
+#define WIFEXITED(x)    ((void)(x), 0)
+#define WEXITSTATUS(x)  ((void)(x), 0)
+#define WIFSIGNALED(x)  ((void)(x), 0)
+#define WTERMSIG(x)     ((void)(x), 0)
+#define WNOHANG         0
 
 // POSIX pipe(2)
 int pipe(int pipefd[2]);
@@ -2902,6 +4157,9 @@ int fork();
 
 int gettimeofday(struct timeval* tp, struct timezone* tzp);
 
+// POSIX clock_gettime(2). Only CLOCK_MONOTONIC is supported.
+int clock_gettime(int clk_id, struct timespec* tp);
+
 // When POLYFILL_HAVE_FORK is false, these do nothing and are never called.
 // They only exist to prevent linker errors.
 int wait(int* status);
@@ -2911,8 +4169,15 @@ int kill(int pid, int sig);
 int sigaction(int signum, const struct sigaction* act,
 		struct sigaction* oldact);
 
+int sigemptyset(int* set);
+
 int setrlimit(int resource, const struct rlimit* rlim);
 int getrlimit(int resource, struct rlimit* rlim);
+int getrusage(int who, struct rusage* usage);
+
+void* mmap(void* addr, size_t length, int prot, int flags, int fd,
+		long offset);
+int   munmap(void* addr, size_t length);
 #endif
 
 #endif // FUZZ_POLYFILL_H
@@ -2931,6 +4196,18 @@ fuzz_seed_of_time(void)
 	return (uint64_t)fuzz_hash_onepass((const uint8_t*)&tv, sizeof(tv));
 }
 
+// This is the TRIAL_ID'th output of SplitMix64 seeded with RUN_SEED, which
+// can be computed directly from the counter.
+uint64_t
+fuzz_trial_seed(uint64_t run_seed, size_t trial_id)
+{
+	uint64_t z = run_seed;
+	z += ((uint64_t)trial_id + 1) * 0x9e3779b97f4a7c15LLU;
+	z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9LLU;
+	z = (z ^ (z >> 27)) * 0x94d049bb133111ebLLU;
+	return z ^ (z >> 31);
+}
+
 void
 fuzz_generic_free_cb(void* instance, void* env)
 {
@@ -2965,6 +4242,21 @@ autoscale_tally(char* buf, size_t buf_size, size_t scale_factor, char* name,
 	return used;
 }
 
+// Character printed for a failure: F, or T, M or C for a timeout, running
+// out of memory, or a crash.
+static char
+fail_char(int res)
+{
+	if (res == FUZZ_RESULT_TIMEOUT) {
+		return 'T';
+	} else if (res == FUZZ_RESULT_OOM) {
+		return 'M';
+	} else if (FUZZ_RESULT_IS_CRASH(res)) {
+		return 'C';
+	}
+	return 'F';
+}
+
 void
 fuzz_print_trial_result(struct fuzz_print_trial_result_env* env,
 		const struct fuzz_post_trial_info*          info)
@@ -2998,13 +4290,19 @@ fuzz_print_trial_result(struct fuzz_print_trial_result_env* env,
 	size_t used = 0;
 	char   buf[64];
 
-	switch (info->result) {
+	// All crashes are printed the same way, regardless of the signal.
+	switch (FUZZ_RESULT_IS_CRASH(info->result) ? FUZZ_RESULT_CRASH(0)
+						   : info->result) {
 	case FUZZ_RESULT_OK:
 		used = autoscale_tally(buf, sizeof(buf), 100, "PASS",
 				&env->scale_pass, '.', &env->consec_pass);
 		break;
 	case FUZZ_RESULT_FAIL:
-		used             = snprintf(buf, sizeof(buf), "F");
+	case FUZZ_RESULT_TIMEOUT:
+	case FUZZ_RESULT_OOM:
+	case FUZZ_RESULT_CRASH(0):
+		used = snprintf(buf, sizeof(buf), "%c",
+				fail_char(info->result));
 		env->scale_pass  = 1;
 		env->consec_pass = 0;
 		env->column      = 0;
@@ -3101,9 +4399,41 @@ fuzz_print_post_run_info(FILE* f, const struct fuzz_post_run_info* info)
 	const struct fuzz_run_report* r = &info->report;
 	const char*                   prop_name =
                         info->prop_name ? info->prop_name : def_prop_name;
-	fprintf(f, "\n== %s '%s': pass %zd, fail %zd, skip %zd, dup %zd\n",
+	fprintf(f, "\n== %s '%s': pass %zd, fail %zd, skip %zd, dup %zd",
 			r->fail > 0 ? "FAIL" : "PASS", prop_name, r->pass,
 			r->fail, r->skip, r->dup);
+	if (r->timeout > 0 || r->oom > 0 || r->crash > 0) {
+		fprintf(f, " (timeout %zd, oom %zd, crash %zd)", r->timeout,
+				r->oom, r->crash);
+	}
+	fprintf(f, "\n");
+}
+
+void
+fuzz_print_dedup_stats(FILE* f, const struct fuzz_dedup_stats* stats)
+{
+	const struct fuzz_dedup_stats* s = stats;
+	if (!s->enabled) {
+		fprintf(f, "dedup: off\n");
+		return;
+	}
+	fprintf(f,
+			"dedup: %zd bytes%s, %zd lines, %zd of %zd slots used "
+			"(%u.%u%%), %zd lines full\n",
+			s->bytes, (s->shared ? " shared" : ""), s->lines,
+			s->used, s->slots, s->fill_ppm / 10000,
+			(s->fill_ppm / 1000) % 10, s->full_lines);
+	fprintf(f,
+			"dedup: displaced 0/1/2/3 lines: %zd/%zd/%zd/%zd, "
+			"grew %zd times, forgot %zd\n",
+			s->displaced[0], s->displaced[1], s->displaced[2],
+			s->displaced[3], s->grows, s->forgotten);
+	fprintf(f,
+			"dedup: %zd hits of %zd checks (%u.%02u%%), "
+			"%u-bit fingerprints, est. FP rate 1 in %" PRIu64 "\n",
+			s->hits, s->checks, s->hit_ppm / 10000,
+			(s->hit_ppm / 100) % 100, s->fingerprint_bits,
+			s->fp_one_in);
 }
 
 int
@@ -3114,39 +4444,384 @@ fuzz_post_run_hook_print_info(const struct fuzz_post_run_info* info, void* env)
 	return FUZZ_HOOK_RUN_CONTINUE;
 }
 
-void*
-fuzz_hook_get_env(struct fuzz* t)
+bool
+fuzz_parse_shard(const char* str, size_t* index, size_t* count)
 {
-	return t->hooks.env;
+	char*                    end = NULL;
+	const unsigned long long k   = strtoull(str, &end, 10);
+	if (end == str || *end != '/' || str[0] == '-') {
+		return false;
+	}
+
+	const char*              n_str = end + 1;
+	const unsigned long long n     = strtoull(n_str, &end, 10);
+	if (end == n_str || *end != '\0' || n_str[0] == '-' || k >= n ||
+			n > SIZE_MAX) {
+		return false;
+	}
+
+	*index = (size_t)k;
+	*count = (size_t)n;
+	return true;
 }
 
-struct fuzz_aux_print_trial_result_env {
-	FILE*         f;          // 0 -> default of stdout
-	const uint8_t max_column; // 0 -> default of DEF_MAX_COLUMNS
+// Version 2 didn't list the shard indices, and version 1 also had no
+// timeout, oom, or crash counts, or failure results.
+#define REPORT_HEADER    "fuzz-report 3"
+#define REPORT_HEADER_V2 "fuzz-report 2"
+#define REPORT_HEADER_V1 "fuzz-report 1"
 
-	uint8_t column;
-	size_t  consec_pass;
-	size_t  consec_fail;
-};
+static bool read_shard_indices(FILE* f, struct fuzz_report* report);
+static bool guess_shard_indices(struct fuzz_report* report);
 
-const char*
-fuzz_result_str(int res)
+bool
+fuzz_report_write(FILE* f, const struct fuzz_report* report)
 {
-	switch (res) {
-	case FUZZ_RESULT_OK:
-		return "PASS";
-	case FUZZ_RESULT_FAIL:
-		return "FAIL";
-	case FUZZ_RESULT_SKIP:
-		return "SKIP";
+	const struct fuzz_run_report* r = &report->report;
+	if (report->shards > 0 && report->shard_indices == NULL) {
+		return false;
+	}
+	fprintf(f, "%s\n", REPORT_HEADER);
+	fprintf(f, "run_seed 0x%016" PRIx64 "\n", report->run_seed);
+	fprintf(f, "shards %zu/%zu\n", report->shards, report->shard_count);
+	fprintf(f, "shard_indices");
+	for (size_t i = 0; i < report->shards; i++) {
+		fprintf(f, " %zu", report->shard_indices[i]);
+	}
+	fprintf(f, "\n");
+	fprintf(f, "pass %zu\nfail %zu\nskip %zu\ndup %zu\n", r->pass,
+			r->fail, r->skip, r->dup);
+	fprintf(f, "timeout %zu\noom %zu\ncrash %zu\n", r->timeout, r->oom,
+			r->crash);
+	for (size_t i = 0; i < report->failure_count; i++) {
+		const struct fuzz_failure* failure = &report->failures[i];
+		fprintf(f, "failure %zu 0x%016" PRIx64 " %d\n",
+				failure->trial_id, failure->trial_seed,
+				failure->result);
+	}
+	return fflush(f) == 0 && !ferror(f);
+}
+
+bool
+fuzz_report_read(FILE* f, struct fuzz_report* report)
+{
+	struct fuzz_report     res = {0};
+	struct fuzz_run_report* r  = &res.report;
+	char                   header[sizeof(REPORT_HEADER "\n") + 1];
+	if (fgets(header, sizeof(header), f) == NULL) {
+		return false;
+	}
+	const bool v1 = (strcmp(header, REPORT_HEADER_V1 "\n") == 0);
+	const bool v2 = (strcmp(header, REPORT_HEADER_V2 "\n") == 0);
+	if (!v1 && !v2 && strcmp(header, REPORT_HEADER "\n") != 0) {
+		return false;
+	}
+
+	// Shard indices are size_t, so there can't be more shards than
+	// would fit in an array of them.
+	if (fscanf(f, " run_seed %" SCNx64, &res.run_seed) != 1 ||
+			fscanf(f, " shards %zu/%zu", &res.shards,
+					&res.shard_count) != 2 ||
+			res.shards > res.shard_count ||
+			res.shard_count > SIZE_MAX / sizeof(size_t) - 1) {
+		return false;
+	}
+	const bool indices = (v1 || v2 ? guess_shard_indices(&res)
+				       : read_shard_indices(f, &res));
+	if (!indices ||
+			fscanf(f, " pass %zu fail %zu skip %zu dup %zu",
+					&r->pass, &r->fail, &r->skip,
+					&r->dup) != 4 ||
+			(!v1 && fscanf(f, " timeout %zu oom %zu crash %zu",
+						&r->timeout, &r->oom,
+						&r->crash) != 3)) {
+		fuzz_report_free(&res);
+		return false;
+	}
+
+	size_t ceil = 0;
+	for (;;) {
+		struct fuzz_failure failure = {.result = FUZZ_RESULT_FAIL};
+		int scanned = fscanf(f, " failure %zu %" SCNx64,
+				&failure.trial_id, &failure.trial_seed);
+		if (scanned == EOF) {
+			break;
+		} else if (scanned != 2 ||
+				(!v1 && fscanf(f, "%d", &failure.result) != 1)) {
+			fuzz_report_free(&res);
+			return false;
+		}
+
+		if (res.failure_count == ceil) {
+			ceil = (ceil == 0 ? 8 : 2 * ceil);
+			struct fuzz_failure* nfailures = realloc(
+					res.failures, ceil * sizeof(*nfailures));
+			if (nfailures == NULL) {
+				fuzz_report_free(&res);
+				return false;
+			}
+			res.failures = nfailures;
+		}
+		res.failures[res.failure_count++] = failure;
+	}
+
+	*report = res;
+	return true;
+}
+
+// Read the "shard_indices" line into REPORT, checking that they're in
+// increasing order. The array grows as indices are read, rather than
+// trusting the count in the header.
+static bool
+read_shard_indices(FILE* f, struct fuzz_report* report)
+{
+	int matched = 0;
+	if (fscanf(f, " shard_indices%n", &matched) == EOF || matched == 0) {
+		return false;
+	}
+	size_t ceil = 0;
+	size_t prev = 0;
+	for (size_t i = 0; i < report->shards; i++) {
+		size_t index;
+		if (fscanf(f, "%zu", &index) != 1 ||
+				index >= report->shard_count ||
+				(i > 0 && index <= prev)) {
+			return false;
+		}
+		prev = index;
+
+		if (i == ceil) {
+			ceil = (ceil == 0 ? 8 : 2 * ceil);
+			size_t* nindices = realloc(report->shard_indices,
+					ceil * sizeof(*nindices));
+			if (nindices == NULL) {
+				return false;
+			}
+			report->shard_indices = nindices;
+		}
+		report->shard_indices[i] = index;
+	}
+	return true;
+}
+
+// Older reports don't list their shards, but they're known if the report
+// has all of them. Otherwise, shard_indices is left NULL.
+static bool
+guess_shard_indices(struct fuzz_report* report)
+{
+	if (report->shards == 0 || report->shards < report->shard_count) {
+		return true;
+	}
+	const size_t size     = report->shards * sizeof(size_t);
+	report->shard_indices = malloc(size);
+	if (report->shard_indices == NULL) {
+		return false;
+	}
+	for (size_t i = 0; i < report->shards; i++) {
+		report->shard_indices[i] = i;
+	}
+	return true;
+}
+
+bool
+fuzz_report_merge(struct fuzz_report* dst, const struct fuzz_report* src)
+{
+	if (dst->run_seed != src->run_seed ||
+			dst->shard_count != src->shard_count ||
+			(dst->shards > 0 && dst->shard_indices == NULL) ||
+			(src->shards > 0 && src->shard_indices == NULL)) {
+		return false;
+	}
+
+	// Both lists of shards are in increasing order, so merge them,
+	// checking that no shard is in both.
+	const size_t shards = dst->shards + src->shards;
+	if (shards > dst->shard_count) {
+		return false;
+	}
+	size_t* indices = NULL;
+	if (shards > 0) {
+		indices = malloc(shards * sizeof(*indices));
+		if (indices == NULL) {
+			return false;
+		}
+	}
+	const size_t* a = dst->shard_indices;
+	const size_t* b = src->shard_indices;
+	for (size_t i = 0, j = 0, k = 0; k < shards; k++) {
+		if (i < dst->shards && j < src->shards && a[i] == b[j]) {
+			free(indices);
+			return false;
+		} else if (j == src->shards ||
+				(i < dst->shards && a[i] < b[j])) {
+			indices[k] = a[i++];
+		} else {
+			indices[k] = b[j++];
+		}
+	}
+
+	// Both lists are ordered by trial_id, so merge them.
+	const size_t         count = dst->failure_count + src->failure_count;
+	struct fuzz_failure* failures = NULL;
+	if (count > 0) {
+		failures = malloc(count * sizeof(*failures));
+		if (failures == NULL) {
+			free(indices);
+			return false;
+		}
+	}
+
+	size_t i = 0;
+	size_t j = 0;
+	for (size_t k = 0; k < count; k++) {
+		if (j == src->failure_count ||
+				(i < dst->failure_count &&
+						dst->failures[i].trial_id <=
+								src->failures[j].trial_id)) {
+			failures[k] = dst->failures[i++];
+		} else {
+			failures[k] = src->failures[j++];
+		}
+	}
+
+	free(dst->failures);
+	free(dst->shard_indices);
+	dst->failures      = failures;
+	dst->failure_count = count;
+	dst->shard_indices = indices;
+	dst->shards        = shards;
+	dst->report.pass += src->report.pass;
+	dst->report.fail += src->report.fail;
+	dst->report.skip += src->report.skip;
+	dst->report.dup += src->report.dup;
+	dst->report.timeout += src->report.timeout;
+	dst->report.oom += src->report.oom;
+	dst->report.crash += src->report.crash;
+	return true;
+}
+
+void
+fuzz_report_free(struct fuzz_report* report)
+{
+	free(report->failures);
+	free(report->shard_indices);
+	report->failures      = NULL;
+	report->failure_count = 0;
+	report->shard_indices = NULL;
+}
+
+#define WEIGHTS_HEADER "fuzz-autoshrink-weights 1"
+
+static const char* tactic_names[FUZZ_AUTOSHRINK_TACTIC_COUNT] = {
+		[FUZZ_AUTOSHRINK_TACTIC_DROP]  = "drop",
+		[FUZZ_AUTOSHRINK_TACTIC_SHIFT] = "shift",
+		[FUZZ_AUTOSHRINK_TACTIC_MASK]  = "mask",
+		[FUZZ_AUTOSHRINK_TACTIC_SWAP]  = "swap",
+		[FUZZ_AUTOSHRINK_TACTIC_SUB]   = "sub",
+		[FUZZ_AUTOSHRINK_TACTIC_DDMIN] = "ddmin",
+};
+
+bool
+fuzz_autoshrink_weights_write(
+		FILE* f, const struct fuzz_autoshrink_weights* weights)
+{
+	fprintf(f, "%s\n", WEIGHTS_HEADER);
+	for (size_t arg = 0; arg < FUZZ_MAX_ARITY; arg++) {
+		for (size_t i = 0; i < FUZZ_AUTOSHRINK_TACTIC_COUNT; i++) {
+			if (weights->tries[arg][i] == 0) {
+				continue;
+			}
+			fprintf(f, "arg %zu %s %" PRIu32 " %" PRIu32 "\n", arg,
+					tactic_names[i],
+					weights->tries[arg][i],
+					weights->rewards[arg][i]);
+		}
+	}
+	return fflush(f) == 0 && !ferror(f);
+}
+
+bool
+fuzz_autoshrink_weights_read(FILE* f, struct fuzz_autoshrink_weights* weights)
+{
+	// The header must be the whole first line: with room for one more
+	// character, a longer line won't match.
+	struct fuzz_autoshrink_weights res = {0};
+	char                           header[sizeof(WEIGHTS_HEADER "\n") + 1];
+	if (fgets(header, sizeof(header), f) == NULL ||
+			strcmp(header, WEIGHTS_HEADER "\n") != 0) {
+		return false;
+	}
+
+	for (;;) {
+		size_t   arg = 0;
+		char     name[8];
+		uint32_t tries   = 0;
+		uint32_t rewards = 0;
+		int scanned = fscanf(f, " arg %zu %7s %" SCNu32 " %" SCNu32,
+				&arg, name, &tries, &rewards);
+		if (scanned == EOF) {
+			break;
+		}
+		const uint64_t max_rewards =
+				FUZZ_AUTOSHRINK_MAX_REWARD * (uint64_t)tries;
+		if (scanned != 4 || arg >= FUZZ_MAX_ARITY ||
+				rewards > max_rewards) {
+			return false;
+		}
+
+		size_t i = 0;
+		while (i < FUZZ_AUTOSHRINK_TACTIC_COUNT &&
+				strcmp(name, tactic_names[i]) != 0) {
+			i++;
+		}
+		if (i == FUZZ_AUTOSHRINK_TACTIC_COUNT) {
+			return false;
+		}
+		res.tries[arg][i]   = tries;
+		res.rewards[arg][i] = rewards;
+	}
+
+	*weights = res;
+	return true;
+}
+
+void*
+fuzz_hook_get_env(struct fuzz* t)
+{
+	return t->hooks.env;
+}
+
+struct fuzz_aux_print_trial_result_env {
+	FILE*         f;          // 0 -> default of stdout
+	const uint8_t max_column; // 0 -> default of DEF_MAX_COLUMNS
+
+	uint8_t column;
+	size_t  consec_pass;
+	size_t  consec_fail;
+};
+
+const char*
+fuzz_result_str(int res)
+{
+	switch (res) {
+	case FUZZ_RESULT_OK:
+		return "PASS";
+	case FUZZ_RESULT_FAIL:
+		return "FAIL";
+	case FUZZ_RESULT_SKIP:
+		return "SKIP";
 	case FUZZ_RESULT_DUPLICATE:
 		return "DUP";
+	case FUZZ_RESULT_TIMEOUT:
+		return "TIMEOUT";
+	case FUZZ_RESULT_OOM:
+		return "OOM";
 	case FUZZ_RESULT_ERROR:
 		return "ERROR";
 	case FUZZ_RESULT_ERROR_MEMORY:
 		return "ALLOCATION ERROR";
 	default:
-		return "(matchfail)";
+		return FUZZ_RESULT_IS_CRASH(res) ? "CRASH" : "(matchfail)";
 	}
 }
 // SPDX-License-Identifier: ISC
@@ -3156,6 +4831,10 @@ fuzz_result_str(int res)
 #include <stdlib.h>
 #include <string.h>
 
+#if !defined(_WIN32)
+#include <sys/mman.h>
+#endif
+
 // SPDX-License-Identifier: ISC
 // SPDX-FileCopyrightText: 2014-19 Scott Vokes <vokes.s@gmail.com>
 #ifndef FUZZ_BLOOM_H
@@ -3169,8 +4848,13 @@ fuzz_result_str(int res)
 struct fuzz_bloom;
 
 struct fuzz_bloom_config {
-	uint8_t top_block_bits;
-	uint8_t min_filter_bits;
+	uint8_t min_line_bits; // log2 of the smallest number of lines
+	size_t  expected;      // how many entries to size the filter for
+	size_t  max_bytes;     // most memory the table can use, or 0
+	// Let several threads check and mark the filter at once without
+	// locking. A shared filter never grows, so it's sized with extra
+	// room up front.
+	bool shared;
 };
 
 // Initialize a bloom filter.
@@ -3182,185 +4866,243 @@ bool fuzz_bloom_mark(struct fuzz_bloom* b, uint8_t* data, size_t data_size);
 // Check whether the data's hash is in the bloom filter.
 bool fuzz_bloom_check(struct fuzz_bloom* b, uint8_t* data, size_t data_size);
 
+// Check whether the data's hash is in the bloom filter, and mark it if
+// not, only hashing it once.
+bool fuzz_bloom_check_and_mark(
+		struct fuzz_bloom* b, uint8_t* data, size_t data_size);
+
+// Take the data's hash back out of the bloom filter, if it's there. Other
+// entries may go with it, and will then just be run again. This can't be
+// used while other threads are using the filter.
+void fuzz_bloom_forget(struct fuzz_bloom* b, uint8_t* data, size_t data_size);
+
 // Free the bloom filter.
 void fuzz_bloom_free(struct fuzz_bloom* b);
 
+// Get stats about how the bloom filter was sized and used.
+void fuzz_bloom_stats(const struct fuzz_bloom* b, struct fuzz_dedup_stats* s);
+
+// Load a bloom filter saved to PATH by fuzz_bloom_save, if it was saved
+// with the same KEY, or initialize an empty one if not. CONFIG is used as
+// by fuzz_bloom_init. Returns NULL on allocation failure.
+struct fuzz_bloom* fuzz_bloom_load(const struct fuzz_bloom_config* config,
+		const char* path, const uint64_t key[2]);
+
+// Save the bloom filter to PATH, along with KEY. Returns false on error.
+bool fuzz_bloom_save(const struct fuzz_bloom* b, const char* path,
+		const uint64_t key[2]);
+
 #endif
 
-// This is a dynamic blocked bloom filter, loosely based on
-// _Cache Efficient Bloom Filters for Shared Memory Machines_
-// by Tim Kaler.
+// This is a cache-line-blocked filter of hash fingerprints. It's used like
+// a bloom filter -- it can have false positives, but no false negatives --
+// but unlike a bloom filter, it can be rehashed into a larger table as it
+// fills up, rather than chaining on more filters that all need checking.
 //
-// The top level of the bloom filter uses the first N bits of the hash
-// (top_block2) to choose between (1 << N) distinct bloom filter blocks.
-// These blocks are created as necessary, i.e., a NULL block means no
-// bits in that block would have been set.
+// The table has (1 << size2) lines, each a 64-byte cache line of
+// LINE_SLOTS 32-bit slots. Data is hashed into two words: the top size2
+// bits of the first choose the entry's home line, and the
+// FINGERPRINT_BITS after them are its fingerprint. A slot holds the
+// fingerprint, how many lines past its home line it is (at most
+// MAX_DISPLACEMENT), and a set low bit, so 0 is a free slot. Checking a
+// line compares all its slots at once, which compilers turn into a few
+// SIMD instructions. An entry is only put past its home line when the
+// lines before it are full, and slots are never freed, so checking can
+// stop at the first line with a free slot.
 //
-// When checking for matches, HASH_COUNT different chunks of M bits from
-// the hash are used to check each block's bloom filter. (M is
-// block->size2, and the bloom filter has (1 << M) bits.) If any of
-// the selected bits are false, there was no match. Every bloom filter
-// in the block's linked list is checked, so all must match for
-// `fuzz_bloom_check` to return true.
+// Once more than MAX_LOAD / 256 of the slots are used, or an entry's home
+// line and the MAX_DISPLACEMENT lines after it are full, the table is
+// rehashed into one with twice as many lines. Each entry's new home line
+// takes the top bit of its fingerprint as one more bit, and the rest of
+// the fingerprint shifts up. The bit that would shift in isn't known, so
+// from then on one more of the lowest fingerprint bits is ignored, and
+// false positives get twice as likely. The table is sized up front for
+// the expected number of entries, so that should seldom happen. If the
+// larger table would go over the memory limit, the table stops growing,
+// and entries go in the free slots left, if any.
 //
-// When marking, only the front (largest) bloom filter in the
-// appropriate block is updated. If marking did not change any
-// bits (all bits chosen by the hash were already set), then
-// the bloom filter is considered too full, and a new one is
-// inserted before it, as the new head of the block. The new
-// bloom filter's size2 is one larger, so more bits of the hash
-// are used, and the bloom filter doubles in size.
-
-// Default number of bits to use for choosing a specific
-// block (linked list of bloom filters)
-#define DEF_TOP_BLOCK_BITS 9
-
-// Default number of bits in each first-layer bloom filter
-#define DEF_MIN_FILTER_BITS 9
-
-// How many hashes to check for each block
-#define HASH_COUNT 4
+// A shared table is used by several threads at once, and never grows,
+// since other threads could be using it. (Worker processes never touch
+// it.) It's updated without locks: slots are read with atomic loads and
+// claimed with an atomic compare-and-swap from 0, and if another thread
+// claims a slot first, the lines are checked again. Since slots are only
+// ever filled in order, of all the threads marking the same entry at once,
+// exactly one claims a slot for it, and the rest then find it.
+//
+// A table can be saved to a file, after a header, and loaded by a later
+// run. The loaded table is the file mapped copy-on-write, if possible, so
+// only the parts that are used get read in. The file
+// is in the machine's byte order, and holds a key -- say, a hash of what
+// was marked in it -- that has to match to load it.
+
+// Default log2 of the smallest number of lines
+#define DEF_MIN_LINE_BITS 9
+
+#define LINE_SLOTS       16
+#define LINE_SIZE        (LINE_SLOTS * sizeof(uint32_t))
+#define MAX_DISPLACEMENT 3
+#define FINGERPRINT_BITS 29
+
+// Grow once more than MAX_LOAD / 256 of the slots are used.
+#define MAX_LOAD 208
+
+// Stop growing once the table would be this large, or this few
+// fingerprint bits would be left.
+#define MAX_LINE_BITS        32
+#define MIN_FINGERPRINT_BITS 12
+
+// A shared table has at least this many line bits, and room for this many
+// times the expected entries.
+#define SHARED_MIN_LINE_BITS 14
+#define SHARED_HEADROOM      4
+
+// "fuzzdd02", read as a little-endian word. Change this if what gets
+// marked in saved tables, or the header, changes.
+#define SAVE_MAGIC 0x323064647a7a7566
+
+struct save_header {
+	uint64_t magic;
+	uint64_t key[2];
+	uint64_t count;
+	uint64_t full_lines;
+	uint64_t displaced[MAX_DISPLACEMENT + 1];
+	uint8_t  size2;
+	uint8_t  lost_bits;
+	// Pad to two lines, so the lines after it stay aligned.
+	uint8_t pad[2 * LINE_SIZE - (5 + MAX_DISPLACEMENT) * sizeof(uint64_t) -
+		    2];
+};
 
 #define LOG_BLOOM 0
 
-struct bloom_filter {
-	struct bloom_filter* next;
-	uint8_t              size2; // log2 of bit count
-	uint8_t              bits[];
+struct filter_line {
+	uint32_t slots[LINE_SLOTS];
 };
 
 struct fuzz_bloom {
-	const uint8_t top_block2;
-	const uint8_t min_filter2;
-	// These start as NULL and are lazily allocated.
-	// Each block is a linked list of bloom filters, with successively
-	// larger filters appended at the front as the filters fill up.
-	struct bloom_filter* blocks[];
+	uint8_t             size2;     // log2 of line count
+	uint8_t             lost_bits; // low fingerprint bits lost to growth
+	bool                shared;    // updated atomically, never grows
+	bool                no_grow;   // growing failed, so don't try again
+	size_t              max_bytes; // memory limit for lines, or 0
+	size_t              count;     // how many slots are used
+	size_t              mapped;    // size of alloc, if from mmap
+	void*               alloc;     // lines, before aligning them
+	struct filter_line* lines;
+
+	// Counts for fuzz_bloom_stats, kept up to date as slots are filled,
+	// so it doesn't have to read the whole table.
+	size_t full_lines;
+	size_t displaced[MAX_DISPLACEMENT + 1];
+	size_t checks;
+	size_t hits;
+	size_t grows;
+	size_t forgotten;
 };
 
-static struct fuzz_bloom_config def_config = {.top_block_bits = 0};
+static uint8_t initial_size2(const struct fuzz_bloom_config* config);
+static bool alloc_lines(struct fuzz_bloom* b, uint8_t size2);
+static void free_lines(struct fuzz_bloom* b);
+static bool load_lines(struct fuzz_bloom* b, const struct save_header* h,
+		FILE* f, long size);
+static bool is_full(const struct fuzz_bloom* b, const uint32_t* slot);
+static bool claim_slot(struct fuzz_bloom* b, uint32_t* slot, uint32_t value);
+static void count_slot(
+		struct fuzz_bloom* b, const uint32_t* slot, uint32_t value);
+static void add_count(const struct fuzz_bloom* b, size_t* counter);
+static uint32_t ppm(uint64_t n, uint64_t d);
+static uint32_t get_key(
+		const struct fuzz_bloom* b, uint64_t hash, size_t* home);
+static bool find_key(const struct fuzz_bloom* b, size_t home, uint32_t key,
+		uint32_t** free_slot, uint32_t* free_value);
+static bool check_and_mark_hash(
+		struct fuzz_bloom* b, const uint64_t hash[2], bool mark);
+static void forget_hash(struct fuzz_bloom* b, const uint64_t hash[2]);
+static bool grow(struct fuzz_bloom* b);
+
+static struct fuzz_bloom_config def_config = {.min_line_bits = 0};
 
-// Initialize a dynamic blocked bloom filter.
+// Initialize a bloom filter.
 struct fuzz_bloom*
 fuzz_bloom_init(const struct fuzz_bloom_config* config)
 {
-#define DEF(X, DEFAULT) (X ? X : DEFAULT)
-	config = DEF(config, &def_config);
-	const uint8_t top_block2 =
-			DEF(config->top_block_bits, DEF_TOP_BLOCK_BITS);
-	const uint8_t min_filter2 =
-			DEF(config->min_filter_bits, DEF_MIN_FILTER_BITS);
-#undef DEF
-
-	const size_t top_block_count = (1LLU << top_block2);
-	const size_t alloc_size =
-			sizeof(struct fuzz_bloom) +
-			top_block_count * sizeof(struct bloom_filter*);
-
-	struct fuzz_bloom* res = malloc(alloc_size);
+	config                 = (config ? config : &def_config);
+	struct fuzz_bloom* res = calloc(1, sizeof(*res));
 	if (res == NULL) {
 		return NULL;
 	}
-	memset(&res->blocks, 0x00,
-			top_block_count * sizeof(struct bloom_filter*));
-
-	struct fuzz_bloom b = {
-			.top_block2  = top_block2,
-			.min_filter2 = min_filter2,
-	};
-	memcpy(res, &b, sizeof(b));
+	res->shared    = config->shared;
+	res->max_bytes = config->max_bytes;
+	if (!alloc_lines(res, initial_size2(config))) {
+		free(res);
+		return NULL;
+	}
 	return res;
 }
 
-static struct bloom_filter*
-alloc_filter(uint8_t bits)
+// Get log2 of how many lines to start with, to fit the expected entries
+// without growing.
+static uint8_t
+initial_size2(const struct fuzz_bloom_config* config)
+{
+	uint8_t size2 = (config->min_line_bits ? config->min_line_bits
+					       : DEF_MIN_LINE_BITS);
+	size_t  slots = (256 * config->expected) / MAX_LOAD;
+	if (config->shared) {
+		slots *= SHARED_HEADROOM;
+		size2 = (size2 < SHARED_MIN_LINE_BITS ? SHARED_MIN_LINE_BITS
+						      : size2);
+	}
+	while (size2 < MAX_LINE_BITS &&
+			((size_t)1 << size2) * LINE_SLOTS < slots) {
+		size2++;
+	}
+	while (size2 > 1 && config->max_bytes > 0 &&
+			(LINE_SIZE << size2) > config->max_bytes) {
+		size2--;
+	}
+	return size2;
+}
+
+// Allocate a zeroed table of (1 << SIZE2) lines for B, aligned to the
+// line size.
+static bool
+alloc_lines(struct fuzz_bloom* b, uint8_t size2)
+{
+	const size_t size = ((size_t)1 << size2) * LINE_SIZE;
+
+	uint8_t* alloc = calloc(1, size + LINE_SIZE - 1);
+	if (alloc == NULL) {
+		return false;
+	}
+	const size_t misalign = (uintptr_t)alloc % LINE_SIZE;
+	const size_t offset   = (misalign == 0 ? 0 : LINE_SIZE - misalign);
+	b->alloc              = alloc;
+	b->lines              = (struct filter_line*)(alloc + offset);
+	b->size2              = size2;
+	b->mapped             = 0;
+	LOG(3 - LOG_BLOOM, "%s: %p [size2 %u (%zd bytes)]\n", __func__,
+			(void*)b->lines, size2, size);
+	return true;
+}
+
+static void
+free_lines(struct fuzz_bloom* b)
 {
-	const size_t alloc_size =
-			sizeof(struct bloom_filter) + ((1LLU << bits) / 8);
-	struct bloom_filter* bf = malloc(alloc_size);
-	if (bf != NULL) {
-		memset(bf, 0x00, alloc_size);
-		bf->size2 = bits;
-		LOG(4 - LOG_BLOOM, "%s: %p [size2 %u (%zd bytes)]\n", __func__,
-				(void*)bf, bf->size2,
-				(size_t)((1LLU << bf->size2) / 8));
+	if (b->mapped > 0) {
+		munmap(b->alloc, b->mapped);
+	} else {
+		free(b->alloc);
 	}
-	return bf;
 }
 
 // Hash data and mark it in the bloom filter.
 bool
 fuzz_bloom_mark(struct fuzz_bloom* b, uint8_t* data, size_t data_size)
 {
-	uint64_t     hash            = fuzz_hash_onepass(data, data_size);
-	const size_t top_block_count = (1LLU << b->top_block2);
-	LOG(3 - LOG_BLOOM, "%s: overall hash: 0x%016" PRIx64 "\n", __func__,
-			hash);
-
-	const uint64_t top_block_mask = top_block_count - 1;
-	const size_t   block_id       = hash & top_block_mask;
-	LOG(3 - LOG_BLOOM, "%s: block_id %zd\n", __func__, block_id);
-
-	struct bloom_filter* bf = b->blocks[block_id];
-	if (bf == NULL) { // lazily allocate
-		bf = alloc_filter(b->min_filter2);
-		if (bf == NULL) {
-			return false; // alloc fail
-		}
-		b->blocks[block_id] = bf;
-	}
-
-	// Must be able to do all checks with one 64 bit hash.
-	// In order to relax this restriction, fuzz's hashing
-	// code will need to be restructured to give the bloom
-	// filter code two independent hashes.
-	assert(64 - b->top_block2 - (HASH_COUNT * bf->size2) > 0);
-	hash >>= b->top_block2;
-
-	const uint8_t  block_size2 = bf->size2;
-	const uint64_t block_mask  = (1LLU << block_size2) - 1;
-	bool           any_set     = false;
-
-	// Only mark in the front filter.
-	for (size_t i = 0; i < HASH_COUNT; i++) {
-		const uint64_t v = (hash >> (i * block_size2)) & block_mask;
-		const uint64_t offset = v / 8;
-		const uint8_t  bit    = 1 << (v & 0x07);
-		LOG(4 - LOG_BLOOM,
-				"%s: marking %p @ %" PRIu64
-				" =>  offset %" PRIu64 ", bit 0x%02x\n",
-				__func__, (void*)bf, v, offset, bit);
-		if (0 == (bf->bits[offset] & bit)) {
-			any_set = true;
-		}
-		bf->bits[offset] |= bit;
-	}
-
-	// If all bits were already set, prepend a new, empty filter -- the
-	// previous filter will still match when checking, but there will be
-	// a reduced chance of false positives for new entries.
-	if (!any_set) {
-		if (b->top_block2 + HASH_COUNT * (bf->size2 + 1) > 64) {
-			// We can't grow this hash chain any further with the
-			// hash bits available.
-			LOG(0,
-					"%s: Warning: bloom filter block %zd "
-					"cannot grow further!\n",
-					__func__, block_id);
-		} else {
-			struct bloom_filter* nbf = alloc_filter(bf->size2 + 1);
-			LOG(3 - LOG_BLOOM,
-					"%s: growing bloom filter -- bits %u, "
-					"nbf %p\n",
-					__func__, bf->size2 + 1, (void*)nbf);
-			if (nbf == NULL) {
-				return false; // alloc fail
-			}
-			nbf->next           = bf;
-			b->blocks[block_id] = nbf; // append to front
-		}
-	}
-
+	uint64_t hash[2];
+	fuzz_hash128_onepass(data, data_size, hash);
+	check_and_mark_hash(b, hash, true);
 	return true;
 }
 
@@ -3368,124 +5110,634 @@ fuzz_bloom_mark(struct fuzz_bloom* b, uint8_t* data, size_t data_size)
 bool
 fuzz_bloom_check(struct fuzz_bloom* b, uint8_t* data, size_t data_size)
 {
-	uint64_t hash = fuzz_hash_onepass(data, data_size);
-	LOG(3 - LOG_BLOOM, "%s: overall hash: 0x%016" PRIx64 "\n", __func__,
-			hash);
-	const size_t   top_block_count = (1LLU << b->top_block2);
-	const uint64_t top_block_mask  = top_block_count - 1;
-	const size_t   block_id        = hash & top_block_mask;
-	LOG(3 - LOG_BLOOM, "%s: block_id %zd\n", __func__, block_id);
-
-	struct bloom_filter* bf = b->blocks[block_id];
-	if (bf == NULL) {
-		return false; // block not allocated: no bits set
-	}
-
-	hash >>= b->top_block2;
-
-	// Check every block
-	while (bf != NULL) {
-		const uint8_t  block_size2 = bf->size2;
-		const uint64_t block_mask  = (1LLU << block_size2) - 1;
-
-		bool hit_all_in_block = true;
-		for (size_t i = 0; i < HASH_COUNT; i++) {
-			const uint64_t v = (hash >> (i * block_size2)) &
-					   block_mask;
-			const uint64_t offset = v / 8;
-			const uint8_t  bit    = 1 << (v & 0x07);
-			LOG(4 - LOG_BLOOM,
-					"%s: checking %p (bits %u) @ %" PRIu64
-					" => offset %" PRIu64
-					", bit 0x%02x: 0x%02x\n",
-					__func__, (void*)bf, block_size2, v,
-					offset, bit, (bf->bits[offset] & bit));
-			if (0 == (bf->bits[offset] & bit)) {
-				hit_all_in_block = false;
-				break;
-			}
-		}
-		if (hit_all_in_block) {
+	uint64_t hash[2];
+	fuzz_hash128_onepass(data, data_size, hash);
+	return check_and_mark_hash(b, hash, false);
+}
+
+// Check whether the data's hash is in the bloom filter, and mark it if
+// not, only hashing it once.
+bool
+fuzz_bloom_check_and_mark(
+		struct fuzz_bloom* b, uint8_t* data, size_t data_size)
+{
+	uint64_t hash[2];
+	fuzz_hash128_onepass(data, data_size, hash);
+	return check_and_mark_hash(b, hash, true);
+}
+
+static bool
+check_and_mark_hash(struct fuzz_bloom* b, const uint64_t hash[2], bool mark)
+{
+	size_t    home;
+	uint32_t  key = get_key(b, hash[0], &home);
+	uint32_t* slot;
+	uint32_t  value;
+	LOG(3 - LOG_BLOOM,
+			"%s: hash 0x%016" PRIx64 ", home %zd, key 0x%08" PRIx32
+			"\n",
+			__func__, hash[0], home, key);
+	add_count(b, &b->checks);
+	for (;;) {
+		if (find_key(b, home, key, &slot, &value)) {
+			add_count(b, &b->hits);
 			return true;
+		} else if (!mark) {
+			return false;
+		}
+
+		if (!b->shared && !b->no_grow && is_full(b, slot) &&
+				grow(b)) {
+			key = get_key(b, hash[0], &home);
+			continue;
 		}
-		bf = bf->next;
-	}
 
-	return false; // there wasn't any block with all checked bits set
+		// If it still doesn't fit, it's forgotten. That only means
+		// it may be run again.
+		if (slot == NULL) {
+			add_count(b, &b->forgotten);
+			return false;
+		} else if (claim_slot(b, slot, value)) {
+			return false;
+		}
+		// Another thread claimed the slot first, maybe for this
+		// same entry, so check again.
+	}
 }
 
-// Free the bloom filter.
+// Take data's hash back out of the bloom filter, if it's there.
 void
-fuzz_bloom_free(struct fuzz_bloom* b)
+fuzz_bloom_forget(struct fuzz_bloom* b, uint8_t* data, size_t data_size)
 {
-	const size_t top_block_count = (1LLU << b->top_block2);
-	uint8_t      max_length      = 0;
-	for (size_t i = 0; i < top_block_count; i++) {
-		uint8_t              length = 0;
-		struct bloom_filter* bf     = b->blocks[i];
-		while (bf != NULL) {
-			struct bloom_filter* next = bf->next;
-			free(bf);
-			bf = next;
-			length++;
-		}
-		LOG(3 - LOG_BLOOM, "%s: block %zd, length %u\n", __func__, i,
-				length);
-		max_length = (length > max_length ? length : max_length);
-	}
-	LOG(3 - LOG_BLOOM, "%s: %zd blocks, max length %u\n", __func__,
-			top_block_count, max_length);
-	free(b);
+	uint64_t hash[2];
+	fuzz_hash128_onepass(data, data_size, hash);
+	forget_hash(b, hash);
 }
-// SPDX-License-Identifier: ISC
-// SPDX-FileCopyrightText: 2014-19 Scott Vokes <vokes.s@gmail.com>
-#include <assert.h>
-#include <errno.h>
-#include <inttypes.h>
-#include <limits.h>
-#include <signal.h>
-#include <stdbool.h>
-#include <stdlib.h>
-#include <time.h>
 
-#if defined(_WIN32)
-#include <io.h>
-#endif
+// Clear the first slot that matches HASH, and move the rest of its line's
+// slots down, so they're still filled in order. Entries that were pushed
+// to later lines by this one being full can't be found after that, which
+// only means they may be run again.
+static void
+forget_hash(struct fuzz_bloom* b, const uint64_t hash[2])
+{
+	size_t         home;
+	const uint32_t key       = get_key(b, hash[0], &home);
+	const uint32_t mask      = (UINT32_MAX << (3 + b->lost_bits)) | 0x07;
+	const size_t   line_mask = ((size_t)1 << b->size2) - 1;
+	for (uint32_t d = 0; d <= MAX_DISPLACEMENT; d++) {
+		uint32_t*      slots = b->lines[(home + d) & line_mask].slots;
+		const uint32_t want  = (key & mask) | (d << 1);
+		size_t         i     = 0;
+		for (; i < LINE_SLOTS && slots[i] != 0; i++) {
+			if ((slots[i] & mask) == want) {
+				const size_t rest = LINE_SLOTS - i - 1;
+				b->full_lines -= (slots[LINE_SLOTS - 1] != 0);
+				b->displaced[d]--;
+				b->count--;
+				memmove(&slots[i], &slots[i + 1],
+						rest * sizeof(*slots));
+				slots[LINE_SLOTS - 1] = 0;
+				return;
+			}
+		}
+		if (i < LINE_SLOTS) {
+			return; // it would have gone in this line
+		}
+	}
+}
 
-#if !defined(_WIN32)
-#include <sys/poll.h>
-#include <sys/time.h>
-#include <sys/types.h>
-#include <sys/wait.h>
-#include <unistd.h>
+// Check whether B should grow before putting an entry in SLOT.
+static bool
+is_full(const struct fuzz_bloom* b, const uint32_t* slot)
+{
+	const size_t slots = ((size_t)1 << b->size2) * LINE_SLOTS;
+	return slot == NULL || b->count >= (slots / 256) * MAX_LOAD;
+}
+
+// Set *SLOT to VALUE, unless B is shared and another thread has claimed
+// the slot first.
+static bool
+claim_slot(struct fuzz_bloom* b, uint32_t* slot, uint32_t value)
+{
+#if FUZZ_POLYFILL_HAVE_ATOMICS
+	if (b->shared) {
+		uint32_t expected = 0;
+		if (!__atomic_compare_exchange_n(slot, &expected, value,
+				    false, __ATOMIC_RELAXED,
+				    __ATOMIC_RELAXED)) {
+			return false;
+		}
+	} else
 #endif
+	{
+		*slot = value;
+	}
+	count_slot(b, slot, value);
+	return true;
+}
 
-// SPDX-License-Identifier: ISC
-// SPDX-FileCopyrightText: 2014-19 Scott Vokes <vokes.s@gmail.com>
-#ifndef FUZZ_CALL_H
-#define FUZZ_CALL_H
+// Count VALUE, just put in SLOT.
+static void
+count_slot(struct fuzz_bloom* b, const uint32_t* slot, uint32_t value)
+{
+	add_count(b, &b->count);
+	add_count(b, &b->displaced[(value >> 1) & 0x03]);
+	if ((size_t)(slot - b->lines[0].slots) % LINE_SLOTS ==
+			LINE_SLOTS - 1) {
+		add_count(b, &b->full_lines);
+	}
+}
 
-#include <stdbool.h>
+// Add one to COUNTER, one of B's counts, atomically if B is shared.
+static void
+add_count(const struct fuzz_bloom* b, size_t* counter)
+{
+#if FUZZ_POLYFILL_HAVE_ATOMICS
+	if (b->shared) {
+		__atomic_add_fetch(counter, 1, __ATOMIC_RELAXED);
+		return;
+	}
+#else
+	(void)b;
+#endif
+	(*counter)++;
+}
+
+// Get the slot value for HASH, not yet displaced, and its home line.
+static uint32_t
+get_key(const struct fuzz_bloom* b, uint64_t hash, size_t* home)
+{
+	*home = (size_t)(hash >> (64 - b->size2));
+	const uint32_t fingerprint = (uint32_t)((hash << b->size2) >>
+						(64 - FINGERPRINT_BITS));
+	return (fingerprint << 3) | 0x01;
+}
+
+// Check whether KEY is in the lines from its HOME line. If not, set
+// *FREE_SLOT to where it should go and *FREE_VALUE to what to put there,
+// or *FREE_SLOT to NULL if all the lines it can go in are full.
+static bool
+find_key(const struct fuzz_bloom* b, size_t home, uint32_t key,
+		uint32_t** free_slot, uint32_t* free_value)
+{
+	const uint32_t mask      = (UINT32_MAX << (3 + b->lost_bits)) | 0x07;
+	const size_t   line_mask = ((size_t)1 << b->size2) - 1;
+	*free_slot               = NULL;
+
+	for (uint32_t d = 0; d <= MAX_DISPLACEMENT; d++) {
+		struct filter_line* line = &b->lines[(home + d) & line_mask];
+		const uint32_t      want = (key & mask) | (d << 1);
+		uint32_t            hit  = 0;
+		uint32_t            used = 0;
+#if FUZZ_POLYFILL_HAVE_ATOMICS
+		if (b->shared) {
+			// Other threads may be claiming slots meanwhile.
+			for (size_t i = 0; i < LINE_SLOTS; i++) {
+				const uint32_t slot = __atomic_load_n(
+						&line->slots[i],
+						__ATOMIC_RELAXED);
+				hit |= ((slot & mask) == want);
+				used += (slot != 0);
+			}
+		} else
+#endif
+		{
+			for (size_t i = 0; i < LINE_SLOTS; i++) {
+				hit |= ((line->slots[i] & mask) == want);
+				used += (line->slots[i] != 0);
+			}
+		}
+		if (hit) {
+			return true;
+		} else if (used < LINE_SLOTS) {
+			// Slots are filled in order, so this is the first
+			// free one.
+			*free_slot  = &line->slots[used];
+			*free_value = want;
+			return false;
+		}
+	}
+	return false;
+}
+
+// Rehash B into a table with twice as many lines.
+static bool
+grow(struct fuzz_bloom* b)
+{
+	const uint8_t fp_bits = FINGERPRINT_BITS - b->lost_bits;
+	if (b->size2 >= MAX_LINE_BITS || fp_bits <= MIN_FINGERPRINT_BITS) {
+		LOG(0, "%s: Warning: bloom filter cannot grow further!\n",
+				__func__);
+		b->no_grow = true;
+		return false;
+	} else if (b->max_bytes > 0 &&
+			(LINE_SIZE << (b->size2 + 1)) > b->max_bytes) {
+		LOG(2 - LOG_BLOOM, "%s: at memory limit of %zd bytes\n",
+				__func__, b->max_bytes);
+		b->no_grow = true;
+		return false;
+	}
+
+	struct fuzz_bloom nb = {
+			.lost_bits = b->lost_bits + 1,
+			.shared    = b->shared,
+	};
+	if (!alloc_lines(&nb, b->size2 + 1)) {
+		b->no_grow = true;
+		return false; // alloc fail: keep using the full table
+	}
+
+	const size_t   line_count = (size_t)1 << b->size2;
+	const uint32_t fp_mask    = (1LU << FINGERPRINT_BITS) - 1;
+	for (size_t l = 0; l < line_count; l++) {
+		const uint32_t* slots = b->lines[l].slots;
+		for (size_t i = 0; i < LINE_SLOTS && slots[i] != 0; i++) {
+			// The top bit of the fingerprint moves into the line.
+			const uint32_t fp    = slots[i] >> 3;
+			const size_t   disp  = (slots[i] >> 1) & 0x03;
+			const size_t   home  = (l - disp) & (line_count - 1);
+			const size_t   top   = fp >> (FINGERPRINT_BITS - 1);
+			const size_t   nhome = (home << 1) | top;
+			const uint32_t nfp   = (fp << 1) & fp_mask;
+			const uint32_t nkey  = (nfp << 3) | 0x01;
+			uint32_t*      nslot;
+			uint32_t       nvalue;
+			// Entries that now look the same are merged, and any
+			// that don't fit are forgotten.
+			if (find_key(&nb, nhome, nkey, &nslot, &nvalue)) {
+				continue;
+			} else if (nslot != NULL) {
+				*nslot = nvalue;
+				count_slot(&nb, nslot, nvalue);
+			} else {
+				b->forgotten++;
+			}
+		}
+	}
+	LOG(2 - LOG_BLOOM, "%s: grew to %u line bits, kept %zd of %zd\n",
+			__func__, nb.size2, nb.count, b->count);
+
+	free_lines(b);
+	b->size2     = nb.size2;
+	b->lost_bits = nb.lost_bits;
+	b->count      = nb.count;
+	b->full_lines = nb.full_lines;
+	b->mapped     = nb.mapped;
+	b->alloc      = nb.alloc;
+	b->lines      = nb.lines;
+	memcpy(b->displaced, nb.displaced, sizeof(b->displaced));
+	b->grows++;
+	return true;
+}
+
+// Free the bloom filter.
+void
+fuzz_bloom_free(struct fuzz_bloom* b)
+{
+	LOG(3 - LOG_BLOOM, "%s: %zd entries in %zd lines, %u bits lost\n",
+			__func__, b->count, (size_t)1 << b->size2,
+			b->lost_bits);
+	free_lines(b);
+	free(b);
+}
+
+// Get stats about how the bloom filter was sized and used.
+void
+fuzz_bloom_stats(const struct fuzz_bloom* b, struct fuzz_dedup_stats* s)
+{
+	memset(s, 0x00, sizeof(*s));
+	s->enabled          = true;
+	s->shared           = b->shared;
+	s->lines            = (size_t)1 << b->size2;
+	s->bytes            = s->lines * LINE_SIZE;
+	s->slots            = s->lines * LINE_SLOTS;
+	s->grows            = b->grows;
+	s->forgotten        = b->forgotten;
+	s->fingerprint_bits = FINGERPRINT_BITS - b->lost_bits;
+	s->checks           = b->checks;
+	s->hits             = b->hits;
+	s->used             = b->count;
+	s->full_lines       = b->full_lines;
+	memcpy(s->displaced, b->displaced, sizeof(s->displaced));
+
+	s->fill_ppm = ppm(s->used, s->slots);
+	s->hit_ppm  = ppm(s->hits, s->checks);
+	// Arguments are compared with the entries from their home line,
+	// about used / lines of them, and each matches with odds of 1 in
+	// 2 ** fingerprint_bits.
+	if (s->used > 0) {
+		s->fp_one_in = ((uint64_t)s->lines << s->fingerprint_bits) /
+			       s->used;
+	}
+}
+
+// N / D, in millionths, or 0 if D is 0.
+static uint32_t
+ppm(uint64_t n, uint64_t d)
+{
+	if (d == 0) {
+		return 0;
+	} else if (n > UINT64_MAX / 1000000) {
+		return (uint32_t)(n / (d / 1000000 + 1));
+	}
+	return (uint32_t)(n * 1000000 / d);
+}
+
+// Load a bloom filter saved to PATH by fuzz_bloom_save, if it was saved
+// with the same KEY, or initialize an empty one if not.
+struct fuzz_bloom*
+fuzz_bloom_load(const struct fuzz_bloom_config* config, const char* path,
+		const uint64_t key[2])
+{
+	config  = (config ? config : &def_config);
+	FILE* f = fopen(path, "rb");
+	if (f == NULL) {
+		LOG(2 - LOG_BLOOM, "%s: nothing saved at '%s'\n", __func__,
+				path);
+		return fuzz_bloom_init(config);
+	}
+
+	struct save_header h;
+	long               size = -1;
+	if (fread(&h, sizeof(h), 1, f) == 1 && fseek(f, 0, SEEK_END) == 0) {
+		size = ftell(f);
+	}
+	const uint8_t max_lost = FINGERPRINT_BITS - MIN_FINGERPRINT_BITS;
+	const bool    valid    = size >= 0 && h.magic == SAVE_MAGIC &&
+			h.size2 > 0 && h.size2 <= MAX_LINE_BITS &&
+			h.size2 < 8 * sizeof(size_t) - 6 &&
+			h.lost_bits <= max_lost &&
+			(size_t)size == sizeof(h) + (LINE_SIZE << h.size2) &&
+			h.count <= ((uint64_t)LINE_SLOTS << h.size2);
+	if (!valid || h.key[0] != key[0] || h.key[1] != key[1]) {
+		LOG(1 - LOG_BLOOM, "%s: ignoring %s filter saved at '%s'\n",
+				__func__, (valid ? "another run's" : "bad"),
+				path);
+		fclose(f);
+		return fuzz_bloom_init(config);
+	} else if (config->max_bytes > 0 &&
+			(LINE_SIZE << h.size2) > config->max_bytes) {
+		LOG(1 - LOG_BLOOM, "%s: ignoring filter saved at '%s', "
+				   "over the limit of %zd bytes\n",
+				__func__, path, config->max_bytes);
+		fclose(f);
+		return fuzz_bloom_init(config);
+	}
+
+	struct fuzz_bloom* res = calloc(1, sizeof(*res));
+	if (res == NULL) {
+		fclose(f);
+		return NULL;
+	}
+	res->shared     = config->shared;
+	res->max_bytes  = config->max_bytes;
+	res->lost_bits  = h.lost_bits;
+	res->count      = h.count;
+	res->full_lines = h.full_lines;
+	for (size_t d = 0; d <= MAX_DISPLACEMENT; d++) {
+		res->displaced[d] = h.displaced[d];
+	}
+	if (!load_lines(res, &h, f, size)) {
+		fclose(f);
+		free(res);
+		return fuzz_bloom_init(config);
+	}
+	fclose(f);
+
+	// A shared table can't grow later, so it grows now if it's smaller
+	// than a new one would be.
+	const uint8_t size2 = initial_size2(config);
+	while (res->shared && res->size2 < size2 && grow(res)) {
+	}
+	LOG(2 - LOG_BLOOM, "%s: loaded %zd entries from '%s'\n", __func__,
+			res->count, path);
+	return res;
+}
+
+// Map or read the lines saved in F, which is SIZE bytes long, into B.
+static bool
+load_lines(struct fuzz_bloom* b, const struct save_header* h, FILE* f,
+		long size)
+{
+	void* p = mmap(NULL, (size_t)size, PROT_READ | PROT_WRITE,
+			MAP_PRIVATE, fileno(f), 0);
+	if (p != MAP_FAILED) {
+		b->alloc  = p;
+		b->lines  = (struct filter_line*)((uint8_t*)p + sizeof(*h));
+		b->size2  = h->size2;
+		b->mapped = (size_t)size;
+		return true;
+	}
+
+	if (!alloc_lines(b, h->size2)) {
+		return false;
+	}
+	const size_t lines_size = ((size_t)1 << h->size2) * LINE_SIZE;
+	if (fseek(f, sizeof(*h), SEEK_SET) != 0 ||
+			fread(b->lines, lines_size, 1, f) != 1) {
+		free_lines(b);
+		return false;
+	}
+	return true;
+}
+
+// Save the bloom filter to PATH, along with KEY.
+bool
+fuzz_bloom_save(const struct fuzz_bloom* b, const char* path,
+		const uint64_t key[2])
+{
+	// Write to another file and rename it over PATH, so a save that's
+	// interrupted doesn't leave a bad filter, and a table mapped from
+	// PATH isn't changed while it's being written out.
+	const size_t tmp_size = strlen(path) + sizeof(".tmp");
+	char*        tmp      = malloc(tmp_size);
+	if (tmp == NULL) {
+		return false;
+	}
+	snprintf(tmp, tmp_size, "%s.tmp", path);
+
+	FILE* f = fopen(tmp, "wb");
+	if (f == NULL) {
+		free(tmp);
+		return false;
+	}
+	struct save_header h = {
+			.magic      = SAVE_MAGIC,
+			.key        = {key[0], key[1]},
+			.count      = b->count,
+			.full_lines = b->full_lines,
+			.size2      = b->size2,
+			.lost_bits  = b->lost_bits,
+	};
+	for (size_t d = 0; d <= MAX_DISPLACEMENT; d++) {
+		h.displaced[d] = b->displaced[d];
+	}
+	const size_t lines_size = ((size_t)1 << b->size2) * LINE_SIZE;
+	bool         ok         = fwrite(&h, sizeof(h), 1, f) == 1 &&
+			 fwrite(b->lines, lines_size, 1, f) == 1;
+	ok = (fclose(f) == 0) && ok;
+	if (ok) {
+		ok = rename(tmp, path) == 0;
+	}
+	if (!ok) {
+		remove(tmp);
+	}
+	free(tmp);
+	LOG(2 - LOG_BLOOM, "%s: %s %zd entries to '%s'\n", __func__,
+			(ok ? "saved" : "failed to save"), b->count, path);
+	return ok;
+}
+// SPDX-License-Identifier: ISC
+// SPDX-FileCopyrightText: 2014-19 Scott Vokes <vokes.s@gmail.com>
+#include <assert.h>
+#include <errno.h>
+#include <inttypes.h>
+#include <limits.h>
+#include <signal.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#if defined(_WIN32)
+#include <io.h>
+#endif
+
+#if !defined(_WIN32)
+#include <sys/mman.h>
+#include <sys/poll.h>
+#include <sys/resource.h>
+#include <sys/time.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#endif
+
+// SPDX-License-Identifier: ISC
+// SPDX-FileCopyrightText: 2014-19 Scott Vokes <vokes.s@gmail.com>
+#ifndef FUZZ_CALL_H
+#define FUZZ_CALL_H
+
+#include <stdbool.h>
 
 struct fuzz;
 
+// Map the blocks the workers write their results to. Returns false on
+// error.
+bool fuzz_call_init_workers(struct fuzz* t);
+
 // Actually call the property function referenced in INFO, with the arguments
 // in ARGS.
 int fuzz_call(struct fuzz* t, void** args);
 
-// Check if this combination of argument instances has been called.
-bool fuzz_call_check_called(struct fuzz* t);
+// Start a call of the property function with the arguments in ARGS in a
+// forked WORKER, without waiting for it to finish. Use fuzz_call_poll to
+// collect its result.
+bool fuzz_call_start(struct fuzz* t, struct worker_info* worker, void** args);
+
+// Wait until at least one of the COUNT busy WORKERS has finished its call
+// (or timed out), and set its done and result fields. Returns false on
+// error.
+bool fuzz_call_poll(struct fuzz* t, struct worker_info* workers, size_t count);
+
+// Copy the measurements of WORKER's finished call to T's call_info.
+void fuzz_call_take_info(struct fuzz* t, const struct worker_info* worker);
+
+// Stop a worker's call without collecting its result.
+void fuzz_call_abandon(struct fuzz* t, struct worker_info* worker);
+
+// Shut down any persistent workers, wait for them to exit, and unmap the
+// workers' result blocks.
+void fuzz_call_stop_workers(struct fuzz* t);
+
+// Hash the arguments into HASHES, two words per argument. Arguments whose
+// type can't be hashed are left as 0.
+void fuzz_call_hash_args(struct fuzz* t, uint64_t* hashes);
 
-// Mark the tuple of argument instances as called in the bloom filter.
-void fuzz_call_mark_called(struct fuzz* t);
+// Check if the combination of argument instances with HASHES has been
+// called, and mark it as called in the bloom filter if not.
+bool fuzz_call_check_and_mark_called(struct fuzz* t, const uint64_t* hashes);
+
+// Note that the current arguments shouldn't stay marked as called in the
+// saved bloom filter, since the call failed or its result wasn't used.
+// Returns false on allocation failure.
+bool fuzz_call_forget_called(struct fuzz* t);
 
 #endif
 
-static int fuzz_call_inner(struct fuzz* t, void** args);
+static int fuzz_call_inner(
+		struct fuzz* t, void** args, struct fuzz_call_info* info);
+
+static int call_property(struct fuzz* t, void** args);
+
+static bool reply(struct worker_info* worker, int res);
+
+static void watch_crashes(struct fuzz_call_info* info);
+
+static void on_crash(int sig, siginfo_t* info, void* context);
+
+static int result_fd(const struct worker_info* worker);
+
+static bool start_worker(
+		struct fuzz* t, struct worker_info* worker, void** args);
+
+static pid_t fork_worker(struct fuzz* t);
+
+static void finish_call(struct fuzz* t, struct worker_info* worker);
+
+enum persistent_call_res {
+	PERSISTENT_CALL_OK,
+	PERSISTENT_CALL_UNSUPPORTED, // can't be sent, fork for this call
+	PERSISTENT_CALL_ERROR,
+};
+
+static enum persistent_call_res start_persistent_call(
+		struct fuzz* t, struct worker_info* worker);
+
+static enum persistent_call_res encode_request(
+		struct fuzz* t, uint8_t** output, size_t* output_size);
+
+static bool spawn_persistent_worker(
+		struct fuzz* t, struct worker_info* worker);
+
+static void stop_persistent_worker(struct worker_info* worker);
+
+static void close_other_workers(struct fuzz* t, struct worker_info* self);
+
+static void serve_requests(
+		struct fuzz* t, struct worker_info* worker, int in_fd);
+
+static bool regen_args(struct fuzz* t, uint8_t type, int fd);
+
+static void free_regen_args(struct fuzz* t);
+
+static bool read_all(int fd, void* buf, size_t size);
+
+static bool write_all(int fd, const void* buf, size_t size);
+
+static void ignore_sigpipe(struct fuzz* t, bool ignore);
 
 static int parent_handle_child_call(
 		struct fuzz* t, pid_t pid, struct worker_info* worker);
 
+static int read_worker_result(struct fuzz* t, struct worker_info* worker);
+
+static int handle_worker_timeout(struct fuzz* t, struct worker_info* worker);
+
+static size_t now_msec(void);
+
+static size_t call_timeout(const struct fuzz* t);
+
+static int classify_crash(struct fuzz* t, struct worker_info* worker);
+
+static void limit_resources(struct fuzz* t);
+
+static void limit_cpu(struct fuzz* t);
+
+static size_t vm_size(void);
+
+
 // Returns one of:
 // FUZZ_HOOK_RUN_ERROR
 // FUZZ_HOOK_RUN_CONTINUE
@@ -3493,14 +5745,72 @@ static int run_fork_post_hook(struct fuzz* t, void** args);
 
 static bool step_waitpid(struct fuzz* t);
 
+static void set_worker_pid(struct worker_info* worker, pid_t pid);
+
+static void close_pidfd(struct worker_info* worker);
+
 static bool wait_for_exit(struct fuzz* t, struct worker_info* worker,
 		size_t timeout, size_t kill_timeout);
 
+static int poll_for_exit(
+		struct fuzz* t, struct worker_info* worker, size_t timeout);
+
+static bool wait_for_any_exit(struct fuzz* t, size_t timeout);
+
 #define LOG_CALL 0
 
 #define MAX_FORK_RETRIES 10
 #define DEF_KILL_SIGNAL  SIGTERM
 
+// With fork.adaptive_timeout, how many calls must pass before the timeout
+// adapts, how many calls the average duration is taken over, roughly, and
+// the shortest timeout it adapts to, which leaves room for forking and
+// scheduling delays.
+#define ADAPTIVE_TIMEOUT_MIN_CALLS 16
+#define ADAPTIVE_TIMEOUT_WINDOW    16
+#define ADAPTIVE_TIMEOUT_MIN_MSEC  10
+
+// Signals the crash handler catches, their previous actions, and where it
+// records a crash.
+static const int crash_signals[] = {SIGSEGV, SIGBUS, SIGFPE, SIGILL, SIGABRT};
+#define CRASH_SIGNAL_COUNT (sizeof(crash_signals) / sizeof(crash_signals[0]))
+static bool                            crash_handler_installed;
+static struct sigaction                crash_old_actions[CRASH_SIGNAL_COUNT];
+static struct fuzz_call_info* volatile crash_info;
+
+// SIGPIPE's action before ignore_sigpipe.
+static struct sigaction sigpipe_old_action;
+
+bool
+fuzz_call_init_workers(struct fuzz* t)
+{
+	const size_t size = t->worker_count * sizeof(*t->results);
+	void*        p    = mmap(NULL, size, PROT_READ | PROT_WRITE,
+			      MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+	if (p == MAP_FAILED) {
+		perror("mmap");
+		return false;
+	}
+	t->results = p;
+	for (size_t i = 0; i < t->worker_count; i++) {
+		t->workers[i].shm = &t->results[i];
+	}
+	if (t->fork.persistent) {
+		ignore_sigpipe(t, true);
+	}
+
+#if FUZZ_POLYFILL_HAVE_PIDFD
+	// Check that the kernel supports pidfds at all (Linux 5.3+).
+	const long fd = syscall(SYS_pidfd_open, getpid(), 0);
+	if (fd != -1) {
+		close((int)fd);
+		t->pidfds = true;
+	}
+	errno = 0;
+#endif
+	return true;
+}
+
 // Actually call the property function. Its number of arguments is not
 // constrained by the typedef, but will be defined at the call site
 // here. (If info->arity is wrong, it will probably crash.)
@@ -3508,116 +5818,801 @@ int
 fuzz_call(struct fuzz* t, void** args)
 {
 	if (!t->fork.enable) {
-		return fuzz_call_inner(t, args);
+		return fuzz_call_inner(t, args, &t->call_info);
 	}
 
 	// We should've bailed if we don't have fork a long time ago.
 	assert(FUZZ_POLYFILL_HAVE_FORK);
 
-	struct timespec tv = {.tv_nsec = 1};
-	if (-1 == pipe(t->workers[0].fds)) {
+	struct worker_info* worker = &t->workers[0];
+	if (!start_worker(t, worker, args)) {
+		return FUZZ_RESULT_ERROR;
+	}
+
+	int res = parent_handle_child_call(t, worker->pid, worker);
+	fuzz_call_take_info(t, worker);
+	finish_call(t, worker);
+	if (!worker->persistent) {
+		worker->state = WS_INACTIVE;
+	}
+
+	if (!step_waitpid(t)) {
 		return FUZZ_RESULT_ERROR;
 	}
+	return res;
+}
+
+bool
+fuzz_call_start(struct fuzz* t, struct worker_info* worker, void** args)
+{
+	assert(t->fork.enable);
+	assert(!worker->busy);
+	if (!start_worker(t, worker, args)) {
+		return false;
+	}
+
+	worker->busy     = true;
+	worker->done     = false;
+	worker->result   = FUZZ_RESULT_ERROR;
+	const size_t timeout = call_timeout(t);
+	worker->deadline     = (timeout == 0 ? 0 : now_msec() + timeout);
+	return true;
+}
+
+bool
+fuzz_call_poll(struct fuzz* t, struct worker_info* workers, size_t count)
+{
+	struct pollfd* pfds = malloc(count * sizeof(*pfds));
+	if (pfds == NULL) {
+		return false;
+	}
+
+	// Poll all running workers at once, waking up in time for the
+	// earliest deadline.
+	size_t now     = now_msec();
+	nfds_t nfds    = 0;
+	int    timeout = -1;
+	for (size_t i = 0; i < count; i++) {
+		struct worker_info* worker = &workers[i];
+		if (!worker->busy || worker->done) {
+			continue;
+		}
+
+		if (worker->deadline != 0) {
+			const size_t remaining = (worker->deadline > now
+								  ? worker->deadline - now
+								  : 0);
+			assert(remaining <= INT_MAX);
+			if (timeout == -1 || (int)remaining < timeout) {
+				timeout = (int)remaining;
+			}
+		}
+		pfds[nfds++] = (struct pollfd){
+				.fd     = result_fd(worker),
+				.events = POLLIN,
+		};
+	}
+
+	if (nfds == 0) {
+		free(pfds);
+		return true;
+	}
+
+	int res = poll(pfds, nfds, timeout);
+	LOG(3 - LOG_CALL, "%s: POLL res %d, %zd workers\n", __func__, res,
+			(size_t)nfds);
+	if (res == -1) {
+		free(pfds);
+		if (errno == EAGAIN || errno == EINTR) {
+			errno = 0;
+			return true; // caller will poll again
+		}
+		return false;
+	}
+
+	now         = now_msec();
+	nfds_t pi   = 0;
+	bool   okay = true;
+	for (size_t i = 0; i < count; i++) {
+		struct worker_info* worker = &workers[i];
+		if (!worker->busy || worker->done) {
+			continue;
+		}
+
+		const struct pollfd* pfd = &pfds[pi++];
+		if (pfd->revents != 0) {
+			worker->result = read_worker_result(t, worker);
+		} else if (worker->deadline != 0 && now >= worker->deadline) {
+			worker->result = handle_worker_timeout(t, worker);
+		} else {
+			continue;
+		}
+
+		if (worker->result == FUZZ_RESULT_ERROR) {
+			okay = false;
+		}
+		finish_call(t, worker);
+		worker->done = true;
+	}
+	free(pfds);
+
+	if (!step_waitpid(t)) {
+		return false;
+	}
+	return okay;
+}
+
+void
+fuzz_call_take_info(struct fuzz* t, const struct worker_info* worker)
+{
+	memcpy(&t->call_info, &worker->shm->info, sizeof(t->call_info));
+}
+
+void
+fuzz_call_abandon(struct fuzz* t, struct worker_info* worker)
+{
+	if (!worker->busy) {
+		return;
+	}
+
+	if (!worker->done) {
+		LOG(2 - LOG_CALL, "%s: abandoning %d\n", __func__, worker->pid);
+		if (worker->persistent) {
+			stop_persistent_worker(worker);
+		} else if (worker->piped) {
+			close(worker->fds[0]);
+		}
+
+		// Send SIGKILL right away and give it a moment to exit; if
+		// it still hasn't, a later waitpid() will reap it.
+		const size_t kill_time = 10;
+		if (worker->state == WS_ACTIVE) {
+			(void)wait_for_exit(t, worker, 0, kill_time);
+		}
+	}
+	worker->busy = false;
+	worker->done = false;
+}
+
+// Start a call of the property function with ARGS in a worker process,
+// which writes its result to the worker's shared block. With
+// fork.persistent, the call is sent to the worker's running process if
+// possible; otherwise a process is forked just for this call.
+//
+// A forked process is waited for with a pidfd if possible, since its exit
+// means the call is done. Otherwise, it also gets a pipe to signal that.
+static bool
+start_worker(struct fuzz* t, struct worker_info* worker, void** args)
+{
+	memset(worker->shm, 0x00, sizeof(*worker->shm));
+
+	if (t->fork.persistent) {
+		switch (start_persistent_call(t, worker)) {
+		case PERSISTENT_CALL_OK:
+			return true;
+		case PERSISTENT_CALL_UNSUPPORTED:
+			if (worker->persistent) {
+				stop_persistent_worker(worker);
+			}
+			break;
+		default:
+		case PERSISTENT_CALL_ERROR:
+			return false;
+		}
+	}
+
+	worker->piped = !t->pidfds;
+	if (worker->piped && -1 == pipe(worker->fds)) {
+		return false;
+	}
+
+	pid_t pid = fork_worker(t);
+	if (pid == -1) {
+		if (worker->piped) {
+			close(worker->fds[0]);
+			close(worker->fds[1]);
+		}
+		return false;
+	}
+
+	if (pid == 0) { // child
+		if (worker->piped) {
+			close(worker->fds[0]);
+		}
+		close_other_workers(t, worker);
+		limit_resources(t);
+		if (run_fork_post_hook(t, args) == FUZZ_HOOK_RUN_ERROR) {
+			(void)reply(worker, FUZZ_RESULT_ERROR);
+			exit(EXIT_FAILURE);
+		}
+		watch_crashes(&worker->shm->info);
+		int res = fuzz_call_inner(t, args, &worker->shm->info);
+		exit(reply(worker, res) && res == FUZZ_RESULT_OK
+						? EXIT_SUCCESS
+						: EXIT_FAILURE);
+	}
+
+	// parent
+	if (worker->piped) {
+		close(worker->fds[1]);
+	}
+	set_worker_pid(worker, pid);
+	if (!worker->piped && worker->pidfd == -1) {
+		// Without a pipe, there'd be no way to wait for it.
+		(void)kill(pid, SIGKILL);
+		return false;
+	}
+	return true;
+}
+
+// In a worker process, make the call's result available to the parent.
+static bool
+reply(struct worker_info* worker, int res)
+{
+	worker->shm->result = res;
+	worker->shm->done   = true;
+	if (!worker->piped) {
+		return true; // the parent waits for this process to exit
+	}
+	uint8_t byte = (uint8_t)res;
+	return write_all(worker->fds[1], &byte, sizeof(byte));
+}
+
+// In a worker process, record the signal, faulting address and errno in
+// INFO if the process crashes. The previous handlers (such as a
+// sanitizer's) still run afterward.
+static void
+watch_crashes(struct fuzz_call_info* info)
+{
+	crash_info = info;
+	if (crash_handler_installed) {
+		return; // a persistent worker's earlier call installed it
+	}
+	crash_handler_installed = true;
+
+	for (size_t i = 0; i < CRASH_SIGNAL_COUNT; i++) {
+		struct sigaction action;
+		memset(&action, 0x00, sizeof(action));
+		action.sa_sigaction = on_crash;
+		action.sa_flags     = SA_SIGINFO | SA_RESETHAND;
+		sigemptyset(&action.sa_mask);
+		if (-1 == sigaction(crash_signals[i], &action,
+					  &crash_old_actions[i])) {
+			errno = 0; // crash sites just won't be recorded
+		}
+	}
+}
+
+static void
+on_crash(int sig, siginfo_t* info, void* context)
+{
+	struct fuzz_call_info* ci = crash_info;
+	if (ci != NULL && ci->crash_signal == 0) {
+		ci->crash_errno  = errno;
+		ci->crash_signal = sig;
+#if !defined(_WIN32)
+		if (info->si_code > 0) { // sent by the kernel, for a fault
+			ci->crash_addr = (uintptr_t)info->si_addr;
+		}
+#endif
+	}
+
+	for (size_t i = 0; i < CRASH_SIGNAL_COUNT; i++) {
+		const struct sigaction* old = &crash_old_actions[i];
+		if (crash_signals[i] != sig) {
+			continue;
+		} else if ((old->sa_flags & SA_SIGINFO) &&
+				old->sa_sigaction != NULL) {
+			old->sa_sigaction(sig, info, context);
+			return;
+		} else if (old->sa_handler != SIG_DFL &&
+				old->sa_handler != SIG_IGN) {
+			old->sa_handler(sig);
+			return;
+		}
+	}
+
+	// SA_RESETHAND restored the default action, so this kills the
+	// process once the handler returns, even if the signal was sent
+	// rather than caused by a fault.
+	raise(sig);
+}
+
+// The descriptor that becomes readable once WORKER's call is done.
+static int
+result_fd(const struct worker_info* worker)
+{
+	return worker->piped ? worker->fds[0] : worker->pidfd;
+}
+
+// Fork, retrying for a while if the process limit has been reached. Returns
+// the same as fork().
+static pid_t
+fork_worker(struct fuzz* t)
+{
+	// Otherwise, anything still buffered would be written again by the
+	// child when it exits.
+	fflush(NULL);
 
-	int   res = FUZZ_RESULT_ERROR;
 	pid_t pid = -1;
-	for (;;) {
+	for (int retries = 0;; retries++) {
 		pid = fork();
+		if (pid == 0 && t->ignoring_sigpipe) {
+			sigaction(SIGPIPE, &sigpipe_old_action, NULL);
+		}
 		if (pid != -1) {
 			break;
 		}
 
 		if (errno != EAGAIN) {
 			perror("fork");
-			return FUZZ_RESULT_ERROR;
+			break;
 		}
 
-		// If we get EAGAIN, then wait for terminated child processes a
+		if (retries == MAX_FORK_RETRIES) {
+			perror("fork");
+			break;
+		}
+
+		// If we get EAGAIN, then give terminated child processes a
 		// chance to clean up -- forking is probably failing due to
-		// RLIMIT_NPROC.
+		// RLIMIT_NPROC. Retry as soon as one of ours exits, or after
+		// a backoff if no other process of ours is running.
 		const int fork_errno = errno;
-		if (!step_waitpid(t)) {
-			return FUZZ_RESULT_ERROR;
+		if (!wait_for_any_exit(t, (size_t)1 << retries)) {
+			break;
 		}
+		errno = fork_errno;
+	}
+	return pid;
+}
 
-		if (-1 == nanosleep(&tv, NULL)) {
-			perror("nanosleep");
-			return FUZZ_RESULT_ERROR;
+// Clean up after a worker's call has returned or timed out. A persistent
+// worker that replied is kept for the next call, until it has run
+// fork.persistent_calls of them.
+static void
+finish_call(struct fuzz* t, struct worker_info* worker)
+{
+	if (!worker->persistent) {
+		if (worker->piped) {
+			close(worker->fds[0]);
 		}
+	} else if (!worker->replied ||
+			worker->calls >= t->fork.persistent_calls) {
+		stop_persistent_worker(worker);
+	}
+}
 
-		if (tv.tv_nsec >= (1L << MAX_FORK_RETRIES)) {
-			errno = fork_errno;
-			perror("fork");
-			return FUZZ_RESULT_ERROR;
+void
+fuzz_call_stop_workers(struct fuzz* t)
+{
+	const size_t kill_time    = 10;
+	const size_t timeout_msec = (t->fork.exit_timeout == 0
+						     ? FUZZ_DEF_EXIT_TIMEOUT_MSEC
+						     : t->fork.exit_timeout);
+	for (size_t i = 0; i < t->worker_count; i++) {
+		struct worker_info* worker = &t->workers[i];
+		if (!worker->persistent) {
+			continue;
+		}
+
+		// It exits once it reads EOF from its request pipe.
+		stop_persistent_worker(worker);
+		if (worker->state == WS_ACTIVE) {
+			(void)wait_for_exit(t, worker, timeout_msec, kill_time);
+		}
+	}
+
+	// Anything not reaped by now is left for the caller's own waitpid().
+	for (size_t i = 0; i < t->worker_count; i++) {
+		close_pidfd(&t->workers[i]);
+		t->workers[i].shm = NULL;
+	}
+
+	if (t->results != NULL) {
+		munmap(t->results, t->worker_count * sizeof(*t->results));
+		t->results = NULL;
+	}
+	ignore_sigpipe(t, false);
+}
+
+// Send a call with the current trial's arguments to WORKER's persistent
+// process, starting one first if needed.
+static enum persistent_call_res
+start_persistent_call(struct fuzz* t, struct worker_info* worker)
+{
+	uint8_t* request = NULL;
+	size_t   size    = 0;
+
+	enum persistent_call_res res = encode_request(t, &request, &size);
+	if (res != PERSISTENT_CALL_OK) {
+		return res;
+	}
+
+	// If the process has exited since its last call, writing fails with
+	// EPIPE. In that case, replace it and try once more.
+	res = PERSISTENT_CALL_ERROR;
+	for (int attempt = 0; attempt < 2; attempt++) {
+		if (!worker->persistent &&
+				!spawn_persistent_worker(t, worker)) {
+			break;
+		}
+
+		if (write_all(worker->req_fd, request, size)) {
+			res = PERSISTENT_CALL_OK;
+			break;
+		} else if (errno != EPIPE) {
+			perror("write");
+			break;
 		}
 
+		LOG(2 - LOG_CALL, "%s: worker %d went away, replacing it\n",
+				__func__, worker->pid);
 		errno = 0;
-		tv.tv_nsec <<= 1;
-		continue;
+		stop_persistent_worker(worker);
+	}
+	free(request);
+
+	if (res == PERSISTENT_CALL_OK) {
+		worker->calls++;
+		worker->replied = false;
 	}
+	return res;
+}
+
+enum call_request_type {
+	CALL_REQUEST_SEED,      // generate the arguments from the seed
+	CALL_REQUEST_BIT_POOLS, // replay the autoshrink bit pools that follow
+};
 
+// A call sent to a persistent worker. With CALL_REQUEST_BIT_POOLS, it is
+// followed by a call_request_pool and the pool's bits for each argument.
+struct call_request {
+	uint8_t  type;
+	uint64_t seed;
+	size_t   failures; // for the post-fork hook
+};
+
+struct call_request_pool {
+	size_t bits_filled;
+	size_t bits_ceil;
+	size_t limit;
+};
+
+// Encode a call with the current trial's arguments.
+static enum persistent_call_res
+encode_request(struct fuzz* t, uint8_t** output, size_t* output_size)
+{
+	// Until shrinking starts, the arguments are just what the trial's
+	// seed generates. After that, they can only be sent if they were all
+	// generated from bit pools.
+	const bool          by_seed = (t->trial.shrink_count == 0);
+	struct call_request header  = {
+			.type     = (by_seed ? CALL_REQUEST_SEED
+					     : CALL_REQUEST_BIT_POOLS),
+			.seed     = t->trial.seed,
+			.failures = t->counters.fail,
+	};
+
+	size_t size = sizeof(header);
+	for (uint8_t i = 0; !by_seed && i < t->prop.arity; i++) {
+		const struct arg_info* ai = &t->trial.args[i];
+		if (ai->type != ARG_AUTOSHRINK) {
+			return PERSISTENT_CALL_UNSUPPORTED;
+		}
+		size += sizeof(struct call_request_pool) +
+			ai->u.as.env->bit_pool->bits_ceil / 8;
+	}
+
+	uint8_t* buf = malloc(size);
+	if (buf == NULL) {
+		return PERSISTENT_CALL_ERROR;
+	}
+
+	memcpy(buf, &header, sizeof(header));
+	size_t offset = sizeof(header);
+	for (uint8_t i = 0; !by_seed && i < t->prop.arity; i++) {
+		const struct autoshrink_bit_pool* pool =
+				t->trial.args[i].u.as.env->bit_pool;
+		const struct call_request_pool pool_header = {
+				.bits_filled = pool->bits_filled,
+				.bits_ceil   = pool->bits_ceil,
+				.limit       = pool->limit,
+		};
+		memcpy(&buf[offset], &pool_header, sizeof(pool_header));
+		offset += sizeof(pool_header);
+		assert((offset % sizeof(uint64_t)) == 0);
+		fuzz_autoshrink_read_bit_pool(pool, pool->bits_ceil,
+				(uint64_t*)&buf[offset]);
+		offset += pool->bits_ceil / 8;
+	}
+	assert(offset == size);
+
+	*output      = buf;
+	*output_size = size;
+	return PERSISTENT_CALL_OK;
+}
+
+// Fork a persistent process for WORKER, which runs the calls sent to it
+// until its request pipe is closed.
+static bool
+spawn_persistent_worker(struct fuzz* t, struct worker_info* worker)
+{
+	int req_fds[2];
+	if (-1 == pipe(req_fds)) {
+		return false;
+	}
+	if (-1 == pipe(worker->fds)) {
+		close(req_fds[0]);
+		close(req_fds[1]);
+		return false;
+	}
+
+	pid_t pid = fork_worker(t);
 	if (pid == -1) {
-		close(t->workers[0].fds[0]);
-		close(t->workers[0].fds[1]);
-		return FUZZ_RESULT_ERROR;
+		close(req_fds[0]);
+		close(req_fds[1]);
+		close(worker->fds[0]);
+		close(worker->fds[1]);
+		return false;
 	}
 
 	if (pid == 0) { // child
-		close(t->workers[0].fds[0]);
-		int out_fd = t->workers[0].fds[1];
-		if (run_fork_post_hook(t, args) == FUZZ_HOOK_RUN_ERROR) {
-			uint8_t byte = (uint8_t)FUZZ_RESULT_ERROR;
-			ssize_t wr   = write(out_fd, (const void*)&byte,
-					  sizeof(byte));
-			(void)wr;
+		close(req_fds[1]);
+		close(worker->fds[0]);
+		close_other_workers(t, worker);
+		limit_resources(t);
+		worker->piped = true;
+		serve_requests(t, worker, req_fds[0]);
+		exit(EXIT_SUCCESS);
+	}
+
+	// parent
+	LOG(2 - LOG_CALL, "%s: started %d\n", __func__, pid);
+	close(req_fds[0]);
+	close(worker->fds[1]);
+	set_worker_pid(worker, pid);
+	worker->persistent = true;
+	worker->piped      = true;
+	worker->req_fd     = req_fds[1];
+	worker->calls      = 0;
+	return true;
+}
+
+// Close the parent's ends of a persistent worker's pipes. Its process exits
+// once it reads EOF, and is cleaned up by a later step_waitpid.
+static void
+stop_persistent_worker(struct worker_info* worker)
+{
+	close(worker->req_fd);
+	close(worker->fds[0]);
+	worker->persistent = false;
+}
+
+// In a newly forked worker, close its copies of the other persistent
+// workers' pipes, so they still get EOF when the parent closes them, and
+// of the parent's pidfds.
+static void
+close_other_workers(struct fuzz* t, struct worker_info* self)
+{
+	for (size_t i = 0; i < t->worker_count; i++) {
+		struct worker_info* worker = &t->workers[i];
+		close_pidfd(worker);
+		if (worker != self && worker->persistent) {
+			close(worker->req_fd);
+			close(worker->fds[0]);
+			worker->persistent = false;
+		}
+	}
+}
+
+// The loop run by a persistent worker: read a call, regenerate its
+// arguments, call the property function, and write back the result.
+static void
+serve_requests(struct fuzz* t, struct worker_info* worker, int in_fd)
+{
+	// Keep the parent's trial, which is overwritten below, so its
+	// arguments aren't reported as leaked when this process exits.
+	struct trial_info parent_trial;
+	memcpy(&parent_trial, &t->trial, sizeof(parent_trial));
+
+	for (;;) {
+		struct call_request req;
+		if (!read_all(in_fd, &req, sizeof(req))) {
+			memcpy(&t->trial, &parent_trial, sizeof(parent_trial));
+			return; // the parent is done with this worker
+		}
+
+		struct trial_info trial_info = {.seed = req.seed};
+		memcpy(&t->trial, &trial_info, sizeof(trial_info));
+		t->counters.fail = req.failures;
+
+		int  res  = FUZZ_RESULT_ERROR;
+		bool okay = regen_args(t, req.type, in_fd);
+		if (okay) {
+			void* args[FUZZ_MAX_ARITY];
+			for (uint8_t i = 0; i < t->prop.arity; i++) {
+				args[i] = t->trial.args[i].instance;
+			}
+			if (run_fork_post_hook(t, args) ==
+					FUZZ_HOOK_RUN_ERROR) {
+				okay = false;
+			} else {
+				watch_crashes(&worker->shm->info);
+				limit_cpu(t);
+				res = fuzz_call_inner(
+						t, args, &worker->shm->info);
+			}
+		}
+		free_regen_args(t);
+
+		if (!reply(worker, res) || !okay) {
 			exit(EXIT_FAILURE);
 		}
-		res          = fuzz_call_inner(t, args);
-		uint8_t byte = (uint8_t)res;
-		ssize_t wr   = write(out_fd, (const void*)&byte, sizeof(byte));
-		exit(wr == 1 && res == FUZZ_RESULT_OK ? EXIT_SUCCESS
-						      : EXIT_FAILURE);
 	}
+}
+
+// Regenerate the current trial's arguments, either from its seed or from
+// the bit pools that follow the request on FD.
+static bool
+regen_args(struct fuzz* t, uint8_t type, int fd)
+{
+	for (uint8_t i = 0; i < t->prop.arity; i++) {
+		const struct fuzz_type_info* ti = t->prop.type_info[i];
+		if (ti->autoshrink_config.enable) {
+			t->trial.args[i].type = ARG_AUTOSHRINK;
+			t->trial.args[i].u.as.env =
+					fuzz_autoshrink_alloc_env(t, i, ti);
+			if (t->trial.args[i].u.as.env == NULL) {
+				return false;
+			}
+		}
+	}
+
+	if (type == CALL_REQUEST_SEED) {
+		fuzz_random_set_seed(t, t->trial.seed);
+	}
+
+	for (uint8_t i = 0; i < t->prop.arity; i++) {
+		struct fuzz_type_info* ti  = t->prop.type_info[i];
+		struct arg_info*       ai  = &t->trial.args[i];
+		void*                  p   = NULL;
+		int                    res = FUZZ_RESULT_ERROR;
+
+		if (type == CALL_REQUEST_SEED) {
+			res = (ai->type == ARG_AUTOSHRINK
+							? fuzz_autoshrink_alloc(t,
+									  ai->u.as.env,
+									  &p)
+							: ti->alloc(t, ti->env,
+									  &p));
+		} else {
+			assert(ai->type == ARG_AUTOSHRINK);
+			struct call_request_pool header;
+			if (!read_all(fd, &header, sizeof(header))) {
+				return false;
+			}
+
+			struct autoshrink_bit_pool* pool = alloc_bit_pool(t,
+					header.bits_ceil, header.limit,
+					DEF_REQUESTS_CEIL);
+			if (pool == NULL) {
+				return false;
+			}
+			ai->u.as.env->bit_pool = pool;
+			if (!read_all(fd, pool->bits, header.bits_ceil / 8)) {
+				return false;
+			}
+			pool->bits_filled = header.bits_filled;
+			res = alloc_from_bit_pool(
+					t, ai->u.as.env, pool, &p, true);
+		}
+
+		if (res != FUZZ_RESULT_OK) {
+			return false;
+		}
+		ai->instance = p;
+	}
+	return true;
+}
+
+static void
+free_regen_args(struct fuzz* t)
+{
+	for (uint8_t i = 0; i < t->prop.arity; i++) {
+		struct fuzz_type_info* ti = t->prop.type_info[i];
+		struct arg_info*       ai = &t->trial.args[i];
+		if (ai->type == ARG_AUTOSHRINK && ai->u.as.env != NULL) {
+			fuzz_autoshrink_free_env(t, ai->u.as.env);
+		}
+		if (ai->instance != NULL && ti->free != NULL) {
+			ti->free(ai->instance, ti->env);
+		}
+	}
+	memset(&t->trial, 0x00, sizeof(t->trial));
+}
+
+// Read exactly SIZE bytes. Returns false on error or EOF.
+static bool
+read_all(int fd, void* buf, size_t size)
+{
+	uint8_t* dst = buf;
+	while (size > 0) {
+		ssize_t rd = read(fd, dst, size);
+		if (rd == -1 && errno == EINTR) {
+			errno = 0;
+			continue;
+		} else if (rd <= 0) {
+			return false;
+		}
+		dst += rd;
+		size -= (size_t)rd;
+	}
+	return true;
+}
+
+static bool
+write_all(int fd, const void* buf, size_t size)
+{
+	const uint8_t* src = buf;
+	while (size > 0) {
+		ssize_t wr = write(fd, src, size);
+		if (wr == -1 && errno == EINTR) {
+			errno = 0;
+			continue;
+		} else if (wr <= 0) {
+			return false;
+		}
+		src += wr;
+		size -= (size_t)wr;
+	}
+	return true;
+}
 
-	// parent
-	close(t->workers[0].fds[1]);
-	t->workers[0].pid = pid;
-
-	t->workers[0].state = WS_ACTIVE;
-	res                 = parent_handle_child_call(t, pid, &t->workers[0]);
-	close(t->workers[0].fds[0]);
-	t->workers[0].state = WS_INACTIVE;
+// While a run has persistent workers, SIGPIPE is ignored, so writing a
+// request to a worker that has exited fails with EPIPE instead. Workers
+// are forked with the previous action restored.
+static void
+ignore_sigpipe(struct fuzz* t, bool ignore)
+{
+	if (ignore == t->ignoring_sigpipe) {
+		return;
+	} else if (!ignore) {
+		sigaction(SIGPIPE, &sigpipe_old_action, NULL);
+		t->ignoring_sigpipe = false;
+		return;
+	}
 
-	if (!step_waitpid(t)) {
-		return FUZZ_RESULT_ERROR;
+	struct sigaction action;
+	memset(&action, 0x00, sizeof(action));
+	action.sa_handler = SIG_IGN;
+	sigemptyset(&action.sa_mask);
+	if (-1 == sigaction(SIGPIPE, &action, &sigpipe_old_action)) {
+		errno = 0; // a worker exiting will just raise SIGPIPE
+		return;
 	}
-	return res;
+	t->ignoring_sigpipe = true;
 }
 
 static int
 parent_handle_child_call(struct fuzz* t, pid_t pid, struct worker_info* worker)
 {
-	const int     fd     = worker->fds[0];
+	const int     fd     = result_fd(worker);
 	struct pollfd pfd[1] = {
 			{.fd = fd, .events = POLLIN},
 	};
-	assert(t->fork.timeout <= INT_MAX);
-	const size_t timeout = t->fork.timeout;
-	int          res     = 0;
+	const size_t timeout  = call_timeout(t);
+	const size_t deadline = (timeout == 0 ? 0 : now_msec() + timeout);
+	int          res      = 0;
 	for (;;) {
-		struct timeval tv_pre = {0, 0};
-		gettimeofday(&tv_pre, NULL);
-		res = poll(pfd, 1, (timeout == 0 ? -1 : (int)timeout));
-		struct timeval tv_post = {0, 0};
-		gettimeofday(&tv_post, NULL);
-
-		const size_t delta = 1000 * tv_post.tv_sec -
-				     1000 * tv_pre.tv_sec +
-				     ((tv_post.tv_usec / 1000) -
-						     (tv_pre.tv_usec / 1000));
-		LOG(3 - LOG_CALL, "%s: POLL res %d, elapsed %zd\n", __func__,
-				res, delta);
-		(void)delta;
+		// Waking up early for a signal doesn't restart the timeout.
+		int timeout = -1;
+		if (deadline != 0) {
+			const size_t now = now_msec();
+			timeout = (int)(deadline > now ? deadline - now : 0);
+		}
+		res = poll(pfd, 1, timeout);
+		LOG(3 - LOG_CALL, "%s: POLL res %d\n", __func__, res);
 
 		if (res == -1) {
 			if (errno == EAGAIN) {
@@ -3634,78 +6629,263 @@ parent_handle_child_call(struct fuzz* t, pid_t pid, struct worker_info* worker)
 		}
 	}
 
+	assert(pid == worker->pid);
+	(void)pid;
 	if (res == 0) { // timeout
-		int kill_signal = t->fork.signal;
-		if (kill_signal == 0) {
-			kill_signal = DEF_KILL_SIGNAL;
-		}
-		LOG(2 - LOG_CALL, "%s: kill(%d, %d)\n", __func__, pid,
-				kill_signal);
-		assert(pid != -1); // do not do this.
-		if (-1 == kill(pid, kill_signal)) {
-			return FUZZ_RESULT_ERROR;
-		}
-
-		// Check if kill's signal made the child process terminate (or
-		// if it exited successfully, and there was just a race on the
-		// timeout). If so, save its exit status.
-		//
-		// If it still hasn't exited after the exit_timeout, then
-		// send it SIGKILL and wait for _that_ to make it exit.
-		const size_t kill_time = 10; // time to exit after SIGKILL
-		const size_t timeout_msec =
-				(t->fork.exit_timeout == 0 ? FUZZ_DEF_EXIT_TIMEOUT_MSEC
-							   : t->fork.exit_timeout);
-
-		// After sending the signal to the timed out process,
-		// give it timeout_msec to actually exit (in case a custom
-		// signal is triggering some sort of cleanup) before sending
-		// SIGKILL and waiting up to kill_time it to change state.
-		if (!wait_for_exit(t, worker, timeout_msec, kill_time)) {
-			return FUZZ_RESULT_ERROR;
-		}
-
-		// If the child still exited successfully, then consider it a
-		// PASS, even though it exceeded the timeout.
-		if (worker->state == WS_STOPPED) {
-			const int st = worker->wstatus;
-			LOG(2 - LOG_CALL, "exited? %d, exit_status %d\n",
-					WIFEXITED(st), WEXITSTATUS(st));
-			if (WIFEXITED(st) && WEXITSTATUS(st) == EXIT_SUCCESS) {
-				return FUZZ_RESULT_OK;
-			}
-		}
-
-		return FUZZ_RESULT_FAIL;
+		return handle_worker_timeout(t, worker);
 	} else {
 		// As long as the result isn't a timeout, the worker can
 		// just be cleaned up by the next batch of waitpid()s.
-		int     trial_res = FUZZ_RESULT_ERROR;
-		uint8_t res_byte  = 0xFF;
-		ssize_t rd        = 0;
+		return read_worker_result(t, worker);
+	}
+}
+
+// Get the result a worker wrote to its shared block, once its pipe or
+// pidfd is readable.
+static int
+read_worker_result(struct fuzz* t, struct worker_info* worker)
+{
+	if (worker->piped) {
+		// The byte is only a notification; EOF means it exited.
+		uint8_t res_byte = 0xFF;
 		for (;;) {
-			rd = read(fd, &res_byte, sizeof(res_byte));
+			ssize_t rd = read(worker->fds[0], &res_byte,
+					sizeof(res_byte));
 			if (rd == -1) {
 				if (errno == EINTR) {
 					errno = 0;
 					continue;
 				}
 				return FUZZ_RESULT_ERROR;
-			} else {
-				break;
 			}
+			break;
 		}
+	}
 
-		if (rd == 0) {
-			// closed without response -> crashed
-			trial_res = FUZZ_RESULT_FAIL;
+	struct worker_result* shm = worker->shm;
+	if (!shm->done) {
+		return classify_crash(t, worker); // exited without a response
+	}
+
+	worker->replied = true;
+	if (shm->result == FUZZ_RESULT_OK) {
+		// Each call has weight 1/ADAPTIVE_TIMEOUT_WINDOW, so a few
+		// slow ones don't raise the timeout for long.
+		const uint64_t usec = shm->info.duration_usec;
+		uint64_t*      avg  = &t->avg_passing_usec;
+		if (t->passing_calls++ == 0) {
+			*avg = usec;
+		} else if (usec > *avg) {
+			*avg += (usec - *avg) / ADAPTIVE_TIMEOUT_WINDOW;
 		} else {
-			assert(rd == 1);
-			trial_res = (int)res_byte;
+			*avg -= (*avg - usec) / ADAPTIVE_TIMEOUT_WINDOW;
+		}
+	}
+	return shm->result;
+}
+
+// Work out why a worker exited without finishing its call. Running out of
+// CPU time (SIGXCPU) is a timeout. With fork.memory_limit, crashing while
+// errno is ENOMEM (usually from aborting or dereferencing NULL after an
+// allocation failed under the limit) is running out of memory. errno is
+// cleared before each call, so that can't be left over from before it.
+// Any other signal, including SIGKILL, is a crash: the kernel's OOM killer
+// doesn't mean the call went over a limit set for it.
+static int
+classify_crash(struct fuzz* t, struct worker_info* worker)
+{
+	// Its pipe was closed, so it should be exiting, if it hasn't already.
+	const size_t exit_timeout = (t->fork.exit_timeout == 0
+						     ? FUZZ_DEF_EXIT_TIMEOUT_MSEC
+						     : t->fork.exit_timeout);
+	if (worker->state == WS_ACTIVE &&
+			!wait_for_exit(t, worker, exit_timeout, 0)) {
+		return FUZZ_RESULT_ERROR;
+	}
+
+	// Signals the crash handler doesn't catch are only in the status.
+	struct fuzz_call_info* info = &worker->shm->info;
+	if (info->crash_signal == 0 && worker->state == WS_STOPPED &&
+			WIFSIGNALED(worker->wstatus)) {
+		info->crash_signal = WTERMSIG(worker->wstatus);
+	}
+
+	const int sig = info->crash_signal;
+	if (sig == 0) {
+		return FUZZ_RESULT_FAIL; // exited some other way
+	} else if (sig == SIGXCPU) {
+		return FUZZ_RESULT_TIMEOUT;
+	} else if (t->fork.memory_limit > 0 && info->crash_errno == ENOMEM) {
+		return FUZZ_RESULT_OOM;
+	}
+	return FUZZ_RESULT_CRASH(sig);
+}
+
+// Signal a worker that exceeded the timeout, and wait for it to exit.
+static int
+handle_worker_timeout(struct fuzz* t, struct worker_info* worker)
+{
+	const pid_t pid         = worker->pid;
+	int         kill_signal = t->fork.signal;
+	if (kill_signal == 0) {
+		kill_signal = DEF_KILL_SIGNAL;
+	}
+	LOG(2 - LOG_CALL, "%s: kill(%d, %d)\n", __func__, pid, kill_signal);
+	assert(pid != -1); // do not do this.
+	if (-1 == kill(pid, kill_signal)) {
+		return FUZZ_RESULT_ERROR;
+	}
+
+	// Check if kill's signal made the child process terminate (or
+	// if it exited successfully, and there was just a race on the
+	// timeout). If so, save its exit status.
+	//
+	// If it still hasn't exited after the exit_timeout, then
+	// send it SIGKILL and wait for _that_ to make it exit.
+	const size_t kill_time = 10; // time to exit after SIGKILL
+	const size_t timeout_msec =
+			(t->fork.exit_timeout == 0 ? FUZZ_DEF_EXIT_TIMEOUT_MSEC
+						   : t->fork.exit_timeout);
+
+	// After sending the signal to the timed out process,
+	// give it timeout_msec to actually exit (in case a custom
+	// signal is triggering some sort of cleanup) before sending
+	// SIGKILL and waiting up to kill_time it to change state.
+	if (!wait_for_exit(t, worker, timeout_msec, kill_time)) {
+		return FUZZ_RESULT_ERROR;
+	}
+
+	// If the call finished after all (and the process was just slow to
+	// exit), use its result.
+	if (worker->shm->done) {
+		worker->replied = true;
+		return worker->shm->result;
+	}
+
+	// If the child still exited successfully, then consider it a
+	// PASS, even though it exceeded the timeout.
+	if (worker->state == WS_STOPPED) {
+		const int st = worker->wstatus;
+		LOG(2 - LOG_CALL, "exited? %d, exit_status %d\n",
+				WIFEXITED(st), WEXITSTATUS(st));
+		if (WIFEXITED(st) && WEXITSTATUS(st) == EXIT_SUCCESS) {
+			return FUZZ_RESULT_OK;
+		}
+	}
+
+	return FUZZ_RESULT_TIMEOUT;
+}
+
+// Milliseconds since some arbitrary starting point. This uses the
+// monotonic clock, so timeouts aren't affected by changes to the time of
+// day.
+static size_t
+now_msec(void)
+{
+	struct timespec ts = {0, 0};
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return 1000 * (size_t)ts.tv_sec + (size_t)(ts.tv_nsec / 1000000);
+}
+
+// The timeout for a call, in msec, or 0 for none. With
+// fork.adaptive_timeout, this shrinks to a multiple of the average passing
+// call, once enough calls have passed.
+static size_t
+call_timeout(const struct fuzz* t)
+{
+	size_t timeout = t->fork.timeout;
+	if (t->fork.adaptive_timeout > 0 &&
+			t->passing_calls >= ADAPTIVE_TIMEOUT_MIN_CALLS) {
+		const uint64_t avg_msec = t->avg_passing_usec / 1000 + 1;
+		size_t         adaptive = SIZE_MAX;
+		if (avg_msec <= SIZE_MAX / t->fork.adaptive_timeout) {
+			adaptive = (size_t)avg_msec * t->fork.adaptive_timeout;
+		}
+		if (adaptive < ADAPTIVE_TIMEOUT_MIN_MSEC) {
+			adaptive = ADAPTIVE_TIMEOUT_MIN_MSEC;
+		}
+		if (timeout == 0 || adaptive < timeout) {
+			timeout = adaptive;
+		}
+	}
+	assert(timeout <= INT_MAX);
+	return timeout;
+}
+
+// In a worker process, apply fork.memory_limit and fork.cpu_limit. The
+// memory limit is on top of the address space the worker started with,
+// since it inherits all of the parent's mappings when it's forked.
+static void
+limit_resources(struct fuzz* t)
+{
+	if (t->fork.memory_limit > 0) {
+		struct rlimit limit;
+		if (0 == getrlimit(RLIMIT_AS, &limit)) {
+			size_t size = vm_size();
+			if (size > SIZE_MAX - t->fork.memory_limit) {
+				size = SIZE_MAX - t->fork.memory_limit;
+			}
+			limit.rlim_cur = (rlim_t)(size + t->fork.memory_limit);
+			if (limit.rlim_max != RLIM_INFINITY &&
+					limit.rlim_cur > limit.rlim_max) {
+				limit.rlim_cur = limit.rlim_max;
+			}
+			if (-1 == setrlimit(RLIMIT_AS, &limit)) {
+				perror("setrlimit");
+			}
 		}
+	}
+	limit_cpu(t);
+}
+
+// In a worker process, let the next call use fork.cpu_limit seconds of CPU
+// time on top of what the process has used so far. Only the soft limit is
+// changed, since the hard limit can't be raised again for the next call.
+static void
+limit_cpu(struct fuzz* t)
+{
+	if (t->fork.cpu_limit == 0) {
+		return;
+	}
+
+	struct rusage usage;
+	struct rlimit limit;
+	if (-1 == getrusage(RUSAGE_SELF, &usage) ||
+			-1 == getrlimit(RLIMIT_CPU, &limit)) {
+		return;
+	}
+
+	// RLIMIT_CPU counts whole seconds, so round up what's been used.
+	const rlim_t used = (rlim_t)(usage.ru_utime.tv_sec +
+					     usage.ru_stime.tv_sec + 1);
+	limit.rlim_cur = used + (rlim_t)t->fork.cpu_limit;
+	if (limit.rlim_max != RLIM_INFINITY &&
+			limit.rlim_cur > limit.rlim_max) {
+		limit.rlim_cur = limit.rlim_max;
+	}
+	if (-1 == setrlimit(RLIMIT_CPU, &limit)) {
+		perror("setrlimit");
+	}
+}
 
-		return trial_res;
+// The size of the process's address space, in bytes, or 0 if it's not
+// known.
+static size_t
+vm_size(void)
+{
+	size_t size = 0;
+#if defined(__linux__)
+	FILE* f = fopen("/proc/self/statm", "r");
+	if (f == NULL) {
+		return 0;
 	}
+	unsigned long pages = 0;
+	if (fscanf(f, "%lu", &pages) == 1) {
+		size = (size_t)pages * (size_t)sysconf(_SC_PAGESIZE);
+	}
+	fclose(f);
+#endif
+	return size;
 }
 
 // Clean up after all child processes that have changed state.
@@ -3728,9 +6908,12 @@ step_waitpid(struct fuzz* t)
 		} else if (res == 0) {
 			break; // no children have changed state
 		} else {
-			if (res == t->workers[0].pid) {
-				t->workers[0].state   = WS_STOPPED;
-				t->workers[0].wstatus = wstatus;
+			for (size_t i = 0; i < t->worker_count; i++) {
+				struct worker_info* worker = &t->workers[i];
+				if (res == worker->pid) {
+					worker->state   = WS_STOPPED;
+					worker->wstatus = wstatus;
+				}
 			}
 		}
 	}
@@ -3738,12 +6921,59 @@ step_waitpid(struct fuzz* t)
 	return true;
 }
 
+// Record the pid of WORKER's newly forked process, and open a pidfd for it
+// if possible.
+static void
+set_worker_pid(struct worker_info* worker, pid_t pid)
+{
+	// The previous process may not have been reaped yet. If so, it's
+	// cleaned up by a later step_waitpid like any other child.
+	close_pidfd(worker);
+	worker->pid   = pid;
+	worker->state = WS_ACTIVE;
+#if FUZZ_POLYFILL_HAVE_PIDFD
+	// This fails with ENOSYS on kernels before 5.3, in which case
+	// wait_for_exit falls back to polling waitpid().
+	const long fd = syscall(SYS_pidfd_open, pid, 0);
+	if (fd == -1) {
+		errno = 0;
+	} else {
+		worker->pidfd = (int)fd;
+	}
+#endif
+}
+
+static void
+close_pidfd(struct worker_info* worker)
+{
+	if (worker->pidfd != -1) {
+		close(worker->pidfd);
+		worker->pidfd = -1;
+	}
+}
+
 // Wait timeout msec. for the worker to exit. If kill_timeout is
 // non-zero, then send SIGKILL and wait that much longer.
 static bool
 wait_for_exit(struct fuzz* t, struct worker_info* worker, size_t timeout,
 		size_t kill_timeout)
 {
+	if (worker->pidfd != -1) {
+		int res = poll_for_exit(t, worker, timeout);
+		if (res == 0 && kill_timeout > 0) {
+			LOG(2 - LOG_CALL, "%s: kill(%d, SIGKILL)\n", __func__,
+					worker->pid);
+			if (-1 == kill(worker->pid, SIGKILL) &&
+					errno != ESRCH) {
+				perror("kill");
+				return false;
+			}
+			errno = 0;
+			res   = poll_for_exit(t, worker, kill_timeout);
+		}
+		return res != -1;
+	}
+
 	for (size_t i = 0; i < timeout + kill_timeout; i++) {
 		if (!step_waitpid(t)) {
 			return false;
@@ -3779,8 +7009,119 @@ wait_for_exit(struct fuzz* t, struct worker_info* worker, size_t timeout,
 	return true;
 }
 
+// Wait up to timeout msec. for WORKER's pidfd to become readable, which
+// happens as soon as its process exits, then reap it. Returns 1 if it has
+// exited, 0 on timeout, or -1 on error.
+static int
+poll_for_exit(struct fuzz* t, struct worker_info* worker, size_t timeout)
+{
+	assert(worker->pidfd != -1);
+	assert(timeout <= INT_MAX);
+	const size_t  deadline = now_msec() + timeout;
+	struct pollfd pfd      = {.fd = worker->pidfd, .events = POLLIN};
+	for (;;) {
+		const size_t now = now_msec();
+		const int    remaining =
+				(int)(deadline > now ? deadline - now : 0);
+		const int res = poll(&pfd, 1, remaining);
+		if (res == -1) {
+			if (errno == EAGAIN || errno == EINTR) {
+				errno = 0;
+				continue;
+			}
+			perror("poll");
+			return -1;
+		} else if (res == 0) {
+			return 0;
+		}
+		break;
+	}
+
+	if (!step_waitpid(t)) {
+		return -1;
+	}
+	return worker->state == WS_STOPPED ? 1 : 0;
+}
+
+// Wait up to timeout msec. for any running worker to exit, then reap all
+// the workers that have. If no worker has a pidfd, just sleep.
+static bool
+wait_for_any_exit(struct fuzz* t, size_t timeout)
+{
+	assert(timeout <= INT_MAX);
+	struct pollfd* pfds = malloc(t->worker_count * sizeof(*pfds));
+	if (pfds == NULL) {
+		return false;
+	}
+
+	nfds_t nfds = 0;
+	for (size_t i = 0; i < t->worker_count; i++) {
+		const struct worker_info* worker = &t->workers[i];
+		if (worker->state == WS_ACTIVE && worker->pidfd != -1) {
+			pfds[nfds++] = (struct pollfd){
+					.fd     = worker->pidfd,
+					.events = POLLIN,
+			};
+		}
+	}
+
+	if (nfds > 0) {
+		if (-1 == poll(pfds, nfds, (int)timeout) && errno != EINTR) {
+			perror("poll");
+			free(pfds);
+			return false;
+		}
+		errno = 0;
+	} else {
+		const struct timespec tv = {
+				.tv_sec  = (time_t)(timeout / 1000),
+				.tv_nsec = (long)(timeout % 1000) * 1000000,
+		};
+		if (-1 == nanosleep(&tv, NULL) && errno != EINTR) {
+			perror("nanosleep");
+			free(pfds);
+			return false;
+		}
+		errno = 0;
+	}
+	free(pfds);
+	return step_waitpid(t);
+}
+
+// Call the property function, and write its measurements to INFO.
 static int
-fuzz_call_inner(struct fuzz* t, void** args)
+fuzz_call_inner(struct fuzz* t, void** args, struct fuzz_call_info* info)
+{
+	memset(info, 0x00, sizeof(*info));
+	t->call_out = info;
+
+	struct timespec start = {0, 0};
+	struct timespec end   = {0, 0};
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	errno         = 0; // so ENOMEM at a crash is from this call
+	const int res = call_property(t, args);
+	clock_gettime(CLOCK_MONOTONIC, &end);
+
+	info->duration_usec = (uint64_t)(end.tv_sec - start.tv_sec) * 1000000 +
+			      (uint64_t)(end.tv_nsec / 1000) -
+			      (uint64_t)(start.tv_nsec / 1000);
+
+	const int     call_errno = errno;
+	struct rusage usage;
+	if (0 == getrusage(RUSAGE_SELF, &usage)) {
+#if defined(__APPLE__)
+		info->max_rss_kb = (size_t)usage.ru_maxrss / 1024; // bytes
+#else
+		info->max_rss_kb = (size_t)usage.ru_maxrss;
+#endif
+	}
+	errno       = call_errno;
+	t->call_out = NULL;
+	return res;
+}
+
+static int
+call_property(struct fuzz* t, void** args)
 {
 	switch (t->prop.arity) {
 	case 1:
@@ -3813,44 +7154,59 @@ fuzz_call_inner(struct fuzz* t, void** args)
 	}
 }
 
-// Populate a buffer with hashes of all the arguments.
-static void
-get_arg_hash_buffer(uint64_t* buffer, struct fuzz* t)
+void
+fuzz_call_hash_args(struct fuzz* t, uint64_t* hashes)
 {
 	for (uint8_t i = 0; i < t->prop.arity; i++) {
 		struct fuzz_type_info* ti = t->prop.type_info[i];
+		uint64_t*              h  = &hashes[2 * i];
 
-		uint64_t h = 0;
 		if (ti->autoshrink_config.enable) {
-			h = fuzz_autoshrink_hash(t, t->trial.args[i].instance,
-					t->trial.args[i].u.as.env, ti->env);
+			fuzz_autoshrink_hash(t, t->trial.args[i].instance,
+					t->trial.args[i].u.as.env, ti->env, h);
+		} else if (ti->hash != NULL) {
+			h[0] = ti->hash(t->trial.args[i].instance, ti->env);
+			h[1] = 0;
 		} else {
-			h = ti->hash(t->trial.args[i].instance, ti->env);
+			h[0] = 0;
+			h[1] = 0;
 		}
 
-		LOG(4, "%s: arg %d hash; 0x%016" PRIx64 "\n", __func__, i, h);
-		buffer[i] = h;
+		LOG(4, "%s: arg %d hash; 0x%016" PRIx64 "%016" PRIx64 "\n",
+				__func__, i, h[1], h[0]);
 	}
 }
 
-// Check if this combination of argument instances has been called.
 bool
-fuzz_call_check_called(struct fuzz* t)
+fuzz_call_check_and_mark_called(struct fuzz* t, const uint64_t* hashes)
 {
-	uint64_t buffer[FUZZ_MAX_ARITY];
-	get_arg_hash_buffer(buffer, t);
-	return fuzz_bloom_check(t->bloom, (uint8_t*)buffer,
-			t->prop.arity * sizeof(uint64_t));
+	return fuzz_bloom_check_and_mark(t->bloom, (uint8_t*)hashes,
+			2 * t->prop.arity * sizeof(uint64_t));
 }
 
-// Mark the tuple of argument instances as called in the bloom filter.
-void
-fuzz_call_mark_called(struct fuzz* t)
+bool
+fuzz_call_forget_called(struct fuzz* t)
 {
-	uint64_t buffer[FUZZ_MAX_ARITY];
-	get_arg_hash_buffer(buffer, t);
-	fuzz_bloom_mark(t->bloom, (uint8_t*)buffer,
-			t->prop.arity * sizeof(uint64_t));
+	struct dedup_info* d = &t->dedup;
+	if (t->bloom == NULL || d->path == NULL) {
+		return true; // not saved, so it can stay
+	}
+
+	const size_t words = 2 * t->prop.arity;
+	if (d->forget_count == d->forget_ceil) {
+		const size_t nceil =
+				(d->forget_ceil == 0 ? 8 : 2 * d->forget_ceil);
+		uint64_t* nforget = realloc(
+				d->forget, nceil * words * sizeof(uint64_t));
+		if (nforget == NULL) {
+			return false;
+		}
+		d->forget      = nforget;
+		d->forget_ceil = nceil;
+	}
+	fuzz_call_hash_args(t, &d->forget[d->forget_count * words]);
+	d->forget_count++;
+	return true;
 }
 
 static int
@@ -3872,6 +7228,7 @@ run_fork_post_hook(struct fuzz* t, void** args)
 }
 // SPDX-License-Identifier: CC0-1.0
 #include <assert.h>
+#include <string.h>
 
 // Fowler/Noll/Vo hash, 64-bit FNV-1a.
 // This hashing algorithm is in the public domain.
@@ -3923,6 +7280,114 @@ fuzz_hash_onepass(const uint8_t* data, size_t bytes)
 	fuzz_hash_sink(&h, data, bytes);
 	return fuzz_hash_finish(&h);
 }
+
+// The 128-bit hash is built on wyhash's mixing step (public domain, by
+// Wang Yi): multiply two words into 128 bits and fold the halves
+// together. Blocks of four words go through two independent lanes, so
+// long buffers aren't held up by the latency of the multiplies.
+static const uint64_t hash128_k[4] = {
+		0xa0761d6478bd642fLLU,
+		0xe7037ed1a0b428dbLLU,
+		0x8ebc6af09c88c6e3LLU,
+		0x589965cc75374cc3LLU,
+};
+
+static uint64_t
+hash128_mix(uint64_t a, uint64_t b)
+{
+#if defined(__SIZEOF_INT128__)
+	const unsigned __int128 m = (unsigned __int128)a * b;
+	return (uint64_t)m ^ (uint64_t)(m >> 64);
+#else
+	const uint64_t a_lo = a & 0xffffffff, a_hi = a >> 32;
+	const uint64_t b_lo = b & 0xffffffff, b_hi = b >> 32;
+	const uint64_t ll = a_lo * b_lo, lh = a_lo * b_hi;
+	const uint64_t hl = a_hi * b_lo, hh = a_hi * b_hi;
+	const uint64_t mid = (ll >> 32) + (lh & 0xffffffff) +
+			     (hl & 0xffffffff);
+	const uint64_t lo  = (mid << 32) | (ll & 0xffffffff);
+	return lo ^ (hh + (lh >> 32) + (hl >> 32) + (mid >> 32));
+#endif
+}
+
+static void
+hash128_block(struct fuzz_hash128* h, const uint64_t* words)
+{
+	h->a = hash128_mix(words[0] ^ hash128_k[1], words[1] ^ h->a);
+	h->b = hash128_mix(words[2] ^ hash128_k[2], words[3] ^ h->b);
+}
+
+void
+fuzz_hash128_init(struct fuzz_hash128* h)
+{
+	*h = (struct fuzz_hash128){
+			.a = hash128_k[0],
+			.b = hash128_k[3],
+	};
+}
+
+void
+fuzz_hash128_sink(struct fuzz_hash128* h, const uint64_t* words, size_t count)
+{
+	h->count += count;
+	size_t i = 0;
+	if (h->buffered > 0) { // top off the partial block first
+		while (h->buffered < 4 && i < count) {
+			h->buf[h->buffered++] = words[i++];
+		}
+		if (h->buffered < 4) {
+			return;
+		}
+		hash128_block(h, h->buf);
+		h->buffered = 0;
+	}
+	for (; i + 4 <= count; i += 4) {
+		hash128_block(h, &words[i]);
+	}
+	while (i < count) {
+		h->buf[h->buffered++] = words[i++];
+	}
+}
+
+void
+fuzz_hash128_finish(struct fuzz_hash128* h, uint64_t res[2])
+{
+	if (h->buffered > 0) {
+		while (h->buffered < 4) {
+			h->buf[h->buffered++] = 0;
+		}
+		hash128_block(h, h->buf);
+	}
+	const uint64_t a = hash128_mix(h->a ^ hash128_k[0], h->count);
+	const uint64_t b = hash128_mix(h->b ^ hash128_k[3], h->count);
+	res[0]           = hash128_mix(a ^ hash128_k[1], b ^ hash128_k[2]);
+	res[1]           = hash128_mix(a ^ hash128_k[2], b ^ hash128_k[1]);
+	fuzz_hash128_init(h); // reset
+}
+
+// Hash a buffer in one pass into 128 bits, a word at a time.
+void
+fuzz_hash128_onepass(const uint8_t* data, size_t bytes, uint64_t res[2])
+{
+	assert(data || bytes == 0);
+	struct fuzz_hash128 h;
+	fuzz_hash128_init(&h);
+	uint64_t buf[32];
+	for (size_t done = 0; done < bytes;) {
+		size_t count = bytes - done;
+		if (count > sizeof(buf)) {
+			count = sizeof(buf);
+		}
+		const size_t words = (count + 7) / 8;
+		buf[words - 1]     = 0; // zero-pad the last word
+		memcpy(buf, &data[done], count);
+		fuzz_hash128_sink(&h, buf, words);
+		done += count;
+	}
+	const uint64_t length = bytes;
+	fuzz_hash128_sink(&h, &length, 1);
+	fuzz_hash128_finish(&h, res);
+}
 // Public domain
 //
 // poll(2) emulation for Windows
@@ -4373,6 +7838,13 @@ sigaction(int signum, const struct sigaction* act, struct sigaction* oldact)
 	return -1;
 }
 
+int
+sigemptyset(int* set)
+{
+	*set = 0;
+	return 0;
+}
+
 int
 setrlimit(int resource, const struct rlimit* rlim)
 {
@@ -4390,6 +7862,37 @@ getrlimit(int resource, struct rlimit* rlim)
 	return -1;
 }
 
+int
+getrusage(int who, struct rusage* usage)
+{
+	(void)who;
+	usage->ru_maxrss = 0;
+	errno            = ENOSYS;
+	return -1;
+}
+
+void*
+mmap(void* addr, size_t length, int prot, int flags, int fd, long offset)
+{
+	(void)addr;
+	(void)length;
+	(void)prot;
+	(void)flags;
+	(void)fd;
+	(void)offset;
+	errno = ENOSYS;
+	return MAP_FAILED;
+}
+
+int
+munmap(void* addr, size_t length)
+{
+	(void)addr;
+	(void)length;
+	errno = ENOSYS;
+	return -1;
+}
+
 int
 gettimeofday(struct timeval* tp, struct timezone* tzp)
 {
@@ -4410,6 +7913,17 @@ gettimeofday(struct timeval* tp, struct timezone* tzp)
 	return 0;
 }
 
+int
+clock_gettime(int clk_id, struct timespec* tp)
+{
+	assert(clk_id == CLOCK_MONOTONIC);
+	(void)clk_id;
+	const ULONGLONG ms = GetTickCount64();
+	tp->tv_sec         = (time_t)(ms / 1000);
+	tp->tv_nsec        = (long)(ms % 1000) * 1000000;
+	return 0;
+}
+
 // Public domain
 //
 // poll(2) emulation for Windows from LibreSSL
@@ -4755,6 +8269,23 @@ fuzz_random_stop_using_bit_pool(struct fuzz* t)
 	t->prng.bit_pool = NULL;
 }
 
+void
+fuzz_random_save(struct fuzz* t, struct prng_info* saved)
+{
+	fuzz_rng_copy(saved->rng, t->prng.rng);
+	saved->buf            = t->prng.buf;
+	saved->bits_available = t->prng.bits_available;
+}
+
+void
+fuzz_random_restore(struct fuzz* t, const struct prng_info* saved)
+{
+	fuzz_random_stop_using_bit_pool(t);
+	fuzz_rng_copy(t->prng.rng, saved->rng);
+	t->prng.buf            = saved->buf;
+	t->prng.bits_available = saved->bits_available;
+}
+
 // Get BITS random bits from the test runner's PRNG.
 // Bits can be retrieved at most 64 at a time.
 uint64_t
@@ -4766,6 +8297,16 @@ fuzz_random_bits(struct fuzz* t, uint8_t bit_count)
 			"%016" PRIx64 "\n",
 			t->prng.bits_available, bit_count, t->prng.buf);
 
+	// Most requests are small enough to come straight out of the bits
+	// left in the buffer.
+	if (t->prng.bit_pool == NULL && bit_count < 64 &&
+			bit_count <= t->prng.bits_available) {
+		const uint64_t res = t->prng.buf & get_random_mask(bit_count);
+		t->prng.buf >>= bit_count;
+		t->prng.bits_available -= bit_count;
+		return res;
+	}
+
 	uint64_t res = 0;
 	fuzz_random_bits_bulk(t, bit_count, &res);
 	return res;
@@ -4782,9 +8323,29 @@ fuzz_random_bits_bulk(struct fuzz* t, uint32_t bit_count, uint64_t* buf)
 		return;
 	}
 
-	uint32_t rem    = bit_count;
+	// Whole words can be copied straight from the PRNG, combined with any
+	// bits left over in prng.buf from an earlier request.
+	const size_t  words = bit_count / 64;
+	const uint8_t avail = t->prng.bits_available;
+	if (words > 0) {
+		fuzz_rng_fill(t->prng.rng, buf, words);
+	}
+	if (words > 0 && avail > 0) {
+		uint64_t carry = t->prng.buf;
+		for (size_t i = 0; i < words; i++) {
+			const uint64_t w = buf[i];
+			buf[i]           = carry | (w << avail);
+			carry            = w >> (64 - avail);
+		}
+		t->prng.buf = carry;
+	}
+
+	uint32_t rem    = bit_count % 64;
 	uint8_t  shift  = 0;
-	size_t   offset = 0;
+	size_t   offset = words;
+	if (rem > 0) {
+		buf[offset] = 0;
+	}
 
 	while (rem > 0) {
 		if (t->prng.bits_available == 0) {
@@ -4838,15 +8399,40 @@ fuzz_random_double(struct fuzz* t)
 	return res;
 }
 
-uint64_t
-fuzz_random_choice(struct fuzz* t, uint64_t ceil)
+#endif
+
+// How many times fuzz_random_choice redraws a biased sample before using
+// it anyway. A redraw is needed less than once in 256 calls, and an
+// autoshrink bit pool that has run out (and yields zeroes forever) is
+// never redrawn from.
+#define RANDOM_CHOICE_MAX_REDRAWS 4
+
+// Multiply A and B, returning the high 64 bits of the product and setting
+// *LOW to the low 64 bits.
+static uint64_t
+mul_64x64_128(uint64_t a, uint64_t b, uint64_t* low)
 {
-	if (ceil < 2) {
-		return 0;
-	}
-	uint64_t bits;
-	double   limit;
+#if defined(__SIZEOF_INT128__)
+	const unsigned __int128 m = (unsigned __int128)a * b;
+	*low                      = (uint64_t)m;
+	return (uint64_t)(m >> 64);
+#else
+	const uint64_t a_lo = a & 0xffffffff, a_hi = a >> 32;
+	const uint64_t b_lo = b & 0xffffffff, b_hi = b >> 32;
+	const uint64_t ll = a_lo * b_lo, lh = a_lo * b_hi;
+	const uint64_t hl = a_hi * b_lo, hh = a_hi * b_hi;
+	const uint64_t mid = (ll >> 32) + (lh & 0xffffffff) + (hl & 0xffffffff);
+	*low               = (mid << 32) | (ll & 0xffffffff);
+	return hh + (lh >> 32) + (hl >> 32) + (mid >> 32);
+#endif
+}
 
+// How many random bits fuzz_random_choice samples for CEIL. If CEIL is a
+// power of two, that many bits are the result; otherwise, the sample is
+// scaled by scale_sample.
+static uint8_t
+choice_sample_bits(uint64_t ceil, bool* exact)
+{
 	// If ceil is a power of two, just return that many bits.
 	if ((ceil & (ceil - 1)) == 0) {
 		uint8_t log2_ceil = 1;
@@ -4854,35 +8440,151 @@ fuzz_random_choice(struct fuzz* t, uint64_t ceil)
 			log2_ceil++;
 		}
 		assert((1LLU << log2_ceil) == ceil);
-		return fuzz_random_bits(t, log2_ceil);
+		*exact = true;
+		return log2_ceil;
 	}
 
 	// If the choice values are fairly small (which shoud be
 	// the common case), sample less than 64 bits to reduce
 	// time spent managing the random bitstream.
+	*exact = false;
 	if (ceil < UINT8_MAX) {
-		bits  = fuzz_random_bits(t, 16);
-		limit = (double)(1LLU << 16);
+		return 16;
 	} else if (ceil < UINT16_MAX) {
-		bits  = fuzz_random_bits(t, 32);
-		limit = (double)(1LLU << 32);
+		return 32;
 	} else {
-		bits  = fuzz_random_bits(t, 64);
-		limit = (double)UINT64_MAX;
+		return 64;
+	}
+}
+
+// Scale a sample of BITS random bits to [0, CEIL), setting *LOW to the
+// fractional part, which tells whether the sample was biased.
+static uint64_t
+scale_sample(uint64_t sample, uint64_t ceil, uint8_t bits, uint64_t* low)
+{
+	if (bits == 64) {
+		return mul_64x64_128(sample, ceil, low);
+	}
+	// ceil < 2^(bits / 2), so this can't overflow.
+	const uint64_t m = sample * ceil;
+	*low             = m & ((1LLU << bits) - 1);
+	return m >> bits;
+}
+
+// Get a random uint64_t less than CEIL, with Lemire's nearly divisionless
+// method: scale a sample of BITS random bits by CEIL, keep the integer
+// part, and redraw in the rare case that the sample lands on one of the few
+// values that would make some results more likely than others. The result
+// only grows with the sample, so smaller bits still shrink towards 0.
+uint64_t
+fuzz_random_choice(struct fuzz* t, uint64_t ceil)
+{
+	if (ceil < 2) {
+		return 0;
+	}
+
+	bool          exact = false;
+	const uint8_t bits  = choice_sample_bits(ceil, &exact);
+	if (exact) {
+		return fuzz_random_bits(t, bits);
 	}
 
-	double   mul = (double)bits / limit;
-	uint64_t res = (uint64_t)(mul * ceil);
+	uint64_t res       = 0;
+	uint64_t low       = 0;
+	uint64_t threshold = 0;
+	for (uint8_t redraws = 0;; redraws++) {
+		res = scale_sample(fuzz_random_bits(t, bits), ceil, bits, &low);
+		if (low >= ceil || redraws == RANDOM_CHOICE_MAX_REDRAWS) {
+			break;
+		}
+		if (t->prng.bit_pool != NULL &&
+				fuzz_autoshrink_bit_pool_exhausted(
+						t->prng.bit_pool)) {
+			break; // redrawing would only get 0 again
+		}
+		if (threshold == 0) {
+			// 2^bits % ceil, without computing 2^64.
+			threshold = (bits == 64 ? -ceil : (1LLU << bits) - ceil) %
+				    ceil;
+		}
+		if (low >= threshold) {
+			break;
+		}
+	}
 	return res;
 }
 
+// Get a random uint64_t in the range [min, max].
 uint64_t
 fuzz_random_range(struct fuzz* f, const uint64_t min, const uint64_t max)
 {
 	assert(min < max);
+	if (min == 0 && max == UINT64_MAX) {
+		return fuzz_random_bits(f, 64);
+	}
 	return fuzz_random_choice(f, max - min + 1) + min;
 }
-#endif
+
+// How many values fuzz_random_range_bulk_* generate per request for
+// random bits. The buffer for them is on the stack.
+#define RANDOM_RANGE_BULK_CHUNK 1024
+
+// Fill OUT with COUNT (at most RANDOM_RANGE_BULK_CHUNK) values in
+// [min, max], from a single request for random bits. The values are drawn
+// into OUT as packed samples first and then unpacked in place, from the
+// last to the first, since unpacking a sample never overwrites the bits
+// of any sample before it.
+static void
+random_range_chunk(struct fuzz* t, uint64_t min, uint64_t max, size_t count,
+		uint64_t* out)
+{
+	const uint64_t ceil  = max - min + 1;
+	bool           exact = (ceil == 0);
+	const uint8_t  bits  = (exact ? 64 : choice_sample_bits(ceil, &exact));
+	const uint64_t mask  = get_random_mask(bits);
+
+	fuzz_random_bits_bulk(t, (uint32_t)(count * bits), out);
+
+	for (size_t i = count; i > 0; i--) {
+		const size_t  offset = (i - 1) * bits;
+		const size_t  word   = offset / 64;
+		const uint8_t shift  = offset % 64;
+		uint64_t      sample = out[word] >> shift;
+		if (shift + bits > 64) {
+			sample |= out[word + 1] << (64 - shift);
+		}
+		sample &= mask;
+
+		uint64_t low = 0;
+		out[i - 1]   = min + (exact ? sample
+					    : scale_sample(sample, ceil, bits,
+							      &low));
+	}
+}
+
+#define RANDOM_RANGE_BULK(NAME, TYPE)                                         \
+	void fuzz_random_range_bulk_##NAME(struct fuzz* t, TYPE min,          \
+			TYPE max, size_t count, TYPE* out)                    \
+	{                                                                     \
+		assert(min < max);                                            \
+		uint64_t values[RANDOM_RANGE_BULK_CHUNK];                     \
+		for (size_t i = 0; i < count;                                 \
+				i += RANDOM_RANGE_BULK_CHUNK) {               \
+			size_t n = count - i;                                 \
+			if (n > RANDOM_RANGE_BULK_CHUNK) {                    \
+				n = RANDOM_RANGE_BULK_CHUNK;                  \
+			}                                                     \
+			random_range_chunk(t, min, max, n, values);           \
+			for (size_t j = 0; j < n; j++) {                      \
+				out[i + j] = (TYPE)values[j];                 \
+			}                                                     \
+		}                                                             \
+	}
+
+RANDOM_RANGE_BULK(u8, uint8_t)
+RANDOM_RANGE_BULK(u16, uint16_t)
+RANDOM_RANGE_BULK(u32, uint32_t)
+RANDOM_RANGE_BULK(u64, uint64_t)
 // SPDX-License-Identifier: BSD-3-Clause
 // SPDX-FileCopyrightText: 2004 Makoto Matsumoto and Takuji Nishimura
 
@@ -4914,16 +8616,29 @@ fuzz_random_range(struct fuzz* f, const uint64_t min, const uint64_t max)
 // multiple instances running in the same address space.
 //
 // Also, the functions in the module's public interface have
-// been prefixed with "fuzz_rng_".
+// been prefixed with "fuzz_rng_", and they dispatch to either MT19937-64
+// or xoshiro256**, below.
+
+// SPDX-License-Identifier: CC0-1.0
+// SPDX-FileCopyrightText: 2018 David Blackman and Sebastiano Vigna
+
+// xoshiro256** 1.0, from https://prng.di.unimi.it/xoshiro256starstar.c.
+// Its state is seeded from SplitMix64, as the authors suggest.
 
+#include <assert.h>
+#include <stddef.h>
 #include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 
 #define FUZZ_MT_PARAM_N 312
 struct fuzz_rng {
-	uint64_t mt[FUZZ_MT_PARAM_N]; // the array for the state vector
-	int16_t  mti;
+	enum fuzz_rng_kind kind;
+	int16_t            mti;
+	uint64_t           s[4]; // xoshiro256** state
+	// MT19937-64 state vector, only allocated for FUZZ_RNG_MT19937.
+	uint64_t mt[];
 };
 
 #define NN       FUZZ_MT_PARAM_N
@@ -4932,46 +8647,87 @@ struct fuzz_rng {
 #define UM       0xFFFFFFFF80000000ULL // Most significant 33 bits
 #define LM       0x7FFFFFFFULL         // Least significant 31 bits
 
+static void     mt_reset(struct fuzz_rng* mt, uint64_t seed);
 static uint64_t genrand64_int64(struct fuzz_rng* r);
+static void     xoshiro_reset(struct fuzz_rng* r, uint64_t seed);
+static uint64_t xoshiro_next(struct fuzz_rng* r);
+static void     xoshiro_fill(struct fuzz_rng* r, uint64_t* dst, size_t count);
 
-// Heap-allocate a mersenne twister struct.
+// Heap-allocate a PRNG of the given kind.
 struct fuzz_rng*
-fuzz_rng_init(uint64_t seed)
+fuzz_rng_init(enum fuzz_rng_kind kind, uint64_t seed)
 {
-	struct fuzz_rng* mt = malloc(sizeof(struct fuzz_rng));
-	if (mt == NULL) {
+	size_t size = offsetof(struct fuzz_rng, mt);
+	switch (kind) {
+	case FUZZ_RNG_XOSHIRO256:
+		break;
+	case FUZZ_RNG_MT19937:
+		size += NN * sizeof(uint64_t);
+		break;
+	default:
+		return NULL;
+	}
+
+	struct fuzz_rng* r = malloc(size);
+	if (r == NULL) {
 		return NULL;
 	}
-	fuzz_rng_reset(mt, seed);
-	return mt;
+	r->kind = kind;
+	fuzz_rng_reset(r, seed);
+	return r;
 }
 
-// Free a heap-allocated mersenne twister struct.
+// Free a heap-allocated PRNG.
 void
-fuzz_rng_free(struct fuzz_rng* mt)
+fuzz_rng_free(struct fuzz_rng* r)
 {
-	free(mt);
+	free(r);
 }
 
-// initializes mt[NN] with a seed
+// Reset a PRNG to the start of SEED's stream.
 void
-fuzz_rng_reset(struct fuzz_rng* mt, uint64_t seed)
+fuzz_rng_reset(struct fuzz_rng* r, uint64_t seed)
 {
-	mt->mt[0]    = seed;
-	uint16_t mti = 0;
-	for (mti = 1; mti < NN; mti++) {
-		uint64_t tmp = (mt->mt[mti - 1] ^ (mt->mt[mti - 1] >> 62));
-		mt->mt[mti]  = 6364136223846793005ULL * tmp + mti;
+	if (r->kind == FUZZ_RNG_MT19937) {
+		mt_reset(r, seed);
+	} else {
+		xoshiro_reset(r, seed);
 	}
+}
 
-	mt->mti = mti;
+// Copy SRC's place in its stream into DST, which must be the same kind.
+void
+fuzz_rng_copy(struct fuzz_rng* dst, const struct fuzz_rng* src)
+{
+	assert(dst->kind == src->kind);
+	size_t size = offsetof(struct fuzz_rng, mt);
+	if (src->kind == FUZZ_RNG_MT19937) {
+		size += NN * sizeof(uint64_t);
+	}
+	memcpy(dst, src, size);
 }
 
 // Get a 64-bit random number.
 uint64_t
-fuzz_rng_random(struct fuzz_rng* mt)
+fuzz_rng_random(struct fuzz_rng* r)
+{
+	if (r->kind == FUZZ_RNG_MT19937) {
+		return genrand64_int64(r);
+	}
+	return xoshiro_next(r);
+}
+
+// Fill DST with the next COUNT 64-bit random numbers.
+void
+fuzz_rng_fill(struct fuzz_rng* r, uint64_t* dst, size_t count)
 {
-	return genrand64_int64(mt);
+	if (r->kind == FUZZ_RNG_MT19937) {
+		for (size_t i = 0; i < count; i++) {
+			dst[i] = genrand64_int64(r);
+		}
+	} else {
+		xoshiro_fill(r, dst, count);
+	}
 }
 
 // Generate a random number on [0,1]-real-interval.
@@ -4981,6 +8737,80 @@ fuzz_rng_uint64_to_double(uint64_t x)
 	return (x >> 11) * (1.0 / 9007199254740991.0);
 }
 
+static uint64_t
+rotl(const uint64_t x, int k)
+{
+	return (x << k) | (x >> (64 - k));
+}
+
+// Fill the state with the first four outputs of SplitMix64, which are
+// never all zero.
+static void
+xoshiro_reset(struct fuzz_rng* r, uint64_t seed)
+{
+	for (size_t i = 0; i < 4; i++) {
+		uint64_t z = (seed += 0x9e3779b97f4a7c15LLU);
+		z          = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9LLU;
+		z          = (z ^ (z >> 27)) * 0x94d049bb133111ebLLU;
+		r->s[i]    = z ^ (z >> 31);
+	}
+}
+
+static uint64_t
+xoshiro_next(struct fuzz_rng* r)
+{
+	uint64_t*      s      = r->s;
+	const uint64_t result = rotl(s[1] * 5, 7) * 9;
+	const uint64_t t      = s[1] << 17;
+
+	s[2] ^= s[0];
+	s[3] ^= s[1];
+	s[1] ^= s[2];
+	s[0] ^= s[3];
+
+	s[2] ^= t;
+
+	s[3] = rotl(s[3], 45);
+
+	return result;
+}
+
+// Same as calling xoshiro_next COUNT times, but with the state kept in
+// locals rather than reloaded through R for every word.
+static void
+xoshiro_fill(struct fuzz_rng* r, uint64_t* dst, size_t count)
+{
+	uint64_t s0 = r->s[0], s1 = r->s[1], s2 = r->s[2], s3 = r->s[3];
+	for (size_t i = 0; i < count; i++) {
+		dst[i]           = rotl(s1 * 5, 7) * 9;
+		const uint64_t t = s1 << 17;
+		s2 ^= s0;
+		s3 ^= s1;
+		s1 ^= s2;
+		s0 ^= s3;
+		s2 ^= t;
+		s3 = rotl(s3, 45);
+	}
+	r->s[0] = s0;
+	r->s[1] = s1;
+	r->s[2] = s2;
+	r->s[3] = s3;
+}
+
+// initializes mt[NN] with a seed
+static void
+mt_reset(struct fuzz_rng* mt, uint64_t seed)
+{
+	mt->mt[0]    = seed;
+	uint16_t mti = 0;
+	for (mti = 1; mti < NN; mti++) {
+		uint64_t tmp = (mt->mt[mti - 1] ^ (mt->mt[mti - 1] >> 62));
+		mt->mt[mti]  = 6364136223846793005ULL * tmp + mti;
+	}
+
+	mt->mti = mti;
+}
+
 // generates a random number on [0, 2^64-1]-interval
 static uint64_t
 genrand64_int64(struct fuzz_rng* r)
@@ -4994,7 +8824,7 @@ genrand64_int64(struct fuzz_rng* r)
 		// if init has not been called,
 		// a default initial seed is used
 		if (r->mti == NN + 1)
-			fuzz_rng_reset(r, 5489ULL);
+			mt_reset(r, 5489ULL);
 
 		for (i = 0; i < NN - MM; i++) {
 			x        = (r->mt[i] & UM) | (r->mt[i + 1] & LM);
@@ -5049,6 +8879,14 @@ int fuzz_run_trials(struct fuzz* t);
 
 void fuzz_run_free(struct fuzz* t);
 
+// On a thread's handle, take the lock for calling hooks and updating the
+// run's counters and report, and pick up the run's current counters. On
+// any other handle, do nothing.
+void fuzz_run_lock(struct fuzz* t);
+
+// Save a thread's updated counters back to the run, and release the lock.
+void fuzz_run_unlock(struct fuzz* t);
+
 #endif
 
 // SPDX-License-Identifier: ISC
@@ -5062,6 +8900,11 @@ struct fuzz;
 
 bool fuzz_trial_run(struct fuzz* t, int* post_trial_res);
 
+// Update counters, shrink, and call hooks for a trial whose property call
+// returned TRES. On a thread's handle, this takes the run's lock itself,
+// and shrinks without holding it.
+bool fuzz_trial_handle_result(struct fuzz* t, int tres, int* post_trial_res);
+
 void fuzz_trial_get_args(struct fuzz* t, void** args);
 
 void fuzz_trial_free_args(struct fuzz* t);
@@ -5085,6 +8928,11 @@ static bool copy_propfun_for_arity(
 static bool check_all_args(uint8_t arity, const struct fuzz_run_config* cfg,
 		bool* all_hashable);
 
+static void dedup_key(uint8_t arity, const struct fuzz_run_config* cfg,
+		uint64_t key[2]);
+
+static bool add_forgotten(struct fuzz* t, const struct dedup_info* from);
+
 enum all_gen_res {
 	ALL_GEN_OK,    // all arguments generated okay
 	ALL_GEN_SKIP,  // skip due to user constraints
@@ -5096,6 +8944,61 @@ static bool init_arg_info(struct fuzz* t, struct trial_info* trial_info);
 
 static enum all_gen_res gen_all_args(struct fuzz* t);
 
+static enum run_step_res gen_step(struct fuzz* t, size_t trial,
+		uint64_t* seed, enum all_gen_res* gres,
+		struct prng_info* saved);
+
+static uint64_t next_chained_seed(struct fuzz* t);
+
+static void forget_trial_args(struct fuzz* t);
+
+static enum run_step_res pre_trial_step(struct fuzz* t);
+
+static enum run_step_res report_gen_result(
+		struct fuzz* t, enum all_gen_res gres);
+
+// A trial whose arguments have been generated, and whose call may still
+// be running on a worker, waiting to be retired in trial order.
+struct pending_trial {
+	struct trial_info   info;
+	enum all_gen_res    gres;
+	struct worker_info* worker; // NULL unless gres is ALL_GEN_OK
+	// With the chained schedule, the seed the trials after this one were
+	// started with, which assumes nothing else is drawn from its stream.
+	uint64_t next_seed;
+};
+
+static enum run_step_res run_trials_pool(struct fuzz* t, size_t limit);
+
+static enum run_step_res start_pending_trial(struct fuzz* t, size_t trial,
+		uint64_t* seed, struct pending_trial* p,
+		struct prng_info* saved);
+
+static enum run_step_res retire_pending_trial(struct fuzz* t,
+		struct pending_trial* p, struct prng_info* saved,
+		uint64_t* seed);
+
+static void drop_pending_trials(struct fuzz* t,
+		struct pending_trial* pending, size_t width, size_t from,
+		size_t to);
+
+static enum run_step_res run_trials_threads(struct fuzz* t, size_t limit);
+
+#if FUZZ_POLYFILL_HAVE_THREADS
+static void* run_thread(void* arg);
+
+static enum run_step_res retire_thread_trial(struct fuzz* t,
+		enum run_step_res res, enum all_gen_res gres, int tres);
+
+static void drop_thread_trials(struct thread_info* info, size_t index);
+#endif
+
+static size_t shard_trial_count(const struct fuzz* t);
+
+static size_t shard_trial_id(const struct fuzz* t, size_t i);
+
+static bool fill_report(struct fuzz* t);
+
 static void free_print_trial_result_env(struct fuzz* t);
 
 #define LOG_RUN 0
@@ -5110,8 +9013,14 @@ fuzz_run_init(const struct fuzz_run_config* cfg, struct fuzz** output)
 	}
 	memset(t, 0, sizeof(*t));
 
-	t->out      = stdout;
-	t->prng.rng = fuzz_rng_init(DEFAULT_uint64_t);
+	t->out       = stdout;
+	t->prng.kind = GET_DEF(cfg->rng, FUZZ_DEF_RNG);
+	if (t->prng.kind != FUZZ_RNG_XOSHIRO256 &&
+			t->prng.kind != FUZZ_RNG_MT19937) {
+		free(t);
+		return FUZZ_RUN_INIT_ERROR_BAD_ARGS;
+	}
+	t->prng.rng = fuzz_rng_init(t->prng.kind, DEFAULT_uint64_t);
 	if (t->prng.rng == NULL) {
 		free(t);
 		return FUZZ_RUN_INIT_ERROR_MEMORY;
@@ -5129,8 +9038,22 @@ fuzz_run_init(const struct fuzz_run_config* cfg, struct fuzz** output)
 		goto cleanup;
 	}
 
+	if (cfg->seed_schedule != FUZZ_SEED_SCHEDULE_CHAINED &&
+			cfg->seed_schedule != FUZZ_SEED_SCHEDULE_COUNTER) {
+		res = FUZZ_RUN_INIT_ERROR_BAD_ARGS;
+		goto cleanup;
+	}
+
+	if (cfg->shard_count > 1 && cfg->shard_index >= cfg->shard_count) {
+		res = FUZZ_RUN_INIT_ERROR_BAD_ARGS;
+		goto cleanup;
+	}
+
 	struct seed_info seeds = {
 			.run_seed = cfg->seed ? cfg->seed : DEFAULT_uint64_t,
+			.schedule = (cfg->shard_count > 1
+							     ? FUZZ_SEED_SCHEDULE_COUNTER
+							     : cfg->seed_schedule),
 			.always_seed_count = (cfg->always_seeds == NULL
 							      ? 0
 							      : cfg->always_seed_count),
@@ -5138,14 +9061,68 @@ fuzz_run_init(const struct fuzz_run_config* cfg, struct fuzz** output)
 	};
 	memcpy(&t->seeds, &seeds, sizeof(seeds));
 
+	struct shard_info shard = {
+			.index = (cfg->shard_count > 1 ? cfg->shard_index : 0),
+			.count = GET_DEF(cfg->shard_count, 1),
+	};
+	memcpy(&t->shard, &shard, sizeof(shard));
+
 	struct fork_info fork = {
 			.enable  = cfg->fork.enable && FUZZ_POLYFILL_HAVE_FORK,
 			.timeout = cfg->fork.timeout,
-			.signal  = cfg->fork.signal,
+			.adaptive_timeout = cfg->fork.adaptive_timeout,
+			.signal           = cfg->fork.signal,
 			.exit_timeout = cfg->fork.exit_timeout,
+			.workers      = cfg->fork.workers,
+			.persistent   = cfg->fork.persistent,
+			.persistent_calls =
+					GET_DEF(cfg->fork.persistent_calls,
+							FUZZ_DEF_PERSISTENT_CALLS),
+			.memory_limit = cfg->fork.memory_limit,
+			.cpu_limit    = cfg->fork.cpu_limit,
+			.shrink_workers = (cfg->fork.enable &&
+								   cfg->fork.shrink_workers > 1
+							   ? cfg->fork.shrink_workers
+							   : 0),
 	};
 	memcpy(&t->fork, &fork, sizeof(fork));
 
+	t->worker_count = 1;
+	if (t->fork.enable && t->fork.workers > 1) {
+		t->worker_count += t->fork.workers;
+	}
+	t->worker_count += t->fork.shrink_workers;
+	t->workers = calloc(t->worker_count, sizeof(*t->workers));
+	if (t->workers == NULL) {
+		res = FUZZ_RUN_INIT_ERROR_MEMORY;
+		goto cleanup;
+	}
+	for (size_t i = 0; i < t->worker_count; i++) {
+		t->workers[i].pidfd = -1;
+	}
+	if (t->fork.enable && !fuzz_call_init_workers(t)) {
+		res = FUZZ_RUN_INIT_ERROR_MEMORY;
+		goto cleanup;
+	}
+
+	t->thread_count = (t->fork.enable || !FUZZ_POLYFILL_HAVE_THREADS
+					  ? 1
+					  : GET_DEF(cfg->threads, 1));
+
+	t->autoshrink_weights = cfg->autoshrink_weights;
+	if (t->autoshrink_weights == NULL) {
+		t->autoshrink_weights = &t->default_autoshrink_weights;
+	}
+
+	if (cfg->report != NULL) {
+		t->report   = cfg->report;
+		t->failures = calloc(1, sizeof(*t->failures));
+		if (t->failures == NULL) {
+			res = FUZZ_RUN_INIT_ERROR_MEMORY;
+			goto cleanup;
+		}
+	}
+
 	struct prop_info prop = {
 			.name        = cfg->name,
 			.arity       = arity,
@@ -5190,8 +9167,24 @@ fuzz_run_init(const struct fuzz_run_config* cfg, struct fuzz** output)
 
 	// If all arguments are hashable, then attempt to use
 	// a bloom filter to avoid redundant checking.
+	t->dedup.stats = cfg->dedup_stats;
 	if (all_hashable) {
-		t->bloom = fuzz_bloom_init(NULL);
+		// With several threads, it's shared between them, and
+		// checked and marked without locking. Worker processes
+		// only run the property, so they don't need it.
+		const struct fuzz_bloom_config bloom_config = {
+				.expected  = shard_trial_count(t),
+				.max_bytes = cfg->dedup_max_bytes,
+				.shared    = t->thread_count > 1,
+		};
+		t->dedup.path = cfg->dedup_path;
+		if (t->dedup.path != NULL) {
+			dedup_key(arity, cfg, t->dedup.key);
+			t->bloom = fuzz_bloom_load(&bloom_config,
+					t->dedup.path, t->dedup.key);
+		} else {
+			t->bloom = fuzz_bloom_init(&bloom_config);
+		}
 	}
 
 	// If using the default trial_post callback, allocate its
@@ -5200,7 +9193,8 @@ fuzz_run_init(const struct fuzz_run_config* cfg, struct fuzz** output)
 		t->print_trial_result_env =
 				calloc(1, sizeof(*t->print_trial_result_env));
 		if (t->print_trial_result_env == NULL) {
-			return FUZZ_RUN_INIT_ERROR_MEMORY;
+			res = FUZZ_RUN_INIT_ERROR_MEMORY;
+			goto cleanup;
 		}
 		t->print_trial_result_env->tag =
 				FUZZ_PRINT_TRIAL_RESULT_ENV_TAG;
@@ -5211,6 +9205,14 @@ fuzz_run_init(const struct fuzz_run_config* cfg, struct fuzz** output)
 
 cleanup:
 	fuzz_rng_free(t->prng.rng);
+	if (t->workers != NULL) {
+		fuzz_call_stop_workers(t);
+	}
+	free(t->workers);
+	free(t->failures);
+	if (t->bloom != NULL) {
+		fuzz_bloom_free(t->bloom);
+	}
 	free(t);
 	return res;
 }
@@ -5218,16 +9220,45 @@ cleanup:
 void
 fuzz_run_free(struct fuzz* t)
 {
+	if (t->dedup.stats != NULL) {
+		if (t->bloom) {
+			fuzz_bloom_stats(t->bloom, t->dedup.stats);
+		} else {
+			memset(t->dedup.stats, 0x00, sizeof(*t->dedup.stats));
+		}
+	}
 	if (t->bloom) {
+		const struct dedup_info* d     = &t->dedup;
+		const size_t             words = 2 * t->prop.arity;
+		for (size_t i = 0; d->save && i < d->forget_count; i++) {
+			fuzz_bloom_forget(t->bloom,
+					(uint8_t*)&d->forget[i * words],
+					words * sizeof(uint64_t));
+		}
+		if (d->save && !fuzz_bloom_save(t->bloom, d->path, d->key)) {
+			fprintf(stderr, "Warning: couldn't save bloom filter "
+					"to '%s'\n",
+					d->path);
+		}
 		fuzz_bloom_free(t->bloom);
 		t->bloom = NULL;
 	}
+	free(t->dedup.forget);
 	fuzz_rng_free(t->prng.rng);
+	if (t->workers != NULL) {
+		fuzz_call_stop_workers(t);
+	}
+	free(t->workers);
+	if (t->failures != NULL) {
+		free(t->failures->failures);
+		free(t->failures);
+	}
 
 	if (t->print_trial_result_env != NULL) {
 		free(t->print_trial_result_env);
 	}
 
+	fuzz_autoshrink_free_spare_pools(t);
 	free(t);
 }
 
@@ -5247,11 +9278,32 @@ fuzz_run_trials(struct fuzz* t)
 		}
 	}
 
-	size_t   limit = t->prop.trial_count;
+	size_t   limit = shard_trial_count(t);
 	uint64_t seed  = t->seeds.run_seed;
 
+	if (t->fork.enable && t->fork.workers > 1) {
+		switch (run_trials_pool(t, limit)) {
+		case RUN_STEP_OK:
+		case RUN_STEP_HALT:
+			limit = 0;
+			break;
+		default:
+			goto cleanup;
+		}
+	} else if (t->thread_count > 1) {
+		switch (run_trials_threads(t, limit)) {
+		case RUN_STEP_OK:
+		case RUN_STEP_HALT:
+			limit = 0;
+			break;
+		default:
+			goto cleanup;
+		}
+	}
+
 	for (size_t trial = 0; trial < limit; trial++) {
-		enum run_step_res res = run_step(t, trial, &seed);
+		enum run_step_res res =
+				run_step(t, shard_trial_id(t, trial), &seed);
 		memset(&t->trial, 0x00, sizeof(t->trial));
 
 		LOG(3 - LOG_RUN,
@@ -5272,6 +9324,10 @@ fuzz_run_trials(struct fuzz* t)
 		}
 	}
 
+	if (t->report != NULL && !fill_report(t)) {
+		goto cleanup;
+	}
+
 	fuzz_post_run_hook_cb* post_run = t->hooks.post_run;
 	if (post_run != NULL) {
 		struct fuzz_post_run_info hook_info = {
@@ -5284,6 +9340,10 @@ fuzz_run_trials(struct fuzz* t)
 								.fail = t->counters.fail,
 								.skip = t->counters.skip,
 								.dup = t->counters.dup,
+								.timeout = t->counters
+												   .timeout,
+								.oom = t->counters.oom,
+								.crash = t->counters.crash,
 						},
 		};
 
@@ -5295,6 +9355,8 @@ fuzz_run_trials(struct fuzz* t)
 
 	free_print_trial_result_env(t);
 
+	t->dedup.save = (t->dedup.path != NULL);
+
 	if (t->counters.fail > 0) {
 		return FUZZ_RESULT_FAIL;
 	} else if (t->counters.pass > 0) {
@@ -5310,12 +9372,60 @@ cleanup:
 
 static enum run_step_res
 run_step(struct fuzz* t, size_t trial, uint64_t* seed)
+{
+	enum all_gen_res  gres = ALL_GEN_ERROR;
+	enum run_step_res res  = gen_step(t, trial, seed, &gres, NULL);
+	// anything after this point needs to free all args
+	if (res != RUN_STEP_OK) {
+		goto cleanup;
+	}
+
+	if (gres != ALL_GEN_OK) {
+		res = report_gen_result(t, gres);
+	} else {
+		int pres;
+		res = pre_trial_step(t);
+		if (res == RUN_STEP_OK && !fuzz_trial_run(t, &pres)) {
+			res = RUN_STEP_TRIAL_ERROR;
+		} else if (res == RUN_STEP_OK && pres == FUZZ_HOOK_RUN_ERROR) {
+			res = RUN_STEP_TRIAL_ERROR;
+		}
+	}
+
+	// Update seed for next trial
+	if (res == RUN_STEP_OK &&
+			t->seeds.schedule == FUZZ_SEED_SCHEDULE_CHAINED) {
+		*seed = next_chained_seed(t);
+	}
+
+cleanup:
+	fuzz_trial_free_args(t);
+	return res;
+}
+
+// Choose the seed for TRIAL, call the pre-argument generation hook, and
+// generate its arguments into t->trial. The result of generation is
+// stored in GRES.
+//
+// With the chained schedule, the next trial's seed is drawn from this
+// trial's stream once it has finished, after anything its call and
+// shrinking drew, as it always has been. To start later trials before
+// that, pass SAVED: the PRNG's place is saved there, and SEED is set to
+// the seed the next trial gets if nothing else is drawn. The caller
+// restores SAVED before carrying on with this trial, and starts the
+// later trials again if the seed turns out different.
+static enum run_step_res
+gen_step(struct fuzz* t, size_t trial, uint64_t* seed, enum all_gen_res* gres,
+		struct prng_info* saved)
 {
 	// If any seeds to always run were specified, use those before
 	// reverting to the specified starting seed.
 	const size_t always_seeds = t->seeds.always_seed_count;
+	const bool chained = (t->seeds.schedule == FUZZ_SEED_SCHEDULE_CHAINED);
 	if (trial < always_seeds) {
 		*seed = t->seeds.always_seeds[trial];
+	} else if (!chained) {
+		*seed = fuzz_trial_seed(t->seeds.run_seed, trial);
 	} else if ((always_seeds > 0) && (trial == always_seeds)) {
 		*seed = t->seeds.run_seed;
 	}
@@ -5324,23 +9434,25 @@ run_step(struct fuzz* t, size_t trial, uint64_t* seed)
 			.trial = trial,
 			.seed  = *seed,
 	};
-	if (!init_arg_info(t, &trial_info)) {
+	memcpy(&t->trial, &trial_info, sizeof(trial_info));
+	if (!init_arg_info(t, &t->trial)) {
 		return RUN_STEP_GEN_ERROR;
 	}
 
-	memcpy(&t->trial, &trial_info, sizeof(trial_info));
-
 	fuzz_hook_gen_args_pre_cb* pre_gen_args = t->hooks.pre_gen_args;
 	if (pre_gen_args != NULL) {
 		struct fuzz_pre_gen_args_info hook_info = {
 				.prop_name    = t->prop.name,
 				.total_trials = t->prop.trial_count,
-				.failures     = t->counters.fail,
 				.run_seed     = t->seeds.run_seed,
 				.trial_id     = t->trial.trial,
 				.trial_seed   = t->trial.seed,
 				.arity        = t->prop.arity};
-		int res = pre_gen_args(&hook_info, t->hooks.env);
+		// Counters are only current while holding the run lock.
+		fuzz_run_lock(t);
+		hook_info.failures = t->counters.fail;
+		int res            = pre_gen_args(&hook_info, t->hooks.env);
+		fuzz_run_unlock(t);
 
 		switch (res) {
 		case FUZZ_HOOK_RUN_CONTINUE:
@@ -5354,33 +9466,101 @@ run_step(struct fuzz* t, size_t trial, uint64_t* seed)
 		}
 	}
 
-	// Set seed for this trial
-	LOG(3 - LOG_RUN, "%s: SETTING TRIAL SEED TO 0x%016" PRIx64 "\n",
-			__func__, trial_info.seed);
-	fuzz_random_set_seed(t, trial_info.seed);
+	// Set seed for this trial
+	LOG(3 - LOG_RUN, "%s: SETTING TRIAL SEED TO 0x%016" PRIx64 "\n",
+			__func__, t->trial.seed);
+	fuzz_random_set_seed(t, t->trial.seed);
+
+	*gres = gen_all_args(t);
+
+	if (chained && saved != NULL) {
+		fuzz_random_save(t, saved);
+		*seed = fuzz_random_bits(t, 64);
+		LOG(3 - LOG_RUN,
+				"end of generation, next seed is 0x%016" PRIx64
+				"\n",
+				*seed);
+	}
+	return RUN_STEP_OK;
+}
+
+// With the chained schedule, draw the seed for the trial after the one
+// that just finished.
+static uint64_t
+next_chained_seed(struct fuzz* t)
+{
+	const uint64_t seed = fuzz_random_bits(t, 64);
+	LOG(3 - LOG_RUN, "end of trial, new seed is 0x%016" PRIx64 "\n",
+			seed);
+	return seed;
+}
+
+// Take the arguments in t->trial back out of the bloom filter, for a
+// trial that was generated but is being dropped without running.
+static void
+forget_trial_args(struct fuzz* t)
+{
+	if (t->bloom == NULL) {
+		return;
+	}
+	uint64_t hashes[2 * FUZZ_MAX_ARITY];
+	fuzz_call_hash_args(t, hashes);
+	fuzz_bloom_forget(t->bloom, (uint8_t*)hashes,
+			2 * t->prop.arity * sizeof(uint64_t));
+}
+
+// Call the pre-trial hook for the trial in t->trial.
+static enum run_step_res
+pre_trial_step(struct fuzz* t)
+{
+	if (t->hooks.trial_pre == NULL) {
+		return RUN_STEP_OK;
+	}
+
+	void* args[FUZZ_MAX_ARITY];
+	fuzz_trial_get_args(t, args);
 
-	enum run_step_res res  = RUN_STEP_OK;
-	enum all_gen_res  gres = gen_all_args(t);
-	// anything after this point needs to free all args
+	struct fuzz_pre_trial_info info = {
+			.prop_name    = t->prop.name,
+			.total_trials = t->prop.trial_count,
+			.failures     = t->counters.fail,
+			.run_seed     = t->seeds.run_seed,
+			.trial_id     = t->trial.trial,
+			.trial_seed   = t->trial.seed,
+			.arity        = t->prop.arity,
+			.args         = args,
+	};
+
+	int tpres = t->hooks.trial_pre(&info, t->hooks.env);
+	if (tpres == FUZZ_HOOK_RUN_HALT) {
+		return RUN_STEP_HALT;
+	} else if (tpres == FUZZ_HOOK_RUN_ERROR) {
+		return RUN_STEP_TRIAL_ERROR;
+	}
+	return RUN_STEP_OK;
+}
 
+// Update counters and call the post-trial hook for a trial whose arguments
+// were skipped, duplicated, or couldn't be generated.
+static enum run_step_res
+report_gen_result(struct fuzz* t, enum all_gen_res gres)
+{
 	fuzz_hook_trial_post_cb* post_cb = t->hooks.trial_post;
 	void* hook_env = (t->hooks.trial_post == fuzz_hook_trial_post_print_result
 					  ? t->print_trial_result_env
 					  : t->hooks.env);
 
 	void* args[FUZZ_MAX_ARITY];
-	for (size_t i = 0; i < t->prop.arity; i++) {
-		args[i] = t->trial.args[i].instance;
-	}
+	fuzz_trial_get_args(t, args);
 
 	struct fuzz_post_trial_info hook_info = {
 			.t            = t,
 			.prop_name    = t->prop.name,
 			.total_trials = t->prop.trial_count,
 			.failures     = t->counters.fail,
-			.run_seed     = *seed,
-			.trial_id     = trial,
-			.trial_seed   = trial_info.seed,
+			.run_seed     = t->seeds.run_seed,
+			.trial_id     = t->trial.trial,
+			.trial_seed   = t->trial.seed,
 			.arity        = t->prop.arity,
 			.args         = args,
 	};
@@ -5401,56 +9581,651 @@ run_step(struct fuzz* t, size_t trial, uint64_t* seed)
 		pres             = post_cb(&hook_info, hook_env);
 		break;
 	default:
+	case ALL_GEN_OK:
+		assert(false);
 	case ALL_GEN_ERROR: // error while generating args
 		LOG(1 - LOG_RUN, "gen -- error\n");
 		hook_info.result = FUZZ_RESULT_ERROR;
 		pres             = post_cb(&hook_info, hook_env);
-		res              = RUN_STEP_GEN_ERROR;
-		goto cleanup;
-	case ALL_GEN_OK:
-		LOG(4 - LOG_RUN, "gen -- ok\n");
-		if (t->hooks.trial_pre != NULL) {
-			struct fuzz_pre_trial_info info = {
-					.prop_name    = t->prop.name,
-					.total_trials = t->prop.trial_count,
-					.failures     = t->counters.fail,
-					.run_seed     = t->seeds.run_seed,
-					.trial_id     = trial,
-					.trial_seed   = trial_info.seed,
-					.arity        = t->prop.arity,
-			};
+		return RUN_STEP_GEN_ERROR;
+	}
+
+	if (pres == FUZZ_HOOK_RUN_ERROR) {
+		return RUN_STEP_TRIAL_ERROR;
+	}
+	return RUN_STEP_OK;
+}
+
+// Run trials 0 to LIMIT with fork.workers worker processes.
+//
+// Arguments are generated and calls are started in trial order, whenever
+// a worker is free. Trials are retired strictly in trial order once their
+// call has finished, so the counters and hooks don't depend on which
+// worker finishes first.
+//
+// With the chained schedule, a trial's stream is picked up again where
+// generating it left off when it's retired. If it fails, or its seed for
+// the next trial turns out different, the trials started after it are
+// dropped and started again, so every trial gets the same seed as in a
+// serial run.
+static enum run_step_res
+run_trials_pool(struct fuzz* t, size_t limit)
+{
+	const size_t          width   = t->fork.workers;
+	const bool            chained = (t->seeds.schedule ==
+					 FUZZ_SEED_SCHEDULE_CHAINED);
+	struct pending_trial* pending = calloc(width, sizeof(*pending));
+	struct prng_info*     saved   = NULL; // PRNGs, one per pending trial
+	if (pending == NULL) {
+		return RUN_STEP_TRIAL_ERROR;
+	}
+
+	enum run_step_res res    = RUN_STEP_OK;
+	uint64_t          seed   = t->seeds.run_seed;
+	size_t            next   = 0; // next trial to start
+	size_t            head   = 0; // next trial to retire
+	bool              halted = false;
+
+	if (chained) {
+		saved = calloc(width, sizeof(*saved));
+		if (saved == NULL) {
+			res = RUN_STEP_TRIAL_ERROR;
+			goto cleanup;
+		}
+		for (size_t i = 0; i < width; i++) {
+			saved[i].rng = fuzz_rng_init(t->prng.kind, 0);
+			if (saved[i].rng == NULL) {
+				res = RUN_STEP_TRIAL_ERROR;
+				goto cleanup;
+			}
+		}
+	}
 
-			int tpres;
-			tpres = t->hooks.trial_pre(&info, t->hooks.env);
-			if (tpres == FUZZ_HOOK_RUN_HALT) {
-				res = RUN_STEP_HALT;
+	for (;;) {
+		while (!halted && next < limit && next - head < width) {
+			const size_t          i  = next % width;
+			const size_t          id = shard_trial_id(t, next);
+			struct pending_trial* p  = &pending[i];
+			res = start_pending_trial(t, id, &seed, p,
+					(chained ? &saved[i] : NULL));
+			if (res == RUN_STEP_HALT) {
+				halted = true;
+			} else if (res != RUN_STEP_OK) {
 				goto cleanup;
-			} else if (tpres == FUZZ_HOOK_RUN_ERROR) {
+			} else {
+				next++;
+			}
+		}
+
+		if (head == next) {
+			res = (halted ? RUN_STEP_HALT : RUN_STEP_OK);
+			break;
+		}
+
+		struct pending_trial* p = &pending[head % width];
+		if (p->worker != NULL && !p->worker->done) {
+			if (!fuzz_call_poll(t, &t->workers[1], width)) {
 				res = RUN_STEP_TRIAL_ERROR;
 				goto cleanup;
 			}
+			continue;
+		}
+
+		// Shrinking a failure draws from its stream, so the trials
+		// after it will need new seeds. Drop them first, so it's
+		// shrunk with the same arguments in the bloom filter as in a
+		// serial run.
+		const bool fails = (chained && p->worker != NULL &&
+				    FUZZ_RESULT_IS_FAIL(p->worker->result));
+		if (fails) {
+			drop_pending_trials(t, pending, width, head + 1, next);
+			next = head + 1;
+		}
+
+		const uint64_t next_seed = p->next_seed;
+		uint64_t       new_seed  = next_seed;
+		res = retire_pending_trial(t, p,
+				(chained ? &saved[head % width] : NULL),
+				&new_seed);
+		head++;
+		LOG(3 - LOG_RUN, "  -- trial %zd/%zd retired, res %d\n",
+				head - 1, limit, res);
+		if (res != RUN_STEP_OK) {
+			goto cleanup;
+		}
+
+		if (fails || new_seed != next_seed) {
+			drop_pending_trials(t, pending, width, head, next);
+			next   = head;
+			seed   = new_seed;
+			halted = false;
+		}
+	}
+
+cleanup:
+	// Abandon any trials that were started but won't be retired.
+	drop_pending_trials(t, pending, width, head, next);
+	for (size_t i = 0; saved != NULL && i < width; i++) {
+		fuzz_rng_free(saved[i].rng);
+	}
+	free(saved);
+	free(pending);
+	return res;
+}
+
+// Generate arguments for TRIAL, and if that worked, start its call on a
+// free worker. On success, the trial's state is moved into P. SEED and
+// SAVED are as for gen_step.
+static enum run_step_res
+start_pending_trial(struct fuzz* t, size_t trial, uint64_t* seed,
+		struct pending_trial* p, struct prng_info* saved)
+{
+	memset(p, 0x00, sizeof(*p));
+
+	enum run_step_res res = gen_step(t, trial, seed, &p->gres, saved);
+	if (res == RUN_STEP_OK && p->gres == ALL_GEN_OK) {
+		for (size_t i = 1; i < t->worker_count; i++) {
+			if (!t->workers[i].busy) {
+				p->worker = &t->workers[i];
+				break;
+			}
+		}
+		assert(p->worker != NULL);
+
+		void* args[FUZZ_MAX_ARITY];
+		fuzz_trial_get_args(t, args);
+		if (!fuzz_call_start(t, p->worker, args)) {
+			p->worker = NULL;
+			res       = RUN_STEP_TRIAL_ERROR;
 		}
+	}
+
+	if (res == RUN_STEP_OK) {
+		memcpy(&p->info, &t->trial, sizeof(p->info));
+		p->next_seed = *seed;
+	} else {
+		fuzz_trial_free_args(t);
+	}
+	memset(&t->trial, 0x00, sizeof(t->trial));
+	return res;
+}
+
+// Handle a finished trial: call its pre-trial hook, then update counters,
+// shrink, and call the post-trial hooks, just as run_step would have.
+// With the chained schedule, SAVED is where generating it left its PRNG,
+// and SEED is set to the seed for the trial after it.
+static enum run_step_res
+retire_pending_trial(struct fuzz* t, struct pending_trial* p,
+		struct prng_info* saved, uint64_t* seed)
+{
+	memcpy(&t->trial, &p->info, sizeof(t->trial));
+	if (saved != NULL) {
+		fuzz_random_restore(t, saved);
+	}
 
-		if (!fuzz_trial_run(t, &pres)) {
+	enum run_step_res res = RUN_STEP_OK;
+	if (p->gres != ALL_GEN_OK) {
+		res = report_gen_result(t, p->gres);
+	} else {
+		const int tres = p->worker->result;
+		fuzz_call_take_info(t, p->worker);
+		fuzz_call_abandon(t, p->worker); // release the worker
+
+		res = pre_trial_step(t);
+		int pres;
+		if (res == RUN_STEP_OK &&
+				(!fuzz_trial_handle_result(t, tres, &pres) ||
+						pres == FUZZ_HOOK_RUN_ERROR)) {
 			res = RUN_STEP_TRIAL_ERROR;
+		}
+	}
+
+	if (res == RUN_STEP_OK && saved != NULL) {
+		*seed = next_chained_seed(t);
+	}
+
+	fuzz_trial_free_args(t);
+	memset(&t->trial, 0x00, sizeof(t->trial));
+	memset(p, 0x00, sizeof(*p));
+	return res;
+}
+
+// Drop the pending trials FROM to TO without retiring them: abandon their
+// calls, take their arguments back out of the bloom filter, and free
+// them.
+static void
+drop_pending_trials(struct fuzz* t, struct pending_trial* pending,
+		size_t width, size_t from, size_t to)
+{
+	for (size_t i = from; i < to; i++) {
+		struct pending_trial* p = &pending[i % width];
+		if (p->worker != NULL) {
+			fuzz_call_abandon(t, p->worker);
+		}
+		memcpy(&t->trial, &p->info, sizeof(t->trial));
+		if (p->gres == ALL_GEN_OK) {
+			forget_trial_args(t);
+		}
+		fuzz_trial_free_args(t);
+		memset(p, 0x00, sizeof(*p));
+	}
+	memset(&t->trial, 0x00, sizeof(t->trial));
+}
+
+// Run trials 0 to LIMIT on t->thread_count threads, each with its own
+// copy of T.
+static enum run_step_res
+run_trials_threads(struct fuzz* t, size_t limit)
+{
+#if FUZZ_POLYFILL_HAVE_THREADS
+	const size_t       count   = t->thread_count;
+	enum run_step_res  res     = RUN_STEP_TRIAL_ERROR;
+	size_t             inited  = 0;
+	size_t             spawned = 0;
+	struct thread_info info    = {
+			.run   = t,
+			.count = count,
+			.limit = limit,
+			.seed  = t->seeds.run_seed,
+	};
+
+	struct fuzz* handles = calloc(count, sizeof(*handles));
+	pthread_t*   threads = calloc(count, sizeof(*threads));
+	if (handles == NULL || threads == NULL) {
+		goto cleanup;
+	}
+	info.handles = handles;
+
+	for (; inited < count; inited++) {
+		struct fuzz* handle = &handles[inited];
+		memcpy(handle, t, sizeof(*handle));
+		memset(&handle->prng, 0x00, sizeof(handle->prng));
+		memset(&handle->trial, 0x00, sizeof(handle->trial));
+		handle->dedup.forget       = NULL;
+		handle->dedup.forget_count = 0;
+		handle->dedup.forget_ceil  = 0;
+
+		handle->thread           = &info;
+		handle->spare_pools      = NULL;
+		handle->spare_pool_count = 0;
+		handle->prng.kind        = t->prng.kind;
+		handle->prng.rng         = fuzz_rng_init(
+				t->prng.kind, DEFAULT_uint64_t);
+		if (handle->prng.rng == NULL) {
 			goto cleanup;
 		}
+		if (t->seeds.schedule == FUZZ_SEED_SCHEDULE_CHAINED) {
+			handle->thread_trial.saved.rng =
+					fuzz_rng_init(t->prng.kind, 0);
+			if (handle->thread_trial.saved.rng == NULL) {
+				inited++;
+				goto cleanup;
+			}
+		}
 	}
 
-	if (pres == FUZZ_HOOK_RUN_ERROR) {
+	pthread_mutex_init(&info.gen_lock, NULL);
+	pthread_cond_init(&info.gen_cond, NULL);
+	pthread_mutex_init(&info.run_lock, NULL);
+	pthread_mutex_init(&info.weights_lock, NULL);
+
+	for (; spawned < count; spawned++) {
+		if (pthread_create(&threads[spawned], NULL, run_thread,
+				    &handles[spawned]) != 0) {
+			pthread_mutex_lock(&info.gen_lock);
+			info.halted = true;
+			info.error  = true;
+			pthread_cond_broadcast(&info.gen_cond);
+			pthread_mutex_unlock(&info.gen_lock);
+			break;
+		}
+	}
+	for (size_t i = 0; i < spawned; i++) {
+		pthread_join(threads[i], NULL);
+	}
+
+	pthread_mutex_destroy(&info.gen_lock);
+	pthread_cond_destroy(&info.gen_cond);
+	pthread_mutex_destroy(&info.run_lock);
+	pthread_mutex_destroy(&info.weights_lock);
+
+	if (info.error) {
 		res = RUN_STEP_TRIAL_ERROR;
-		goto cleanup;
+	} else {
+		res = (info.halted ? RUN_STEP_HALT : RUN_STEP_OK);
 	}
 
-	// Update seed for next trial
-	*seed = fuzz_random_bits(t, 64);
-	LOG(3 - LOG_RUN, "end of trial, new seed is 0x%016" PRIx64 "\n",
-			*seed);
 cleanup:
-	fuzz_trial_free_args(t);
+	for (size_t i = 0; i < inited; i++) {
+		if (!add_forgotten(t, &handles[i].dedup)) {
+			res = RUN_STEP_TRIAL_ERROR;
+		}
+		free(handles[i].dedup.forget);
+		fuzz_rng_free(handles[i].prng.rng);
+		fuzz_rng_free(handles[i].thread_trial.saved.rng);
+		fuzz_autoshrink_free_spare_pools(&handles[i]);
+	}
+	free(handles);
+	free(threads);
+	return res;
+#else
+	(void)t;
+	(void)limit;
+	assert(false);
+	return RUN_STEP_TRIAL_ERROR;
+#endif
+}
+
+#if FUZZ_POLYFILL_HAVE_THREADS
+// Body of each thread in run_trials_threads: take the next trial, generate
+// its arguments, and run it, until they run out or the run halts.
+//
+// With the chained schedule, each trial's seed comes from the trial
+// before, so trials are generated in order, one thread at a time, each
+// assuming the trials before it won't draw anything else from their
+// streams. Trials are then retired in order by retire_thread_trial, which
+// drops and regenerates the later ones when that turns out wrong.
+static void*
+run_thread(void* arg)
+{
+	struct fuzz*         t       = arg;
+	struct thread_info*  info    = t->thread;
+	struct thread_trial* tt      = &t->thread_trial;
+	const bool           chained = (t->seeds.schedule ==
+					 FUZZ_SEED_SCHEDULE_CHAINED);
+
+	for (;;) {
+		pthread_mutex_lock(&info->gen_lock);
+		while ((info->seed_pending || info->generating) &&
+				!info->halted) {
+			pthread_cond_wait(&info->gen_cond, &info->gen_lock);
+		}
+		if (info->halted || info->next_trial >= info->limit) {
+			pthread_mutex_unlock(&info->gen_lock);
+			break;
+		}
+
+		// With the chained schedule, generating a trial is what
+		// gives the seed for the next one, so only one thread
+		// generates at a time. That also marks the bloom filter in
+		// trial order, so duplicates are found as in a serial run.
+		const size_t trial = info->next_trial++;
+		uint64_t     seed  = info->seed;
+		info->generating   = chained;
+		pthread_mutex_unlock(&info->gen_lock);
+
+		enum all_gen_res  gres = ALL_GEN_ERROR;
+		enum run_step_res res  = gen_step(t, shard_trial_id(t, trial),
+				 &seed, &gres, (chained ? &tt->saved : NULL));
+		const bool marked = (res == RUN_STEP_OK &&
+				     gres == ALL_GEN_OK && t->bloom != NULL);
+		if (chained && marked) {
+			fuzz_call_hash_args(t, tt->hashes);
+		}
+
+		if (chained) {
+			pthread_mutex_lock(&info->gen_lock);
+			info->generating = false;
+			pthread_cond_broadcast(&info->gen_cond);
+		}
+		if (chained && res != RUN_STEP_OK) {
+			// This trial will never be retired, so start no more
+			// after it, unless it's dropped.
+			info->halted    = true;
+			info->halted_at = trial;
+			info->error |= (res != RUN_STEP_HALT);
+			pthread_mutex_unlock(&info->gen_lock);
+			fuzz_trial_free_args(t);
+			memset(&t->trial, 0x00, sizeof(t->trial));
+			continue;
+		} else if (chained) {
+			info->seed    = seed;
+			tt->live      = true;
+			tt->index     = trial;
+			tt->next_seed = seed;
+			tt->marked    = marked;
+			pthread_mutex_unlock(&info->gen_lock);
+			fuzz_random_restore(t, &tt->saved);
+		}
+
+		int tres = FUZZ_RESULT_ERROR;
+		if (res == RUN_STEP_OK && gres == ALL_GEN_OK) {
+			fuzz_run_lock(t);
+			res = pre_trial_step(t);
+			fuzz_run_unlock(t);
+
+			if (res == RUN_STEP_OK) {
+				void* args[FUZZ_MAX_ARITY];
+				fuzz_trial_get_args(t, args);
+				tres = fuzz_call(t, args);
+			}
+		}
+
+		if (chained) {
+			res = retire_thread_trial(t, res, gres, tres);
+		} else if (res == RUN_STEP_OK && gres != ALL_GEN_OK) {
+			fuzz_run_lock(t);
+			res = report_gen_result(t, gres);
+			fuzz_run_unlock(t);
+		} else if (res == RUN_STEP_OK) {
+			int pres;
+			if (!fuzz_trial_handle_result(t, tres, &pres) ||
+					pres == FUZZ_HOOK_RUN_ERROR) {
+				res = RUN_STEP_TRIAL_ERROR;
+			}
+		}
+
+		fuzz_trial_free_args(t);
+		memset(&t->trial, 0x00, sizeof(t->trial));
+
+		if (res != RUN_STEP_OK) {
+			pthread_mutex_lock(&info->gen_lock);
+			info->halted    = true;
+			info->halted_at = trial;
+			if (res != RUN_STEP_HALT) {
+				info->error = true;
+			}
+			pthread_cond_broadcast(&info->gen_cond);
+			pthread_mutex_unlock(&info->gen_lock);
+			break;
+		}
+	}
+	return NULL;
+}
+
+// With the chained schedule, wait until the trials before this thread's
+// trial have been retired, then retire it: update the counters, shrink it
+// if it failed, and call the hooks, with RES, GRES and TRES saying how
+// far it got. If anything else was drawn from its stream in the meantime,
+// the trials after it got the wrong seeds, so drop them to be generated
+// again, with the seed that follows it.
+//
+// If this trial is dropped while waiting, or another thread hits an
+// error, return RUN_STEP_OK without doing anything else.
+static enum run_step_res
+retire_thread_trial(struct fuzz* t, enum run_step_res res,
+		enum all_gen_res gres, int tres)
+{
+	struct thread_info*  info = t->thread;
+	struct thread_trial* tt   = &t->thread_trial;
+
+	pthread_mutex_lock(&info->gen_lock);
+	while (tt->live && !info->error && info->next_retire != tt->index) {
+		pthread_cond_wait(&info->gen_cond, &info->gen_lock);
+	}
+	if (!tt->live || info->error) {
+		tt->live = false;
+		pthread_mutex_unlock(&info->gen_lock);
+		return RUN_STEP_OK;
+	}
+
+	// Shrinking a failure draws from its stream, so the trials after it
+	// will need new seeds. Drop them first, so it's shrunk with the same
+	// arguments in the bloom filter as in a serial run, and hold off
+	// generating more until the new seed is known.
+	const bool fails = (res == RUN_STEP_OK && gres == ALL_GEN_OK &&
+			    FUZZ_RESULT_IS_FAIL(tres));
+	if (fails) {
+		drop_thread_trials(info, tt->index);
+	}
+	pthread_mutex_unlock(&info->gen_lock);
+
+	if (res == RUN_STEP_OK && gres != ALL_GEN_OK) {
+		fuzz_run_lock(t);
+		res = report_gen_result(t, gres);
+		fuzz_run_unlock(t);
+	} else if (res == RUN_STEP_OK) {
+		int pres;
+		if (!fuzz_trial_handle_result(t, tres, &pres) ||
+				pres == FUZZ_HOOK_RUN_ERROR) {
+			res = RUN_STEP_TRIAL_ERROR;
+		}
+	}
+
+	const uint64_t seed = (res == RUN_STEP_OK ? next_chained_seed(t) : 0);
+
+	pthread_mutex_lock(&info->gen_lock);
+	if (res == RUN_STEP_OK && (fails || seed != tt->next_seed)) {
+		if (!fails) {
+			drop_thread_trials(info, tt->index);
+		}
+		info->seed = seed;
+	}
+	info->seed_pending = false;
+	info->next_retire  = tt->index + 1;
+	tt->live           = false;
+	pthread_cond_broadcast(&info->gen_cond);
+	pthread_mutex_unlock(&info->gen_lock);
 	return res;
 }
 
+// Drop the trials after the one with INDEX, which is being retired, so
+// they're generated again, starting with the trial right after it. Their
+// arguments are taken back out of the bloom filter, as if they had never
+// been generated. Called while holding gen_lock. This first waits for any
+// trial being generated, and sets seed_pending so no more are until the
+// caller clears it.
+static void
+drop_thread_trials(struct thread_info* info, size_t index)
+{
+	struct fuzz* run   = info->run;
+	const size_t words = 2 * run->prop.arity;
+
+	info->seed_pending = true;
+	while (info->generating) {
+		pthread_cond_wait(&info->gen_cond, &info->gen_lock);
+	}
+
+	for (size_t i = 0; i < info->count; i++) {
+		struct thread_trial* tt = &info->handles[i].thread_trial;
+		if (!tt->live || tt->index <= index) {
+			continue;
+		}
+		if (tt->marked) {
+			fuzz_bloom_forget(run->bloom, (uint8_t*)tt->hashes,
+					words * sizeof(uint64_t));
+		}
+		tt->live = false;
+	}
+	info->next_trial = index + 1;
+	if (info->halted && !info->error && info->halted_at > index) {
+		info->halted = false; // it was one of the dropped trials
+	}
+	pthread_cond_broadcast(&info->gen_cond);
+}
+#endif
+
+void
+fuzz_run_lock(struct fuzz* t)
+{
+#if FUZZ_POLYFILL_HAVE_THREADS
+	if (t->thread != NULL) {
+		pthread_mutex_lock(&t->thread->run_lock);
+		t->counters = t->thread->run->counters;
+	}
+#else
+	(void)t;
+#endif
+}
+
+void
+fuzz_run_unlock(struct fuzz* t)
+{
+#if FUZZ_POLYFILL_HAVE_THREADS
+	if (t->thread != NULL) {
+		t->thread->run->counters = t->counters;
+		pthread_mutex_unlock(&t->thread->run_lock);
+	}
+#else
+	(void)t;
+#endif
+}
+
+// Number of trials this shard runs.
+static size_t
+shard_trial_count(const struct fuzz* t)
+{
+	const size_t total = t->prop.trial_count;
+	if (total <= t->shard.index) {
+		return 0;
+	}
+	return (total - t->shard.index + t->shard.count - 1) / t->shard.count;
+}
+
+// The run's trial id for this shard's I'th trial.
+static size_t
+shard_trial_id(const struct fuzz* t, size_t i)
+{
+	return t->shard.index + i * t->shard.count;
+}
+
+static int
+cmp_failure(const void* a, const void* b)
+{
+	const struct fuzz_failure* fa = a;
+	const struct fuzz_failure* fb = b;
+	return (fa->trial_id > fb->trial_id) - (fa->trial_id < fb->trial_id);
+}
+
+// Hand the run's counters and failures over to fuzz_run_config.report.
+static bool
+fill_report(struct fuzz* t)
+{
+	struct failure_log* log   = t->failures;
+	size_t*             index = malloc(sizeof(*index));
+	if (index == NULL) {
+		return false;
+	}
+	*index = t->shard.index;
+
+	// Trials on different threads can fail out of order.
+	if (log->count > 1) {
+		qsort(log->failures, log->count, sizeof(*log->failures),
+				cmp_failure);
+	}
+
+	*t->report = (struct fuzz_report){
+			.run_seed      = t->seeds.run_seed,
+			.shard_count   = t->shard.count,
+			.shards        = 1,
+			.shard_indices = index,
+			.report =
+					{
+							.pass    = t->counters.pass,
+							.fail    = t->counters.fail,
+							.skip    = t->counters.skip,
+							.dup     = t->counters.dup,
+							.timeout = t->counters.timeout,
+							.oom     = t->counters.oom,
+							.crash   = t->counters.crash,
+					},
+			.failure_count = log->count,
+			.failures      = log->failures,
+	};
+	memset(log, 0x00, sizeof(*log));
+	return true;
+}
+
 static uint8_t
 infer_arity(const struct fuzz_run_config* cfg)
 {
@@ -5514,6 +10289,68 @@ check_all_args(uint8_t arity, const struct fuzz_run_config* cfg,
 	return true;
 }
 
+// Hash what saved bloom filters are keyed by: the property's name, and
+// what can be told about how each argument is generated and hashed.
+static void
+dedup_key(uint8_t arity, const struct fuzz_run_config* cfg, uint64_t key[2])
+{
+	const char* name = (cfg->name ? cfg->name : "");
+	uint64_t    name_hash[2];
+	fuzz_hash128_onepass((const uint8_t*)name, strlen(name), name_hash);
+
+	struct fuzz_hash128 h;
+	fuzz_hash128_init(&h);
+	fuzz_hash128_sink(&h, name_hash, 2);
+	for (uint8_t i = 0; i < arity; i++) {
+		const struct fuzz_type_info* ti = cfg->type_info[i];
+		// Callbacks' addresses can change from build to build, so
+		// only which builtin type this is, if any, is used.
+		const int last    = FUZZ_BUILTIN_uint8_t_ARRAY;
+		uint64_t  builtin = UINT64_MAX;
+		for (int k = FUZZ_BUILTIN_bool; k <= last; k++) {
+			const struct fuzz_type_info* bti =
+					fuzz_get_builtin_type_info(k);
+			if (ti->alloc == bti->alloc) {
+				builtin = k;
+				break;
+			}
+		}
+		const uint64_t words[] = {
+				builtin,
+				ti->autoshrink_config.enable,
+				ti->hash != NULL,
+		};
+		fuzz_hash128_sink(&h, words, 3);
+	}
+	fuzz_hash128_finish(&h, key);
+}
+
+// Add the calls a thread forgot, in FROM, to the run's.
+static bool
+add_forgotten(struct fuzz* t, const struct dedup_info* from)
+{
+	struct dedup_info* d     = &t->dedup;
+	const size_t       words = 2 * t->prop.arity;
+	if (from->forget_count == 0) {
+		return true;
+	}
+
+	const size_t count = d->forget_count + from->forget_count;
+	if (count > d->forget_ceil) {
+		uint64_t* nforget = realloc(
+				d->forget, count * words * sizeof(uint64_t));
+		if (nforget == NULL) {
+			return false;
+		}
+		d->forget      = nforget;
+		d->forget_ceil = count;
+	}
+	memcpy(&d->forget[d->forget_count * words], from->forget,
+			from->forget_count * words * sizeof(uint64_t));
+	d->forget_count = count;
+	return true;
+}
+
 static bool
 init_arg_info(struct fuzz* t, struct trial_info* trial_info)
 {
@@ -5559,9 +10396,17 @@ gen_all_args(struct fuzz* t)
 		}
 	}
 
-	// check bloom filter
-	if (t->bloom && fuzz_call_check_called(t)) {
-		return ALL_GEN_DUP;
+	// Check the bloom filter, and mark the arguments as called right
+	// away, so later trials see them before this one has finished.
+	// Seeds to always run are marked, but never skipped.
+	if (t->bloom) {
+		uint64_t hashes[2 * FUZZ_MAX_ARITY];
+		fuzz_call_hash_args(t, hashes);
+		const size_t trial  = (size_t)t->trial.trial;
+		const bool   always = trial < t->seeds.always_seed_count;
+		if (fuzz_call_check_and_mark_called(t, hashes) && !always) {
+			return ALL_GEN_DUP;
+		}
 	}
 
 	return ALL_GEN_OK;
@@ -5604,6 +10449,31 @@ enum shrink_res {
 
 static enum shrink_res attempt_to_shrink_arg(struct fuzz* t, uint8_t arg_i);
 
+// A candidate being tried by attempt_to_shrink_arg_speculative.
+struct shrink_candidate {
+	uint32_t                    tactic;
+	void*                       instance;
+	struct autoshrink_bit_pool* bit_pool;   // with autoshrink
+	uint8_t                     cur_tactic; // tactic that made it
+	uint8_t                     cur_reward; // and what it earns
+	struct worker_info*         worker;     // running its call
+};
+
+static enum shrink_res attempt_to_shrink_arg_speculative(
+		struct fuzz* t, uint8_t arg_i);
+
+static void set_shrink_arg(struct fuzz* t, uint8_t arg_i, void* instance,
+		struct autoshrink_bit_pool* bit_pool);
+
+static bool commit_shrink_arg(struct fuzz* t, uint8_t arg_i, void* current,
+		struct autoshrink_bit_pool* current_bit_pool);
+
+static void discard_candidate(
+		struct fuzz* t, uint8_t arg_i, struct shrink_candidate* c);
+
+static bool forget_batch(struct fuzz* t, uint8_t arg_i,
+		struct shrink_candidate* cands, size_t i, size_t count);
+
 static int shrink_pre_hook(
 		struct fuzz* t, uint8_t arg_index, void* arg, uint32_t tactic);
 
@@ -5613,6 +10483,35 @@ static int shrink_post_hook(struct fuzz* t, uint8_t arg_index, void* arg,
 static int shrink_trial_post_hook(struct fuzz* t, uint8_t arg_index,
 		void** args, uint32_t last_tactic, int result);
 
+// An exact set of the 128-bit hashes of the argument tuples called while
+// shrinking one failure, so no shrink candidate is called twice. It's an
+// open-addressing hash table with linear probing, which doubles in size
+// whenever it gets half full, up to SHRINK_MEMO_MAX_BYTES. Past that, it
+// stops adding hashes once it's three quarters full.
+#define SHRINK_MEMO_CEIL2     10
+#define SHRINK_MEMO_MAX_BYTES (16LU << 20)
+
+struct shrink_memo {
+	uint8_t   ceil2; // 1 << ceil2 slots
+	size_t    count;
+	uint64_t* keys; // two words per slot, { 0, 0 } when empty
+};
+
+static struct shrink_memo* shrink_memo_alloc(void);
+
+static void shrink_memo_free(struct shrink_memo* memo);
+
+static void shrink_memo_clear(struct shrink_memo* memo);
+
+static bool memo_check_and_mark(struct shrink_memo* memo,
+		const uint64_t* hashes, uint8_t arity);
+
+static bool can_hash(const struct fuzz_type_info* ti);
+
+static bool check_and_mark_called(struct fuzz* t, uint8_t arg_i);
+
+static bool shrink_args(struct fuzz* t);
+
 #define LOG_SHRINK 0
 
 // Attempt to simplify all arguments, breadth first. Continue as long as
@@ -5620,9 +10519,28 @@ static int shrink_trial_post_hook(struct fuzz* t, uint8_t arg_index,
 bool
 fuzz_shrink(struct fuzz* t)
 {
-	bool progress = false;
 	assert(t->prop.arity > 0);
 
+	// Without the memo, shrinking still works, it just may call the
+	// property with the same arguments more than once.
+	t->trial.memo = shrink_memo_alloc();
+	if (t->trial.memo != NULL) {
+		uint64_t hashes[2 * FUZZ_MAX_ARITY];
+		fuzz_call_hash_args(t, hashes);
+		memo_check_and_mark(t->trial.memo, hashes, t->prop.arity);
+	}
+
+	const bool res = shrink_args(t);
+	shrink_memo_free(t->trial.memo);
+	t->trial.memo = NULL;
+	return res;
+}
+
+static bool
+shrink_args(struct fuzz* t)
+{
+	bool progress = false;
+
 	do {
 		progress = false;
 		// Greedily attempt to simplify each argument as much as
@@ -5633,8 +10551,13 @@ fuzz_shrink(struct fuzz* t)
 			if (ti->shrink || ti->autoshrink_config.enable) {
 				// attempt to simplify this argument by one
 				// step
-				enum shrink_res rres = attempt_to_shrink_arg(
-						t, arg_i);
+				enum shrink_res rres;
+				if (t->fork.shrink_workers > 0) {
+					rres = attempt_to_shrink_arg_speculative(
+							t, arg_i);
+				} else {
+					rres = attempt_to_shrink_arg(t, arg_i);
+				}
 
 				switch (rres) {
 				case SHRINK_OK:
@@ -5642,6 +10565,12 @@ fuzz_shrink(struct fuzz* t)
 							"%s %u: progress\n",
 							__func__, arg_i);
 					progress = true;
+					// The memo can't tell this argument's
+					// instances apart.
+					if (!can_hash(ti)) {
+						shrink_memo_clear(
+								t->trial.memo);
+					}
 					goto greedy_continue; // keep trying to
 							      // shrink same
 							      // argument
@@ -5670,9 +10599,10 @@ fuzz_shrink(struct fuzz* t)
 // order, and checking whether the property still fails. If it passes,
 // then revert the simplification and try another tactic.
 //
-// If the bloom filter is being used (i.e., if all arguments have hash
+// Candidates that have already been called while shrinking are skipped;
+// if the bloom filter is being used (i.e., if all arguments have hash
 // callbacks defined), then use it to skip over areas of the state
-// space that have probably already been tried.
+// space that have probably already been tried, too.
 static enum shrink_res
 attempt_to_shrink_arg(struct fuzz* t, uint8_t arg_i)
 {
@@ -5748,25 +10678,19 @@ attempt_to_shrink_arg(struct fuzz* t, uint8_t arg_i)
 			as_env->bit_pool = candidate_bit_pool;
 		}
 
-		if (t->bloom) {
-			if (fuzz_call_check_called(t)) {
-				LOG(3 - LOG_SHRINK,
-						"%s: already called, "
-						"skipping\n",
-						__func__);
-				if (ti->free) {
-					ti->free(candidate, ti->env);
-				}
-				if (use_autoshrink) {
-					as_env->bit_pool = current_bit_pool;
-					fuzz_autoshrink_free_bit_pool(
-							t, candidate_bit_pool);
-				}
-				t->trial.args[arg_i].instance = current;
-				continue;
-			} else {
-				fuzz_call_mark_called(t);
+		if (check_and_mark_called(t, arg_i)) {
+			LOG(3 - LOG_SHRINK, "%s: already called, skipping\n",
+					__func__);
+			if (ti->free) {
+				ti->free(candidate, ti->env);
+			}
+			if (use_autoshrink) {
+				as_env->bit_pool = current_bit_pool;
+				fuzz_autoshrink_free_bit_pool(
+						t, candidate_bit_pool);
 			}
+			t->trial.args[arg_i].instance = current;
+			continue;
 		}
 
 		int  res;
@@ -5780,10 +10704,8 @@ attempt_to_shrink_arg(struct fuzz* t, uint8_t arg_i)
 					res);
 
 			if (!repeated) {
-				if (res == FUZZ_RESULT_FAIL) {
+				if (FUZZ_RESULT_IS_FAIL(res)) {
 					t->trial.successful_shrinks++;
-					fuzz_autoshrink_update_model(
-							t, arg_i, res, 3);
 				} else {
 					t->trial.failed_shrinks++;
 				}
@@ -5803,20 +10725,15 @@ attempt_to_shrink_arg(struct fuzz* t, uint8_t arg_i)
 			} else if (stpres == FUZZ_HOOK_RUN_CONTINUE) {
 				break;
 			} else {
-				if (ti->free) {
-					ti->free(current, ti->env);
-				}
-				if (use_autoshrink && current_bit_pool) {
-					fuzz_autoshrink_free_bit_pool(
-							t, current_bit_pool);
-				}
+				commit_shrink_arg(t, arg_i, current,
+						current_bit_pool);
 				return SHRINK_ERROR;
 			}
 		}
 
-		fuzz_autoshrink_update_model(t, arg_i, res, 8);
+		fuzz_autoshrink_update_model(t, arg_i, res);
 
-		switch (res) {
+		switch (FUZZ_RESULT_IS_FAIL(res) ? FUZZ_RESULT_FAIL : res) {
 		case FUZZ_RESULT_OK:
 		case FUZZ_RESULT_SKIP:
 			LOG(2 - LOG_SHRINK,
@@ -5850,23 +10767,24 @@ attempt_to_shrink_arg(struct fuzz* t, uint8_t arg_i)
 				assert(t->trial.args[arg_i].u.as.env
 								->bit_pool ==
 						candidate_bit_pool);
-				fuzz_autoshrink_free_bit_pool(
-						t, current_bit_pool);
 			}
 			assert(t->trial.args[arg_i].instance == candidate);
-			if (ti->free) {
-				ti->free(current, ti->env);
+			if (!fuzz_call_forget_called(t)) {
+				commit_shrink_arg(t, arg_i, current,
+						current_bit_pool);
+				return SHRINK_ERROR;
+			}
+			if (!commit_shrink_arg(t, arg_i, current,
+					    current_bit_pool)) {
+				return SHRINK_ERROR;
 			}
+			memcpy(&t->fail_call_info, &t->call_info,
+					sizeof(t->fail_call_info));
+			t->fail_result = res;
 			return SHRINK_OK;
 		default:
 		case FUZZ_RESULT_ERROR:
-			if (ti->free) {
-				ti->free(current, ti->env);
-			}
-			if (use_autoshrink) {
-				fuzz_autoshrink_free_bit_pool(
-						t, current_bit_pool);
-			}
+			commit_shrink_arg(t, arg_i, current, current_bit_pool);
 			return SHRINK_ERROR;
 		}
 	}
@@ -5874,10 +10792,446 @@ attempt_to_shrink_arg(struct fuzz* t, uint8_t arg_i)
 	return SHRINK_DEAD_END;
 }
 
+// Put INSTANCE (and for autoshrink, the BIT_POOL it was generated from) in
+// the current trial's argument ARG_I.
+static void
+set_shrink_arg(struct fuzz* t, uint8_t arg_i, void* instance,
+		struct autoshrink_bit_pool* bit_pool)
+{
+	t->trial.args[arg_i].instance = instance;
+	if (t->trial.args[arg_i].type == ARG_AUTOSHRINK) {
+		t->trial.args[arg_i].u.as.env->bit_pool = bit_pool;
+	}
+}
+
+// Keep the candidate in the current trial's argument ARG_I, and free the
+// CURRENT instance (and BIT_POOL) it replaces. Autoshrink candidates are
+// copied out of that bit pool first; if that fails, the candidate is
+// freed instead, CURRENT is put back, and false is returned.
+static bool
+commit_shrink_arg(struct fuzz* t, uint8_t arg_i, void* current,
+		struct autoshrink_bit_pool* current_bit_pool)
+{
+	struct fuzz_type_info* ti = t->prop.type_info[arg_i];
+	struct arg_info*       ai = &t->trial.args[arg_i];
+	if (ai->type == ARG_AUTOSHRINK &&
+			!fuzz_autoshrink_commit_bit_pool(
+					ai->u.as.env->bit_pool)) {
+		if (ti->free) {
+			ti->free(ai->instance, ti->env);
+		}
+		fuzz_autoshrink_free_bit_pool(t, ai->u.as.env->bit_pool);
+		set_shrink_arg(t, arg_i, current, current_bit_pool);
+		return false;
+	}
+
+	if (ti->free) {
+		ti->free(current, ti->env);
+	}
+	if (current_bit_pool != NULL) {
+		fuzz_autoshrink_free_bit_pool(t, current_bit_pool);
+	}
+	return true;
+}
+
+static bool
+can_hash(const struct fuzz_type_info* ti)
+{
+	return ti->hash != NULL || ti->autoshrink_config.enable;
+}
+
+// Check whether the arguments, with arg ARG_I's shrink candidate, have
+// already been called, and mark them as called if not. While shrinking a
+// failure, this is exact, as long as the candidate can be hashed; the
+// bloom filter, if any, also has the calls made by other trials.
+static bool
+check_and_mark_called(struct fuzz* t, uint8_t arg_i)
+{
+	if (!can_hash(t->prop.type_info[arg_i])) {
+		return false; // and there's no bloom filter
+	}
+
+	uint64_t hashes[2 * FUZZ_MAX_ARITY];
+	fuzz_call_hash_args(t, hashes);
+	if (t->trial.memo != NULL &&
+			memo_check_and_mark(t->trial.memo, hashes,
+					t->prop.arity)) {
+		return true;
+	}
+	return t->bloom != NULL && fuzz_call_check_and_mark_called(t, hashes);
+}
+
+static struct shrink_memo*
+shrink_memo_alloc(void)
+{
+	struct shrink_memo* memo = malloc(sizeof(*memo));
+	if (memo == NULL) {
+		return NULL;
+	}
+	*memo = (struct shrink_memo){
+			.ceil2 = SHRINK_MEMO_CEIL2,
+			.keys  = calloc((size_t)2 << SHRINK_MEMO_CEIL2,
+					 sizeof(uint64_t)),
+	};
+	if (memo->keys == NULL) {
+		free(memo);
+		return NULL;
+	}
+	return memo;
+}
+
+static void
+shrink_memo_free(struct shrink_memo* memo)
+{
+	if (memo != NULL) {
+		free(memo->keys);
+		free(memo);
+	}
+}
+
+static void
+shrink_memo_clear(struct shrink_memo* memo)
+{
+	if (memo != NULL) {
+		memset(memo->keys, 0x00,
+				((size_t)2 << memo->ceil2) * sizeof(uint64_t));
+		memo->count = 0;
+	}
+}
+
+// Find KEY's slot in KEYS, or the empty slot where it belongs.
+static size_t
+memo_slot(const uint64_t* keys, uint8_t ceil2, const uint64_t key[2])
+{
+	const size_t mask = ((size_t)1 << ceil2) - 1;
+	for (size_t i = key[0] & mask;; i = (i + 1) & mask) {
+		const uint64_t* slot = &keys[2 * i];
+		if ((slot[0] == key[0] && slot[1] == key[1]) ||
+				(slot[0] == 0 && slot[1] == 0)) {
+			return i;
+		}
+	}
+}
+
+// Double the memo's size, if it isn't at SHRINK_MEMO_MAX_BYTES yet.
+static bool
+memo_grow(struct shrink_memo* memo)
+{
+	const uint8_t nceil2 = memo->ceil2 + 1;
+	const size_t  nbytes = ((size_t)2 << nceil2) * sizeof(uint64_t);
+	if (nbytes > SHRINK_MEMO_MAX_BYTES) {
+		return false;
+	}
+	uint64_t* nkeys = calloc(1, nbytes);
+	if (nkeys == NULL) {
+		return false;
+	}
+
+	for (size_t i = 0; i < ((size_t)1 << memo->ceil2); i++) {
+		const uint64_t* key = &memo->keys[2 * i];
+		if (key[0] != 0 || key[1] != 0) {
+			const size_t slot = memo_slot(nkeys, nceil2, key);
+			nkeys[2 * slot]     = key[0];
+			nkeys[2 * slot + 1] = key[1];
+		}
+	}
+	free(memo->keys);
+	memo->keys  = nkeys;
+	memo->ceil2 = nceil2;
+	return true;
+}
+
+// Check whether the argument tuple with HASHES is in the memo, and add it
+// if not.
+static bool
+memo_check_and_mark(struct shrink_memo* memo, const uint64_t* hashes,
+		uint8_t arity)
+{
+	uint64_t            key[2];
+	struct fuzz_hash128 h;
+	fuzz_hash128_init(&h);
+	fuzz_hash128_sink(&h, hashes, 2 * (size_t)arity);
+	fuzz_hash128_finish(&h, key);
+	if (key[0] == 0 && key[1] == 0) {
+		key[0] = 1; // that means empty
+	}
+
+	size_t slot = memo_slot(memo->keys, memo->ceil2, key);
+	if (memo->keys[2 * slot] != 0 || memo->keys[2 * slot + 1] != 0) {
+		return true;
+	}
+
+	const size_t size = (size_t)1 << memo->ceil2;
+	if (2 * (memo->count + 1) > size) {
+		if (memo_grow(memo)) {
+			slot = memo_slot(memo->keys, memo->ceil2, key);
+		} else if (4 * (memo->count + 1) > 3 * size) {
+			return false; // full: just don't remember it
+		}
+	}
+	memo->keys[2 * slot]     = key[0];
+	memo->keys[2 * slot + 1] = key[1];
+	memo->count++;
+	return false;
+}
+
+// Stop a candidate's call, if it's still running, and free it.
+static void
+discard_candidate(struct fuzz* t, uint8_t arg_i, struct shrink_candidate* c)
+{
+	struct fuzz_type_info* ti = t->prop.type_info[arg_i];
+	if (c->worker != NULL) {
+		fuzz_call_abandon(t, c->worker);
+	}
+	if (c->instance != NULL && ti->free) {
+		ti->free(c->instance, ti->env);
+	}
+	if (c->bit_pool != NULL) {
+		fuzz_autoshrink_free_bit_pool(t, c->bit_pool);
+	}
+	memset(c, 0x00, sizeof(*c));
+}
+
+// Forget the calls of batch candidate I, which failed, and of the ones
+// after it, which ran but whose results are thrown away.
+static bool
+forget_batch(struct fuzz* t, uint8_t arg_i, struct shrink_candidate* cands,
+		size_t i, size_t count)
+{
+	bool ok = fuzz_call_forget_called(t);
+	for (size_t j = i + 1; ok && j < count; j++) {
+		set_shrink_arg(t, arg_i, cands[j].instance, cands[j].bit_pool);
+		ok = fuzz_call_forget_called(t);
+	}
+	set_shrink_arg(t, arg_i, cands[i].instance, cands[i].bit_pool);
+	return ok;
+}
+
+// Like attempt_to_shrink_arg, but generate up to fork.shrink_workers
+// candidates at a time from the current argument, and run the property on
+// all of them at once in separate workers. Their results are then handled
+// in tactic order, as if they had been tried one at a time: the first one
+// that still fails is committed and the rest are discarded. The outcome
+// only depends on the number of shrink workers, not on which one finishes
+// first.
+static enum shrink_res
+attempt_to_shrink_arg_speculative(struct fuzz* t, uint8_t arg_i)
+{
+	struct fuzz_type_info* ti             = t->prop.type_info[arg_i];
+	const bool             use_autoshrink = ti->autoshrink_config.enable;
+	const size_t           width          = t->fork.shrink_workers;
+	struct worker_info*    workers = &t->workers[t->worker_count - width];
+
+	void*                       current          = NULL;
+	struct autoshrink_env*      as_env           = NULL;
+	struct autoshrink_bit_pool* current_bit_pool = NULL;
+	current = t->trial.args[arg_i].instance;
+	if (use_autoshrink) {
+		as_env           = t->trial.args[arg_i].u.as.env;
+		current_bit_pool = as_env->bit_pool;
+	}
+
+	struct shrink_candidate* cands = calloc(width, sizeof(*cands));
+	if (cands == NULL) {
+		return SHRINK_ERROR;
+	}
+
+	enum shrink_res res    = SHRINK_DEAD_END;
+	uint32_t        tactic = 0;
+	bool            done   = false; // out of tactics, or halting
+	while (!done && tactic < FUZZ_MAX_TACTICS) {
+		// Generate the next batch of candidates, and start their calls.
+		size_t count = 0;
+		while (count < width && tactic < FUZZ_MAX_TACTICS) {
+			struct shrink_candidate* c = &cands[count];
+			c->tactic                  = tactic++;
+			LOG(2 - LOG_SHRINK, "SHRINKING arg %u, tactic %u\n",
+					arg_i, c->tactic);
+
+			int shrink_pre_res;
+			shrink_pre_res = shrink_pre_hook(
+					t, arg_i, current, c->tactic);
+			if (shrink_pre_res == FUZZ_HOOK_RUN_HALT) {
+				res  = SHRINK_HALT;
+				done = true;
+				break;
+			} else if (shrink_pre_res != FUZZ_HOOK_RUN_CONTINUE) {
+				res = SHRINK_ERROR;
+				goto cleanup;
+			}
+
+			int sres = (use_autoshrink
+							? fuzz_autoshrink_shrink(t,
+									  as_env,
+									  c->tactic,
+									  &c->instance,
+									  &c->bit_pool)
+							: ti->shrink(t, current,
+									  c->tactic,
+									  ti->env,
+									  &c->instance));
+			t->trial.shrink_count++;
+
+			int shrink_post_res;
+			shrink_post_res = shrink_post_hook(t, arg_i,
+					sres == FUZZ_SHRINK_OK ? c->instance
+							       : current,
+					c->tactic, sres);
+			if (shrink_post_res != FUZZ_HOOK_RUN_CONTINUE) {
+				res = SHRINK_ERROR;
+				goto cleanup;
+			}
+
+			if (sres == FUZZ_SHRINK_DEAD_END) {
+				continue; // try next tactic
+			} else if (sres == FUZZ_SHRINK_NO_MORE_TACTICS) {
+				done = true;
+				break;
+			} else if (sres != FUZZ_SHRINK_OK) {
+				res = SHRINK_ERROR;
+				goto cleanup;
+			}
+
+			if (use_autoshrink) {
+				c->cur_tactic = as_env->model.cur_tactic;
+				c->cur_reward = as_env->model.cur_reward;
+			}
+
+			set_shrink_arg(t, arg_i, c->instance, c->bit_pool);
+			const bool skip = check_and_mark_called(t, arg_i);
+
+			bool started = true;
+			if (!skip) {
+				void* args[FUZZ_MAX_ARITY];
+				fuzz_trial_get_args(t, args);
+				c->worker = &workers[count];
+				started   = fuzz_call_start(t, c->worker, args);
+				if (!started) {
+					c->worker = NULL;
+				}
+			}
+			set_shrink_arg(t, arg_i, current, current_bit_pool);
+
+			if (!started) {
+				res = SHRINK_ERROR;
+				goto cleanup;
+			} else if (skip) {
+				LOG(3 - LOG_SHRINK,
+						"%s: already called, "
+						"skipping\n",
+						__func__);
+				discard_candidate(t, arg_i, c);
+				continue;
+			}
+			count++;
+		}
+
+		// Wait for all of them to finish.
+		for (size_t i = 0; i < count;) {
+			if (cands[i].worker->done) {
+				i++;
+			} else if (!fuzz_call_poll(t, workers, width)) {
+				res = SHRINK_ERROR;
+				goto cleanup;
+			}
+		}
+
+		// Use their results in tactic order.
+		for (size_t i = 0; i < count; i++) {
+			struct shrink_candidate* c = &cands[i];
+			int                      cres = c->worker->result;
+			fuzz_call_take_info(t, c->worker);
+			fuzz_call_abandon(t, c->worker); // release the worker
+			c->worker = NULL;
+
+			set_shrink_arg(t, arg_i, c->instance, c->bit_pool);
+			if (use_autoshrink) {
+				as_env->model.cur_tactic = c->cur_tactic;
+				as_env->model.cur_reward = c->cur_reward;
+			}
+
+			void* args[FUZZ_MAX_ARITY];
+			fuzz_trial_get_args(t, args);
+			bool repeated = false;
+			for (;;) {
+				if (!repeated) {
+					if (FUZZ_RESULT_IS_FAIL(cres)) {
+						t->trial.successful_shrinks++;
+					} else {
+						t->trial.failed_shrinks++;
+					}
+				}
+
+				int stpres;
+				stpres = shrink_trial_post_hook(
+						t, arg_i, args, c->tactic, cres);
+				if (stpres == FUZZ_HOOK_RUN_REPEAT ||
+						(stpres == FUZZ_HOOK_RUN_REPEAT_ONCE &&
+								!repeated)) {
+					repeated = true;
+					cres     = fuzz_call(t, args);
+					continue; // run again
+				} else if (stpres == FUZZ_HOOK_RUN_REPEAT_ONCE &&
+						repeated) {
+					break;
+				} else if (stpres == FUZZ_HOOK_RUN_CONTINUE) {
+					break;
+				} else {
+					cres = FUZZ_RESULT_ERROR;
+					break;
+				}
+			}
+
+			fuzz_autoshrink_update_model(t, arg_i, cres);
+
+			if (cres == FUZZ_RESULT_OK || cres == FUZZ_RESULT_SKIP) {
+				set_shrink_arg(t, arg_i, current,
+						current_bit_pool);
+				discard_candidate(t, arg_i, c);
+				continue;
+			}
+
+			if (FUZZ_RESULT_IS_FAIL(cres) &&
+					!forget_batch(t, arg_i, cands, i,
+							count)) {
+				cres = FUZZ_RESULT_ERROR;
+			}
+
+			// Commit the candidate (or on error, leave it in place
+			// like attempt_to_shrink_arg does), and discard the
+			// rest of the batch.
+			LOG(2 - LOG_SHRINK,
+					"%s: COMMITTING %u: tactic %u, res %d\n",
+					__func__, arg_i, c->tactic, cres);
+			const bool committed = commit_shrink_arg(
+					t, arg_i, current, current_bit_pool);
+			memset(c, 0x00, sizeof(*c));
+			if (!committed) {
+				res = SHRINK_ERROR;
+				goto cleanup;
+			}
+			memcpy(&t->fail_call_info, &t->call_info,
+					sizeof(t->fail_call_info));
+			t->fail_result = cres;
+			res = (FUZZ_RESULT_IS_FAIL(cres) ? SHRINK_OK
+							 : SHRINK_ERROR);
+			goto cleanup;
+		}
+	}
+
+cleanup:
+	for (size_t i = 0; i < width; i++) {
+		discard_candidate(t, arg_i, &cands[i]);
+	}
+	free(cands);
+	return res;
+}
+
 static int
 shrink_pre_hook(struct fuzz* t, uint8_t arg_index, void* arg, uint32_t tactic)
 {
 	if (t->hooks.shrink_pre != NULL) {
+		fuzz_run_lock(t);
 		struct fuzz_pre_shrink_info hook_info = {
 				.prop_name    = t->prop.name,
 				.total_trials = t->prop.trial_count,
@@ -5894,7 +11248,9 @@ shrink_pre_hook(struct fuzz* t, uint8_t arg_index, void* arg, uint32_t tactic)
 				.arg            = arg,
 				.tactic         = tactic,
 		};
-		return t->hooks.shrink_pre(&hook_info, t->hooks.env);
+		const int res = t->hooks.shrink_pre(&hook_info, t->hooks.env);
+		fuzz_run_unlock(t);
+		return res;
 	} else {
 		return FUZZ_HOOK_RUN_CONTINUE;
 	}
@@ -5921,6 +11277,7 @@ shrink_post_hook(struct fuzz* t, uint8_t arg_index, void* arg, uint32_t tactic,
 			return FUZZ_HOOK_RUN_ERROR;
 		}
 
+		fuzz_run_lock(t);
 		struct fuzz_post_shrink_info hook_info = {
 				.prop_name    = t->prop.name,
 				.total_trials = t->prop.trial_count,
@@ -5937,7 +11294,9 @@ shrink_post_hook(struct fuzz* t, uint8_t arg_index, void* arg, uint32_t tactic,
 				.tactic         = tactic,
 				.state          = state,
 		};
-		return t->hooks.shrink_post(&hook_info, t->hooks.env);
+		const int res = t->hooks.shrink_post(&hook_info, t->hooks.env);
+		fuzz_run_unlock(t);
+		return res;
 	} else {
 		return FUZZ_HOOK_RUN_CONTINUE;
 	}
@@ -5948,6 +11307,7 @@ shrink_trial_post_hook(struct fuzz* t, uint8_t arg_index, void** args,
 		uint32_t last_tactic, int result)
 {
 	if (t->hooks.shrink_trial_post != NULL) {
+		fuzz_run_lock(t);
 		struct fuzz_post_shrink_trial_info hook_info = {
 				.prop_name    = t->prop.name,
 				.total_trials = t->prop.trial_count,
@@ -5965,7 +11325,10 @@ shrink_trial_post_hook(struct fuzz* t, uint8_t arg_index, void** args,
 				.tactic         = last_tactic,
 				.result         = result,
 		};
-		return t->hooks.shrink_trial_post(&hook_info, t->hooks.env);
+		const int res = t->hooks.shrink_trial_post(
+				&hook_info, t->hooks.env);
+		fuzz_run_unlock(t);
+		return res;
 	} else {
 		return FUZZ_HOOK_RUN_CONTINUE;
 	}
@@ -5973,6 +11336,7 @@ shrink_trial_post_hook(struct fuzz* t, uint8_t arg_index, void** args,
 // SPDX-License-Identifier: ISC
 // SPDX-FileCopyrightText: 2014-19 Scott Vokes <vokes.s@gmail.com>
 #include <assert.h>
+#include <stdarg.h>
 #include <string.h>
 
 #if (-1 & 3) != 3
@@ -5988,6 +11352,21 @@ fuzz_set_output_stream(struct fuzz* t, FILE* out)
 	t->out = out;
 }
 
+void
+fuzz_diag(struct fuzz* t, const char* fmt, ...)
+{
+	struct fuzz_call_info* info = t->call_out;
+	if (info == NULL) {
+		return; // not in a call
+	}
+
+	const size_t used = strlen(info->diag);
+	va_list      args;
+	va_start(args, fmt);
+	vsnprintf(info->diag + used, sizeof(info->diag) - used, fmt, args);
+	va_end(args);
+}
+
 // Run a series of randomized trials of a property function.
 //
 // Configuration is specified in CFG; many fields are optional.
@@ -6094,8 +11473,16 @@ static int report_on_failure(struct fuzz*    t,
 		struct fuzz_post_trial_info* hook_info,
 		fuzz_hook_trial_post_cb* trial_post, void* trial_post_env);
 
+static bool record_failure(struct fuzz* t);
+
+static void count_failure(struct fuzz* t, int res);
+
 fuzz_hook_trial_post_cb def_trial_post_cb;
 
+// With the counter schedule, mixed into a failing trial's seed to seed the
+// PRNG used for shrinking it.
+#define SHRINK_SEED_SALT 0x9e3779b97f4a7c15LLU
+
 // Now that arguments have been generated, run the trial and update
 // counters, call cb with results, etc.
 bool
@@ -6103,15 +11490,20 @@ fuzz_trial_run(struct fuzz* t, int* tpres)
 {
 	assert(t->prop.arity > 0);
 
-	if (t->bloom) {
-		fuzz_call_mark_called(t);
-	}
+	void* args[FUZZ_MAX_ARITY];
+	fuzz_trial_get_args(t, args);
+
+	int tres = fuzz_call(t, args);
+	return fuzz_trial_handle_result(t, tres, tpres);
+}
 
+bool
+fuzz_trial_handle_result(struct fuzz* t, int tres, int* tpres)
+{
 	void* args[FUZZ_MAX_ARITY];
 	fuzz_trial_get_args(t, args);
 
 	bool                     repeated   = false;
-	int                      tres       = fuzz_call(t, args);
 	fuzz_hook_trial_post_cb* trial_post = t->hooks.trial_post;
 	void* trial_post_env = (trial_post == fuzz_hook_trial_post_print_result
 						? t->print_trial_result_env
@@ -6127,9 +11519,14 @@ fuzz_trial_run(struct fuzz* t, int* tpres)
 			.arity        = t->prop.arity,
 			.args         = args,
 			.result       = tres,
+			.call         = &t->call_info,
 	};
 
-	switch (tres) {
+	// On a thread's handle, hold the run's lock for the counters, report
+	// and hooks, but not while shrinking, so other threads can carry on.
+	bool res = true;
+	fuzz_run_lock(t);
+	switch (FUZZ_RESULT_IS_FAIL(tres) ? FUZZ_RESULT_FAIL : tres) {
 	case FUZZ_RESULT_OK:
 		if (!repeated) {
 			t->counters.pass++;
@@ -6137,7 +11534,26 @@ fuzz_trial_run(struct fuzz* t, int* tpres)
 		*tpres = trial_post(&hook_info, trial_post_env);
 		break;
 	case FUZZ_RESULT_FAIL:
-		if (!fuzz_shrink(t)) {
+		fuzz_run_unlock(t);
+		// With the counter schedule, shrink with a PRNG stream that
+		// only depends on this trial, so the result doesn't depend on
+		// whatever trials were generated in the meantime. With the
+		// chained schedule, carry on with the trial's own stream,
+		// which the next trial's seed is then drawn from.
+		if (t->seeds.schedule == FUZZ_SEED_SCHEDULE_COUNTER) {
+			fuzz_random_set_seed(
+					t, t->trial.seed ^ SHRINK_SEED_SALT);
+		}
+		memcpy(&t->fail_call_info, &t->call_info,
+				sizeof(t->fail_call_info));
+		t->fail_result = tres;
+		hook_info.call = &t->fail_call_info;
+		if (!fuzz_call_forget_called(t)) {
+			return false;
+		}
+		const bool shrunk = fuzz_shrink(t);
+		fuzz_run_lock(t);
+		if (!shrunk) {
 			hook_info.result = FUZZ_RESULT_ERROR;
 			// We may not have a valid reference to the arguments
 			// anymore, so remove the stale pointers.
@@ -6145,11 +11561,18 @@ fuzz_trial_run(struct fuzz* t, int* tpres)
 				hook_info.args[i] = NULL;
 			}
 			*tpres = trial_post(&hook_info, trial_post_env);
-			return false;
+			res    = false;
+			break;
 		}
 
+		// The shrunk arguments can fail differently.
+		hook_info.result = t->fail_result;
 		if (!repeated) {
-			t->counters.fail++;
+			count_failure(t, t->fail_result);
+			if (!record_failure(t)) {
+				res = false;
+				break;
+			}
 		}
 
 		fuzz_trial_get_args(t, hook_info.args);
@@ -6166,10 +11589,12 @@ fuzz_trial_run(struct fuzz* t, int* tpres)
 		// user callback should not return this; fall through
 	case FUZZ_RESULT_ERROR:
 		*tpres = trial_post(&hook_info, trial_post_env);
-		return false;
+		res    = false;
+		break;
 	}
+	fuzz_run_unlock(t);
 
-	if (*tpres == FUZZ_HOOK_RUN_ERROR) {
+	if (!res || *tpres == FUZZ_HOOK_RUN_ERROR) {
 		return false;
 	}
 
@@ -6200,6 +11625,48 @@ fuzz_trial_get_args(struct fuzz* t, void** args)
 	}
 }
 
+// Save the failing trial's seed for the run's report, if requested.
+static bool
+record_failure(struct fuzz* t)
+{
+	struct failure_log* log = t->failures;
+	if (log == NULL) {
+		return true;
+	}
+
+	if (log->count == log->ceil) {
+		const size_t nceil = (log->ceil == 0 ? 8 : 2 * log->ceil);
+		struct fuzz_failure* nfailures =
+				realloc(log->failures, nceil * sizeof(*nfailures));
+		if (nfailures == NULL) {
+			return false;
+		}
+		log->failures = nfailures;
+		log->ceil     = nceil;
+	}
+
+	log->failures[log->count++] = (struct fuzz_failure){
+			.trial_id   = (size_t)t->trial.trial,
+			.trial_seed = t->trial.seed,
+			.result     = t->fail_result,
+	};
+	return true;
+}
+
+// Count a failure, and the kind of failure it was.
+static void
+count_failure(struct fuzz* t, int res)
+{
+	t->counters.fail++;
+	if (res == FUZZ_RESULT_TIMEOUT) {
+		t->counters.timeout++;
+	} else if (res == FUZZ_RESULT_OOM) {
+		t->counters.oom++;
+	} else if (FUZZ_RESULT_IS_CRASH(res)) {
+		t->counters.crash++;
+	}
+}
+
 // Print info about a failure.
 static int
 report_on_failure(struct fuzz* t, struct fuzz_post_trial_info* hook_info,
@@ -6232,7 +11699,11 @@ report_on_failure(struct fuzz* t, struct fuzz_post_trial_info* hook_info,
 		hook_info->repeat = true;
 
 		int tres = fuzz_call(t, hook_info->args);
-		if (tres == FUZZ_RESULT_FAIL) {
+		if (FUZZ_RESULT_IS_FAIL(tres)) {
+			memcpy(&t->fail_call_info, &t->call_info,
+					sizeof(t->fail_call_info));
+			t->fail_result    = tres;
+			hook_info->result = tres;
 			res = trial_post(hook_info, t->hooks.env);
 			if (res == FUZZ_HOOK_RUN_REPEAT_ONCE) {
 				break;
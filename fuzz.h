@@ -30,6 +30,62 @@ struct fuzz_run_report {
 	size_t fail;
 	size_t skip;
 	size_t dup;
+
+	// Failures that were timeouts, out of memory, or crashes. These are
+	// also counted in fail.
+	size_t timeout;
+	size_t oom;
+	size_t crash;
+};
+
+// A failing trial, which can be run again on its own with its seed.
+struct fuzz_failure {
+	size_t   trial_id;
+	uint64_t trial_seed;
+	int      result; // FUZZ_RESULT_FAIL, _TIMEOUT, _OOM or _CRASH(sig)
+};
+
+// Report of a run, or of several shards of one run merged together with
+// fuzz_report_merge.
+struct fuzz_report {
+	uint64_t               run_seed;
+	size_t                 shard_count;   // shards the run was split into
+	size_t                 shards;        // shards merged into this report
+	size_t*                shard_indices; // which shards, ascending
+	struct fuzz_run_report report;
+
+	// Failing trials, ordered by trial_id.
+	size_t               failure_count;
+	struct fuzz_failure* failures;
+};
+
+// How a run's bloom filter, which skips trials whose arguments were already
+// tried, was sized and used. It's a table of fingerprints of the arguments'
+// hashes, in lines of slots the size of a cache line. Each entry goes in
+// its home line, or if that's full, one of the next few lines, so these
+// lines are like a short hash chain.
+struct fuzz_dedup_stats {
+	bool    enabled;          // false if some argument can't be hashed
+	bool    shared;           // shared between threads
+	size_t  bytes;            // memory used by the table
+	size_t  lines;            // lines in the table
+	size_t  slots;            // slots in the table
+	size_t  used;             // slots used, one per entry
+	size_t  full_lines;       // lines with no free slots left
+	size_t  displaced[4];     // entries 0, 1, 2 and 3 lines past home
+	size_t  grows;            // times the table doubled in size
+	size_t  forgotten;        // entries that didn't fit, so may run again
+	uint8_t fingerprint_bits; // bits kept of each entry's hash
+
+	size_t checks; // arguments checked, including while shrinking
+	size_t hits;   // checks that found them, e.g. DUP trials
+
+	uint32_t fill_ppm; // used / slots, in millionths
+	uint32_t hit_ppm;  // hits / checks, in millionths
+	// Estimated odds of arguments being wrongly found, as one in this
+	// many, or 0 if the table is empty: a false positive, which skips a
+	// trial that wasn't actually tried.
+	uint64_t fp_one_in;
 };
 
 #define FUZZ_RESULT_OK        (0) // No failure
@@ -40,6 +96,20 @@ struct fuzz_run_report {
 #define FUZZ_RESULT_ERROR_MEMORY (-1) // Memory allocation failure
 #define FUZZ_RESULT_ERROR        (-2)
 
+// Ways a call in a worker process can fail without returning. These are
+// never returned by property functions, but are passed to hooks in place of
+// FUZZ_RESULT_FAIL and count as failures in the same way. Use
+// FUZZ_RESULT_IS_FAIL to check for any kind of failure.
+#define FUZZ_RESULT_TIMEOUT (4) // exceeded fork.timeout or fork.cpu_limit
+#define FUZZ_RESULT_OOM     (5) // ran out of memory
+#define FUZZ_RESULT_CRASH(SIGNAL) (0x100 + (SIGNAL)) // killed by SIGNAL
+
+#define FUZZ_RESULT_IS_CRASH(RES)     ((RES) >= 0x100)
+#define FUZZ_RESULT_CRASH_SIGNAL(RES) ((RES)-0x100)
+#define FUZZ_RESULT_IS_FAIL(RES)                                               \
+	((RES) == FUZZ_RESULT_FAIL || (RES) == FUZZ_RESULT_TIMEOUT ||          \
+			(RES) == FUZZ_RESULT_OOM || FUZZ_RESULT_IS_CRASH(RES))
+
 // Default number of trials to run.
 #define FUZZ_DEF_TRIALS 100
 
@@ -54,6 +124,47 @@ struct fuzz_run_report {
 // be given to terminate and exit before sending kill(pid, SIGKILL).
 #define FUZZ_DEF_EXIT_TIMEOUT_MSEC 100
 
+// How many trials a persistent worker process runs before being replaced by
+// a fresh one, by default.
+#define FUZZ_DEF_PERSISTENT_CALLS 1000
+
+// Which PRNG backend runs use when `fuzz_run_config.rng` is
+// FUZZ_RNG_DEFAULT. Define this as FUZZ_RNG_MT19937 when building the library
+// to make every run reproduce seeds saved by earlier releases.
+#ifndef FUZZ_DEF_RNG
+#define FUZZ_DEF_RNG FUZZ_RNG_XOSHIRO256
+#endif
+
+// Size of the buffer filled by `fuzz_diag`, including the terminating 0.
+#define FUZZ_CALL_DIAG_SIZE 256
+
+// Measurements from a single call of the property function. When forking,
+// the worker process writes these to memory shared with the parent, so they
+// survive the worker crashing or being killed.
+struct fuzz_call_info {
+	// Time spent in the property function, and peak RSS of the process
+	// that called it. Both are 0 if the call didn't return.
+	//
+	// The peak RSS is the process's peak over its whole lifetime so far,
+	// from getrusage(2), not just during this call: a persistent
+	// worker's includes its earlier calls, a worker forked for each call
+	// may start from the parent's, and without forking it's the peak of
+	// the test process itself. Only a rise from one call to the next is
+	// sure to come from the later call.
+	uint64_t duration_usec;
+	size_t   max_rss_kb;
+
+	// If the worker process crashed, the signal that killed it, and
+	// errno and the faulting address (si_addr, for faults such as
+	// SIGSEGV) when it was caught. Otherwise 0.
+	int       crash_signal;
+	uintptr_t crash_addr;
+	int       crash_errno;
+
+	// Text written by the property function with `fuzz_diag`.
+	char diag[FUZZ_CALL_DIAG_SIZE];
+};
+
 // This struct contains callbacks used to specify how to allocate, free, hash,
 // print, and/or shrink the property test input.
 //
@@ -111,12 +222,39 @@ struct fuzz_autoshrink_config {
 	size_t                          pool_size;
 	enum fuzz_autoshrink_print_mode print_mode;
 
-	// How many unsuccessful shrinking attempts to try in a row before
-	// deciding a local minimum has been reached.
+	// How unlikely shrinking attempts need to get before deciding a
+	// local minimum has been reached: autoshrinking stops once its
+	// running estimate of the odds of an attempt succeeding falls below
+	// 1 in max_failed_shrinks, and no more requests can be deleted
+	// systematically.
 	// Default: DEF_MAX_FAILED_SHRINKS.
 	size_t max_failed_shrinks;
 };
 
+// Tactics autoshrinking chooses between for each shrinking attempt.
+enum fuzz_autoshrink_tactic {
+	FUZZ_AUTOSHRINK_TACTIC_DROP,  // drop random requests
+	FUZZ_AUTOSHRINK_TACTIC_SHIFT, // shift requests' bits right
+	FUZZ_AUTOSHRINK_TACTIC_MASK,  // clear random bits
+	FUZZ_AUTOSHRINK_TACTIC_SWAP,  // swap requests into order
+	FUZZ_AUTOSHRINK_TACTIC_SUB,   // subtract from requests
+	FUZZ_AUTOSHRINK_TACTIC_DDMIN, // delete runs of requests in turn
+	FUZZ_AUTOSHRINK_TACTIC_COUNT,
+};
+
+// How often each autoshrink tactic has been tried on each of a property's
+// arguments, and the rewards it earned for shrinks that still failed: 1,
+// plus up to FUZZ_AUTOSHRINK_MAX_REWARD - 1 more in proportion to how much
+// of the input's random bits the shrink did away with. Tactics that earn
+// more per try are tried more often. Older counts are halved as new ones
+// come in, so the weights keep adapting.
+#define FUZZ_AUTOSHRINK_MAX_REWARD 16
+
+struct fuzz_autoshrink_weights {
+	uint32_t tries[FUZZ_MAX_ARITY][FUZZ_AUTOSHRINK_TACTIC_COUNT];
+	uint32_t rewards[FUZZ_MAX_ARITY][FUZZ_AUTOSHRINK_TACTIC_COUNT];
+};
+
 // Callbacks used for testing with random instances of a type.
 // For more information, see comments on their typedefs.
 struct fuzz_type_info {
@@ -260,6 +398,10 @@ struct fuzz_post_trial_info {
 	void**       args;
 	int          result;
 	bool         repeat;
+
+	// The property function's call, or NULL if it wasn't called (the
+	// result is SKIP, DUPLICATE or ERROR from generating arguments).
+	const struct fuzz_call_info* call;
 };
 
 // The default post-trial hook. Calls `fuzz_print_trial_result` with an
@@ -361,6 +503,33 @@ struct fuzz_post_shrink_trial_info {
 	int         result;
 };
 
+// How each trial's seed is chosen, after any always_seeds.
+enum fuzz_seed_schedule {
+	// Each trial's seed is drawn from the PRNG once the previous trial
+	// has finished, after whatever generating, calling and shrinking it
+	// drew, so reaching trial N means running all the trials before it.
+	// This is the default, and what seeds from earlier runs expect.
+	FUZZ_SEED_SCHEDULE_CHAINED = 0,
+	// Trial N's seed is fuzz_trial_seed(seed, N), so any trial can be
+	// generated on its own.
+	FUZZ_SEED_SCHEDULE_COUNTER = 1,
+};
+
+// Pseudorandom number generator behind a run's random bits. Each backend
+// gives a different stream for the same seed, so saved seeds only reproduce
+// a failure when run with the backend that found them.
+enum fuzz_rng_kind {
+	// FUZZ_DEF_RNG, which is FUZZ_RNG_XOSHIRO256 unless the library was
+	// built with it defined otherwise.
+	FUZZ_RNG_DEFAULT = 0,
+	// xoshiro256**: 32 bytes of state and constant-time seeding.
+	FUZZ_RNG_XOSHIRO256 = 1,
+	// 64-bit Mersenne Twister, which every run used before xoshiro256**
+	// became the default. Reseeding it for each trial fills 2.5 KB of
+	// state, but it reproduces seeds saved by earlier releases.
+	FUZZ_RNG_MT19937 = 2,
+};
+
 // Configuration struct for a fuzz run.
 struct fuzz_run_config {
 	// A test property function.
@@ -405,21 +574,178 @@ struct fuzz_run_config {
 	// Seed for the random number generator.
 	uint64_t seed;
 
+	// How each trial's seed is derived from `seed`. Defaults to
+	// FUZZ_SEED_SCHEDULE_CHAINED.
+	enum fuzz_seed_schedule seed_schedule;
+
+	// PRNG backend. Defaults to FUZZ_DEF_RNG.
+	enum fuzz_rng_kind rng;
+
+	// Only run one shard of the trials, so several processes can split a
+	// run between them without overlapping: out of `trials` trials,
+	// shard K of N runs trials K, K+N, K+2N, and so on. Sharded runs
+	// always use FUZZ_SEED_SCHEDULE_COUNTER. A shard_count of 0 or 1 runs
+	// all of the trials. See also fuzz_parse_shard.
+	size_t shard_index;
+	size_t shard_count;
+
+	// If non-NULL, this is filled in with a report of the run and its
+	// failing seeds when the run finishes without error. Shards' reports
+	// can be saved with fuzz_report_write and combined with
+	// fuzz_report_merge. Free it with fuzz_report_free.
+	struct fuzz_report* report;
+
+	// If non-NULL, autoshrinking starts from these tactic weights,
+	// rather than learning them from scratch, and updates them as it
+	// goes. Since they depend on the property and its argument types,
+	// each property should have its own. They can be saved between runs
+	// with fuzz_autoshrink_weights_write.
+	struct fuzz_autoshrink_weights* autoshrink_weights;
+
 	// Bits to use for the bloom filter -- this field is no longer used,
-	// and will be removed in a future release.
+	// and will be removed in a future release. See dedup_max_bytes.
 	uint8_t bloom_bits;
 
+	// Most memory the bloom filter that skips trials whose arguments
+	// were already tried can use, in bytes, or 0 for no limit. The
+	// filter is sized for `trials`, and doubles in size as it fills up,
+	// so this keeps it from growing past the limit; once it would, new
+	// entries go in the remaining free slots, and those that don't fit
+	// are forgotten, so their arguments may be run again. Each 64
+	// bytes holds up to 16 entries, and it uses at least 128 bytes.
+	size_t dedup_max_bytes;
+
+	// If non-NULL, this is filled in with stats about the bloom filter
+	// when the run is freed. Print them with fuzz_print_dedup_stats.
+	struct fuzz_dedup_stats* dedup_stats;
+
+	// If non-NULL, the bloom filter that skips trials whose arguments
+	// were already tried is loaded from this file when the run starts,
+	// and saved back to it when the run is freed, so later runs skip
+	// arguments that earlier ones already tried, too. Trials from
+	// always_seeds are never skipped. Arguments that failed (including
+	// while shrinking) are left out of the saved filter, so they're tried
+	// again next time. A saved filter larger than dedup_max_bytes is
+	// ignored.
+	//
+	// The file is keyed by the property's name and what fuzz can tell
+	// about its arguments' types, and is replaced if those don't match.
+	// It can't tell what a type_info's env does, though, so if that
+	// changes how arguments are generated -- say, a builtin type's
+	// limit -- use another file. Runs on the same seed generate the
+	// same arguments, so to try new ones there, raise `trials` each
+	// time: skipping the trials already tried only costs generating
+	// their arguments. Shards of a run should each have their own file.
+	const char* dedup_path;
+
+	// Number of threads to run trials on, in-process. 0 or 1 runs one
+	// trial at a time. Ignored when forking (see fork.workers), and on
+	// platforms without threads.
+	//
+	// Each thread has its own `struct fuzz`, with its own PRNG and trial
+	// state, so the property function and type_info callbacks must be
+	// safe to call from several threads at once. Hooks are never called
+	// concurrently. Halting stops new trials from being started; ones
+	// already running on other threads still finish.
+	//
+	// With FUZZ_SEED_SCHEDULE_CHAINED, arguments are still generated
+	// one trial at a time, in order, and trials are reported in trial
+	// order, so a run gets the same results and counterexamples as a
+	// serial one. Trials are started before the ones before them have
+	// finished, assuming they won't fail. When one does, shrinking it
+	// changes the seeds of the trials after it, so those are dropped
+	// and started again, and their pre_gen_args and pre_trial hooks can
+	// be called more than once.
+	//
+	// With FUZZ_SEED_SCHEDULE_COUNTER, threads generate arguments and
+	// shrink failures in parallel too, and trials from different threads
+	// may be reported out of trial order. Trials get the same seeds and
+	// results as in a serial run, but which trials are counted as
+	// duplicates can vary from run to run, and so can shrunk
+	// counterexamples, since shrinking skips arguments the bloom filter
+	// has already seen, from whichever trials got there first, and
+	// autoshrinking learns from every thread's shrinks as they happen.
+	size_t threads;
+
 	// Fork before running the property test, in case generated arguments
 	// can cause the code under test to crash.
 	struct {
 		bool   enable;
 		size_t timeout; // in milliseconds (or 0, for none)
+		// Once a few calls have passed, time out calls that take more
+		// than this many times as long as recent passing calls did on
+		// average, so inputs that are unusually slow are reported as
+		// FUZZ_RESULT_TIMEOUT. The timeout never exceeds the one
+		// above, if set. 0 disables this.
+		//
+		// Since this depends on timing, which trials time out can
+		// vary from run to run.
+		size_t adaptive_timeout;
 		// signal to send after timeout, defaults to SIGTERM
 		int signal;
 		// For workers sent a timeout signal, how long should fuzz
 		// wait for them to actually exit (in msec). Defaults to
 		// FUZZ_DEF_EXIT_TIMEOUT_MSEC.
 		size_t exit_timeout;
+		// Number of worker processes running trials at once. 0 or 1
+		// runs one trial at a time.
+		//
+		// With more than one worker, arguments are generated and
+		// calls are started in trial order as workers become free,
+		// but trials are retired strictly in trial order: counters,
+		// shrinking, and the pre-trial, counter-example, and
+		// post-trial hooks see the same sequence regardless of which
+		// worker finishes first. The pre-trial hook is called just
+		// before a trial's result is used, so its property call may
+		// already have run; halting there discards that result and
+		// any later trials still in flight.
+		//
+		// With FUZZ_SEED_SCHEDULE_CHAINED, trials are started before
+		// the ones before them have finished, assuming they won't
+		// fail. When one does, shrinking it changes the seeds of the
+		// trials after it, so those are dropped and started again,
+		// and their pre_gen_args hook can be called more than once.
+		size_t workers;
+		// Keep worker processes running between trials, rather than
+		// forking one for every trial. Each worker is forked once,
+		// then sent the seed of each trial to run, regenerates its
+		// arguments, and reports the result back. It is only replaced
+		// after it crashes, times out, or has run persistent_calls
+		// trials.
+		//
+		// While shrinking, autoshrinking arguments are sent as their
+		// bit pools; if any argument uses its own shrink callback,
+		// shrinking forks for every trial, as usual.
+		//
+		// The type_info callbacks must generate the same arguments
+		// from the same seed in the worker as they do in the parent,
+		// so they shouldn't depend on state changed in the parent
+		// after the worker started. The post-fork hook is called
+		// before each trial, not just once per worker.
+		bool persistent;
+		// Defaults to FUZZ_DEF_PERSISTENT_CALLS.
+		size_t persistent_calls;
+		// Limit each worker's address space to this many bytes more
+		// than it had when it was forked (RLIMIT_AS), and each call's
+		// CPU time to this many seconds (RLIMIT_CPU). 0 means no
+		// limit. (Where the address space's size isn't known, the
+		// memory limit is the whole size.) Calls that run out of
+		// memory fail with FUZZ_RESULT_OOM, and calls that run out of
+		// CPU time with FUZZ_RESULT_TIMEOUT.
+		//
+		// Sanitizers reserve far more address space than they use,
+		// so memory_limit usually can't be used with them.
+		size_t memory_limit;
+		size_t cpu_limit;
+		// While shrinking, generate this many candidates at a time,
+		// and run the property on all of them at once, each in its
+		// own worker. 0 or 1 tries one candidate at a time.
+		//
+		// Candidates are still judged in tactic order: the first one
+		// that fails is kept and the rest are thrown away, so results
+		// are deterministic for a given number of shrink workers,
+		// though they can differ from shrinking one at a time.
+		size_t shrink_workers;
 	} fork;
 
 	// These functions are called in several contexts to report on
@@ -484,20 +810,41 @@ void fuzz_random_bits_bulk(struct fuzz* t, uint32_t bits, uint64_t* buf);
 // Get a random double from the test runner's PRNG.
 FUZZ_PUBLIC
 double fuzz_random_double(struct fuzz* t);
+#endif
 
 // Get a random uint64_t less than CEIL.
 // For example, `fuzz_random_choice(t, 5)` will return
-// approximately evenly distributed values from [0, 1, 2, 3, 4].
+// evenly distributed values from [0, 1, 2, 3, 4]. Fewer random bits give
+// smaller values, so autoshrinking moves choices towards 0.
 FUZZ_PUBLIC
 uint64_t fuzz_random_choice(struct fuzz* t, uint64_t ceil);
 
 // Get a random uint64_t in the range [min, max].
-// For example, `fuzz_random_range(f, 7, 18)` will return approximately evenly
+// For example, `fuzz_random_range(f, 7, 18)` will return evenly
 // distributed values from [7, 8, 9, 10, 11, 12, 13, 14, 15, 16, 17, 18].
 FUZZ_PUBLIC
 uint64_t fuzz_random_range(
 		struct fuzz* f, const uint64_t min, const uint64_t max);
-#endif
+
+// Fill OUT with COUNT random values in the range [min, max], drawing their
+// bits from the PRNG at once. Each value is generated the same way as by
+// `fuzz_random_range`, except that the rare biased samples are not redrawn,
+// so this usually gives the same values as calling it COUNT times. When
+// autoshrinking, the whole array is recorded as one large request (or a few,
+// for very large arrays) rather than one request per value, and shrinking
+// its bits still makes individual values smaller.
+FUZZ_PUBLIC
+void fuzz_random_range_bulk_u8(struct fuzz* t, uint8_t min, uint8_t max,
+		size_t count, uint8_t* out);
+FUZZ_PUBLIC
+void fuzz_random_range_bulk_u16(struct fuzz* t, uint16_t min, uint16_t max,
+		size_t count, uint16_t* out);
+FUZZ_PUBLIC
+void fuzz_random_range_bulk_u32(struct fuzz* t, uint32_t min, uint32_t max,
+		size_t count, uint32_t* out);
+FUZZ_PUBLIC
+void fuzz_random_range_bulk_u64(struct fuzz* t, uint64_t min, uint64_t max,
+		size_t count, uint64_t* out);
 
 // Hash a buffer in one pass. (Wraps the below functions.)
 FUZZ_PUBLIC uint64_t fuzz_hash_onepass(const uint8_t* data, size_t bytes);
@@ -515,6 +862,12 @@ void fuzz_hash_sink(uint64_t* h, const uint8_t* data, size_t bytes);
 FUZZ_PUBLIC
 uint64_t fuzz_hash_finish(uint64_t* h);
 
+// Hash a buffer in one pass into two words, res[0] and res[1]. This reads
+// the buffer a word at a time, so it's much faster than the functions above
+// on large buffers, and gives different hashes.
+FUZZ_PUBLIC
+void fuzz_hash128_onepass(const uint8_t* data, size_t bytes, uint64_t res[2]);
+
 // Print a trial result in the default format.
 //
 // To use this, add a `struct fuzz_print_trial_result_env` to the env in the
@@ -550,6 +903,52 @@ void fuzz_print_pre_run_info(FILE* f, const struct fuzz_pre_run_info* info);
 FUZZ_PUBLIC
 void fuzz_print_post_run_info(FILE* f, const struct fuzz_post_run_info* info);
 
+// Print stats about a run's bloom filter.
+FUZZ_PUBLIC
+void fuzz_print_dedup_stats(FILE* f, const struct fuzz_dedup_stats* stats);
+
+// Parse a shard given as "K/N", as in `--shard K/N`, into *INDEX and *COUNT.
+// Returns false if STR isn't of that form with K < N.
+FUZZ_PUBLIC
+bool fuzz_parse_shard(const char* str, size_t* index, size_t* count);
+
+// Write REPORT to F, in a text format fuzz_report_read can parse. Returns
+// false on error, or if REPORT doesn't say which shards it has, as with
+// some reports read from older versions.
+FUZZ_PUBLIC
+bool fuzz_report_write(FILE* f, const struct fuzz_report* report);
+
+// Read a report written by fuzz_report_write from F into *REPORT. Returns
+// false if it couldn't be read; otherwise it must be freed with
+// fuzz_report_free.
+FUZZ_PUBLIC
+bool fuzz_report_read(FILE* f, struct fuzz_report* report);
+
+// Add the counts and failures of SRC, from other shards of the same run, to
+// DST. Returns false, leaving DST unchanged, if they have different run
+// seeds or shard counts, if they have any shard in common (say, the same
+// report is merged twice), or on allocation failure. Reports written by
+// versions that didn't record which shards they have can't be merged.
+FUZZ_PUBLIC
+bool fuzz_report_merge(struct fuzz_report* dst, const struct fuzz_report* src);
+
+// Free the failures and shard indices in REPORT.
+FUZZ_PUBLIC
+void fuzz_report_free(struct fuzz_report* report);
+
+// Write WEIGHTS to F, in a text format fuzz_autoshrink_weights_read can
+// parse. Returns false on error.
+FUZZ_PUBLIC
+bool fuzz_autoshrink_weights_write(
+		FILE* f, const struct fuzz_autoshrink_weights* weights);
+
+// Read weights written by fuzz_autoshrink_weights_write from F into
+// *WEIGHTS. Returns false, leaving *WEIGHTS unchanged, if they couldn't be
+// read.
+FUZZ_PUBLIC
+bool fuzz_autoshrink_weights_read(
+		FILE* f, struct fuzz_autoshrink_weights* weights);
+
 // Halt trials after the first failure.
 FUZZ_PUBLIC
 int fuzz_hook_first_fail_halt(
@@ -564,10 +963,23 @@ void* fuzz_hook_get_env(struct fuzz* t);
 FUZZ_PUBLIC
 void fuzz_set_output_stream(struct fuzz* t, FILE* out);
 
+// Append printf-style text to the current call's diagnostic buffer, which is
+// passed to the post-trial hook as `info->call->diag`. Text past
+// FUZZ_CALL_DIAG_SIZE is dropped. This only makes sense from inside the
+// property function, and works whether or not it runs in a worker process.
+FUZZ_PUBLIC
+void fuzz_diag(struct fuzz* t, const char* fmt, ...);
+
 // Get a seed based on the hash of the current timestamp.
 FUZZ_PUBLIC
 uint64_t fuzz_seed_of_time(void);
 
+// Get the seed used by trial TRIAL_ID of a run with RUN_SEED, with
+// FUZZ_SEED_SCHEDULE_COUNTER. (Trials that use always_seeds are counted
+// too, so the first trial after 3 always_seeds is trial 3.)
+FUZZ_PUBLIC
+uint64_t fuzz_trial_seed(uint64_t run_seed, size_t trial_id);
+
 // Generic free callback: just call free(instance).
 FUZZ_PUBLIC
 void fuzz_generic_free_cb(void* instance, void* env);
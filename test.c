@@ -0,0 +1,691 @@
+// Regression tests. Build and run them with:
+//
+//     cc -o test test.c -lm -lpthread && ./test
+//
+// Each test prints its name and any check that failed. The exit status is
+// the number of tests that failed.
+#include <inttypes.h>
+#include <signal.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "fuzz.c"
+
+#define CHECK(COND)                                                            \
+	do {                                                                   \
+		if (!(COND)) {                                                 \
+			printf("    %s:%d: check failed: %s\n", __FILE__,     \
+					__LINE__, #COND);                      \
+			return false;                                          \
+		}                                                              \
+	} while (0)
+
+static int
+quiet_pre_run(const struct fuzz_pre_run_info* info, void* env)
+{
+	(void)info;
+	(void)env;
+	return FUZZ_HOOK_RUN_CONTINUE;
+}
+
+static int
+quiet_trial_post(const struct fuzz_post_trial_info* info, void* env)
+{
+	(void)info;
+	(void)env;
+	return FUZZ_HOOK_RUN_CONTINUE;
+}
+
+static int
+quiet_post_run(const struct fuzz_post_run_info* info, void* env)
+{
+	(void)info;
+	(void)env;
+	return FUZZ_HOOK_RUN_CONTINUE;
+}
+
+static int
+quiet_counterexample(const struct fuzz_counterexample_info* info, void* env)
+{
+	(void)info;
+	(void)env;
+	return FUZZ_HOOK_RUN_CONTINUE;
+}
+
+// Fails for about one argument in eight.
+static int
+sometimes_fails(struct fuzz* f, void* arg)
+{
+	(void)f;
+	const uint64_t x = *(uint64_t*)arg;
+	return (x % 8 == 3 ? FUZZ_RESULT_FAIL : FUZZ_RESULT_OK);
+}
+
+// Run shard INDEX of COUNT of a small run of sometimes_fails, and put its
+// report in *REPORT.
+static bool
+run_shard(size_t index, size_t count, struct fuzz_report* report)
+{
+	const struct fuzz_type_info* u64 =
+			fuzz_get_builtin_type_info(FUZZ_BUILTIN_uint64_t);
+	struct fuzz_run_config config = {
+			.name                 = "sometimes fails",
+			.prop1                = sometimes_fails,
+			.type_info            = {u64},
+			.trials               = 64,
+			.seed                 = 0x5eed,
+			.shard_index          = index,
+			.shard_count          = count,
+			.report               = report,
+			.hooks.pre_run        = quiet_pre_run,
+			.hooks.post_trial     = quiet_trial_post,
+			.hooks.counterexample = quiet_counterexample,
+			.hooks.post_run       = quiet_post_run,
+	};
+	return fuzz_run(&config) == FUZZ_RESULT_FAIL;
+}
+
+// Write REPORT out and read it back into *COPY.
+static bool
+round_trip(const struct fuzz_report* report, struct fuzz_report* copy)
+{
+	FILE* f = tmpfile();
+	if (f == NULL) {
+		return false;
+	}
+	const bool ok = fuzz_report_write(f, report) &&
+			fseek(f, 0, SEEK_SET) == 0 && fuzz_report_read(f, copy);
+	fclose(f);
+	return ok;
+}
+
+// Read a report from the text in STR into *REPORT.
+static bool
+read_string(const char* str, struct fuzz_report* report)
+{
+	FILE* f = tmpfile();
+	if (f == NULL) {
+		return false;
+	}
+	const bool ok = fputs(str, f) >= 0 && fseek(f, 0, SEEK_SET) == 0 &&
+			fuzz_report_read(f, report);
+	fclose(f);
+	return ok;
+}
+
+// Merging a shard into a report that already has it is refused, so it
+// can't be counted twice.
+static bool
+test_report_merge_same_shard_twice(void)
+{
+	struct fuzz_report shard0 = {0};
+	struct fuzz_report shard1 = {0};
+	struct fuzz_report again  = {0};
+	CHECK(run_shard(0, 2, &shard0));
+	CHECK(run_shard(1, 2, &shard1));
+	CHECK(shard0.shards == 1 && shard0.shard_indices[0] == 0);
+	CHECK(shard1.shards == 1 && shard1.shard_indices[0] == 1);
+
+	struct fuzz_report merged = {0};
+	CHECK(round_trip(&shard0, &merged));
+	CHECK(!fuzz_report_merge(&merged, &shard0));
+	CHECK(merged.shards == 1);
+	CHECK(merged.report.pass == shard0.report.pass);
+	CHECK(merged.failure_count == shard0.failure_count);
+
+	CHECK(fuzz_report_merge(&merged, &shard1));
+	CHECK(merged.shards == 2);
+	CHECK(merged.shard_indices[0] == 0 && merged.shard_indices[1] == 1);
+	CHECK(merged.report.fail == shard0.report.fail + shard1.report.fail);
+
+	// It's also refused for reports read back from files.
+	CHECK(round_trip(&shard1, &again));
+	CHECK(!fuzz_report_merge(&merged, &again));
+	CHECK(merged.report.fail == shard0.report.fail + shard1.report.fail);
+
+	fuzz_report_free(&shard0);
+	fuzz_report_free(&shard1);
+	fuzz_report_free(&again);
+	fuzz_report_free(&merged);
+	return true;
+}
+
+// Reports from before the shard indices were saved can only be merged if
+// they have every shard, the header has to be the whole first line, and
+// the shard count can't be trusted to size anything.
+static bool
+test_report_read_old_versions(void)
+{
+	struct fuzz_report part = {0};
+	struct fuzz_report all  = {0};
+	struct fuzz_report bad  = {0};
+	CHECK(read_string("fuzz-report 2\nrun_seed 0x1\nshards 1/2\n"
+			  "pass 3\nfail 0\nskip 0\ndup 0\n"
+			  "timeout 0\noom 0\ncrash 0\n",
+			&part));
+	CHECK(part.shard_indices == NULL);
+	CHECK(read_string("fuzz-report 2\nrun_seed 0x1\nshards 2/2\n"
+			  "pass 3\nfail 0\nskip 0\ndup 0\n"
+			  "timeout 0\noom 0\ncrash 0\n",
+			&all));
+	CHECK(all.shard_indices != NULL);
+	CHECK(!fuzz_report_merge(&all, &part));
+	CHECK(!read_string("fuzz-report 22\nrun_seed 0x1\nshards 1/1\n"
+			   "shard_indices 0\npass 3\nfail 0\nskip 0\n"
+			   "dup 0\ntimeout 0\noom 0\ncrash 0\n",
+			&bad));
+	CHECK(!read_string("fuzz-report 3\nrun_seed 0x1\nshards 2/2\n"
+			   "shard_indices 1 1\npass 3\nfail 0\nskip 0\n"
+			   "dup 0\ntimeout 0\noom 0\ncrash 0\n",
+			&bad));
+
+	// Shard counts too big to hold their indices are refused, and
+	// lists shorter than their count don't overrun anything.
+	CHECK(!read_string("fuzz-report 2\nrun_seed 0x1\n"
+			   "shards 2305843009213693952/2305843009213693952\n"
+			   "pass 3\nfail 0\nskip 0\ndup 0\n"
+			   "timeout 0\noom 0\ncrash 0\n",
+			&bad));
+	CHECK(!read_string("fuzz-report 3\nrun_seed 0x1\n"
+			   "shards 2305843009213693952/2305843009213693952\n"
+			   "shard_indices 0 1 2 3 4\npass 3\nfail 0\nskip 0\n"
+			   "dup 0\ntimeout 0\noom 0\ncrash 0\n",
+			&bad));
+	CHECK(!read_string("fuzz-report 3\nrun_seed 0x1\n"
+			   "shards 1000000/1000000\n"
+			   "shard_indices 0 1 2 3 4\npass 3\nfail 0\nskip 0\n"
+			   "dup 0\ntimeout 0\noom 0\ncrash 0\n",
+			&bad));
+
+	fuzz_report_free(&part);
+	fuzz_report_free(&all);
+	return true;
+}
+
+// Seeds and results of the first trials of run_chained, recorded before
+// the next chained seed was ever drawn before shrinking had finished.
+static const struct {
+	uint64_t seed;
+	bool     fails;
+} chained_trials[] = {
+		{0x0000000000005eed, false}, {0x52c113cd1708e4b7, false},
+		{0xade6d68c91c88b85, false}, {0x6150227ff7949703, false},
+		{0xdb9d7f96aad6a1a9, false}, {0x0cdf210265aaed3f, false},
+		{0x0cb2c23482e14f4e, false}, {0x068504f9ac5b9fc4, false},
+		{0xd58612e0ca70f997, true},  {0x5861aa4ceebaba4b, true},
+		{0x9be19c24e6d7899a, true},  {0x4e8980961a070986, false},
+		{0xdc495d455ce1d568, false}, {0xfd8d6a2669c90191, false},
+		{0x71d82a1407779d2a, false}, {0xed3c85fd89e02d92, false},
+		{0x184bc6bc694fe74e, true},  {0xe65848e7c64f0ce0, false},
+		{0x032075d3e5d28da5, false}, {0x2cbc28bdacfb56a5, false},
+		{0xef959fde76635f92, false}, {0x05380558a4e257b7, false},
+		{0x9384f91d04e9ca81, false}, {0xbad0ae208f141641, false},
+};
+
+#define CHAINED_TRIALS (sizeof(chained_trials) / sizeof(chained_trials[0]))
+
+// What run_chained saw, from its hooks.
+struct chained_log {
+	uint64_t seeds[CHAINED_TRIALS];
+	int      results[CHAINED_TRIALS];
+	size_t   posts;
+	uint64_t counterexamples[CHAINED_TRIALS];
+	size_t   counterexample_count;
+};
+
+static int
+chained_trial_post(const struct fuzz_post_trial_info* info, void* env)
+{
+	struct chained_log* log = env;
+	if (info->trial_id < CHAINED_TRIALS) {
+		log->seeds[info->trial_id]   = info->trial_seed;
+		log->results[info->trial_id] = info->result;
+	}
+	log->posts++;
+	return FUZZ_HOOK_RUN_CONTINUE;
+}
+
+static int
+chained_counterexample(const struct fuzz_counterexample_info* info, void* env)
+{
+	struct chained_log* log = env;
+	if (log->counterexample_count < CHAINED_TRIALS) {
+		log->counterexamples[log->counterexample_count++] =
+				*(uint64_t*)info->args[0];
+	}
+	return FUZZ_HOOK_RUN_CONTINUE;
+}
+
+static int
+alloc_u64(struct fuzz* t, void* env, void** output)
+{
+	(void)env;
+	uint64_t* x = malloc(sizeof(*x));
+	if (x == NULL) {
+		return FUZZ_RESULT_ERROR;
+	}
+	*x      = fuzz_random_bits(t, 64);
+	*output = x;
+	return FUZZ_RESULT_OK;
+}
+
+static void
+free_u64(void* instance, void* env)
+{
+	(void)env;
+	free(instance);
+}
+
+// Shrink tactics that draw from the PRNG, so the seeds of the trials after
+// a failure depend on how it was shrunk.
+static int
+shrink_u64_randomly(struct fuzz* t, const void* instance, uint32_t tactic,
+		void* env, void** output)
+{
+	(void)env;
+	const uint64_t x = *(const uint64_t*)instance;
+	uint64_t       y;
+	switch (tactic) {
+	case 0:
+		if (x < 11) {
+			return FUZZ_SHRINK_DEAD_END;
+		}
+		y = ((x >> 3) >> (1 + fuzz_random_bits(t, 2))) * 8 + 3;
+		break;
+	case 1:
+		if (x == 0) {
+			return FUZZ_SHRINK_DEAD_END;
+		}
+		y = x >> 1;
+		break;
+	case 2:
+		if (x == 0) {
+			return FUZZ_SHRINK_DEAD_END;
+		}
+		y = x - 1 - fuzz_random_bits(t, 8) % x;
+		break;
+	default:
+		return FUZZ_SHRINK_NO_MORE_TACTICS;
+	}
+
+	uint64_t* out = malloc(sizeof(*out));
+	if (out == NULL) {
+		return FUZZ_SHRINK_ERROR;
+	}
+	*out    = y;
+	*output = out;
+	return FUZZ_SHRINK_OK;
+}
+
+// Run sometimes_fails with the chained schedule on THREADS threads and
+// WORKERS forked workers, and check every trial got the seed and result
+// it always has.
+static bool
+run_chained(size_t threads, size_t workers)
+{
+	static const struct fuzz_type_info type_info = {
+			.alloc  = alloc_u64,
+			.free   = free_u64,
+			.shrink = shrink_u64_randomly,
+	};
+	struct chained_log     log    = {0};
+	struct fuzz_run_config config = {
+			.name                 = "chained",
+			.prop1                = sometimes_fails,
+			.type_info            = {&type_info},
+			.trials               = CHAINED_TRIALS,
+			.seed                 = 0x5eed,
+			.rng                  = FUZZ_RNG_MT19937,
+			.threads              = threads,
+			.fork.enable          = (workers > 0),
+			.fork.workers         = workers,
+			.hooks.pre_run        = quiet_pre_run,
+			.hooks.post_trial     = chained_trial_post,
+			.hooks.counterexample = chained_counterexample,
+			.hooks.post_run       = quiet_post_run,
+			.hooks.env            = &log,
+	};
+	CHECK(fuzz_run(&config) == FUZZ_RESULT_FAIL);
+	CHECK(log.posts == CHAINED_TRIALS);
+
+	size_t fails = 0;
+	for (size_t i = 0; i < CHAINED_TRIALS; i++) {
+		const int result = (chained_trials[i].fails ? FUZZ_RESULT_FAIL
+							    : FUZZ_RESULT_OK);
+		CHECK(log.seeds[i] == chained_trials[i].seed);
+		CHECK(log.results[i] == result);
+		fails += chained_trials[i].fails;
+	}
+	CHECK(log.counterexample_count == fails);
+	for (size_t i = 0; i < log.counterexample_count; i++) {
+		CHECK(log.counterexamples[i] == 3);
+	}
+	return true;
+}
+
+// With the chained schedule, each trial's seed is drawn once the trial
+// before it has been shrunk, so runs on several threads or workers have
+// to get the same seeds as a serial one, and as they always have.
+static bool
+test_chained_seeds_match_earlier_runs(void)
+{
+	CHECK(run_chained(0, 0));
+	CHECK(run_chained(0, 4));
+	CHECK(run_chained(4, 0));
+	return true;
+}
+
+// The properties below misbehave for about one argument in four.
+static bool
+misbehaves(const void* arg)
+{
+	return *(const uint64_t*)arg % 4 == 0;
+}
+
+static int
+sleeps_too_long(struct fuzz* f, void* arg)
+{
+	(void)f;
+	if (misbehaves(arg)) {
+		sleep(10);
+	}
+	return FUZZ_RESULT_OK;
+}
+
+static int
+spins_forever(struct fuzz* f, void* arg)
+{
+	(void)f;
+	for (volatile uint64_t i = 0; misbehaves(arg); i++) {
+	}
+	return FUZZ_RESULT_OK;
+}
+
+// Sanitizers reserve too much address space for fork.memory_limit to work,
+// and report failed allocations themselves, so the OOM test is skipped
+// under them.
+#if defined(__SANITIZE_ADDRESS__) || defined(__SANITIZE_THREAD__)
+#define TEST_OOM false
+#else
+#define TEST_OOM true
+#endif
+
+static int
+uses_too_much_memory(struct fuzz* f, void* arg)
+{
+	(void)f;
+	if (misbehaves(arg)) {
+		char* p = malloc((size_t)1 << 30);
+		if (p == NULL) {
+			abort(); // with errno still ENOMEM
+		}
+		memset(p, 0xff, (size_t)1 << 30);
+		free(p);
+	}
+	return FUZZ_RESULT_OK;
+}
+
+static int
+segfaults(struct fuzz* f, void* arg)
+{
+	(void)f;
+	if (misbehaves(arg)) {
+		raise(SIGSEGV);
+	}
+	return FUZZ_RESULT_OK;
+}
+
+// A property that misbehaves, the fork limits that catch it, and the
+// result that should give.
+struct misbehaviour {
+	int (*prop)(struct fuzz* f, void* arg);
+	size_t trials;
+	size_t timeout;
+	size_t memory_limit;
+	size_t cpu_limit;
+	int    expected;
+};
+
+// What run_misbehaving saw, from its hooks.
+struct misbehaviour_log {
+	int                    expected;
+	size_t                 trials;
+	size_t                 bad; // trials whose argument misbehaves
+	bool                   wrong_result;
+	struct fuzz_run_report report;
+};
+
+static int
+misbehaviour_trial_post(const struct fuzz_post_trial_info* info, void* env)
+{
+	struct misbehaviour_log* log = env;
+	const bool               bad = misbehaves(info->args[0]);
+	log->trials++;
+	log->bad += bad;
+	if (info->result != (bad ? log->expected : FUZZ_RESULT_OK)) {
+		log->wrong_result = true;
+	}
+	return FUZZ_HOOK_RUN_CONTINUE;
+}
+
+static int
+misbehaviour_post_run(const struct fuzz_post_run_info* info, void* env)
+{
+	struct misbehaviour_log* log = env;
+	log->report                  = info->report;
+	return FUZZ_HOOK_RUN_CONTINUE;
+}
+
+// Run M in worker processes, either several at once or one persistent
+// one, and check every trial whose argument misbehaves gets M's expected
+// result, and the others pass. The run's counters are put in *REPORT.
+static bool
+run_misbehaving(const struct misbehaviour* m, bool persistent,
+		struct fuzz_run_report* report)
+{
+	// Without a shrink callback, failures are reported as they are.
+	static const struct fuzz_type_info type_info = {
+			.alloc = alloc_u64,
+			.free  = free_u64,
+	};
+	struct misbehaviour_log log    = {.expected = m->expected};
+	struct fuzz_run_config  config = {
+			.name                 = "misbehaving",
+			.prop1                = m->prop,
+			.type_info            = {&type_info},
+			.trials               = m->trials,
+			.seed                 = 0x5eed,
+			.fork.enable          = true,
+			.fork.workers         = (persistent ? 0 : 4),
+			.fork.persistent      = persistent,
+			.fork.timeout         = m->timeout,
+			.fork.memory_limit    = m->memory_limit,
+			.fork.cpu_limit       = m->cpu_limit,
+			.hooks.pre_run        = quiet_pre_run,
+			.hooks.post_trial     = misbehaviour_trial_post,
+			.hooks.counterexample = quiet_counterexample,
+			.hooks.post_run       = misbehaviour_post_run,
+			.hooks.env            = &log,
+	};
+	CHECK(fuzz_run(&config) == FUZZ_RESULT_FAIL);
+	CHECK(log.trials == m->trials);
+	CHECK(log.bad > 0 && log.bad < m->trials);
+	CHECK(!log.wrong_result);
+	CHECK(log.report.pass == m->trials - log.bad);
+	CHECK(log.report.fail == log.bad);
+	*report = log.report;
+	return true;
+}
+
+// Calls that run past fork.timeout, or use up fork.cpu_limit and get
+// SIGXCPU, are timeouts, whether the worker is one of several or
+// persistent. Spinning takes a while, so there are fewer of those trials.
+static bool
+test_timeout_result(void)
+{
+	const struct misbehaviour sleeps = {
+			.prop     = sleeps_too_long,
+			.trials   = 16,
+			.timeout  = 100,
+			.expected = FUZZ_RESULT_TIMEOUT,
+	};
+	const struct misbehaviour spins = {
+			.prop      = spins_forever,
+			.trials    = 4,
+			.cpu_limit = 1,
+			.expected  = FUZZ_RESULT_TIMEOUT,
+	};
+	for (int persistent = 0; persistent < 2; persistent++) {
+		struct fuzz_run_report report;
+		CHECK(run_misbehaving(&sleeps, persistent, &report));
+		CHECK(report.timeout == report.fail);
+		CHECK(report.oom == 0 && report.crash == 0);
+
+		CHECK(run_misbehaving(&spins, persistent, &report));
+		CHECK(report.timeout == report.fail);
+		CHECK(report.oom == 0 && report.crash == 0);
+	}
+	return true;
+}
+
+// Calls that crash after running out of fork.memory_limit are OOM.
+static bool
+test_oom_result(void)
+{
+	const struct misbehaviour m = {
+			.prop         = uses_too_much_memory,
+			.trials       = 16,
+			.memory_limit = (size_t)64 << 20,
+			.expected     = FUZZ_RESULT_OOM,
+	};
+	for (int persistent = 0; TEST_OOM && persistent < 2; persistent++) {
+		struct fuzz_run_report report;
+		CHECK(run_misbehaving(&m, persistent, &report));
+		CHECK(report.oom == report.fail);
+		CHECK(report.timeout == 0 && report.crash == 0);
+	}
+	return true;
+}
+
+// Calls killed by a signal are crashes, with the signal.
+static bool
+test_crash_result(void)
+{
+	const struct misbehaviour m = {
+			.prop     = segfaults,
+			.trials   = 16,
+			.expected = FUZZ_RESULT_CRASH(SIGSEGV),
+	};
+	for (int persistent = 0; persistent < 2; persistent++) {
+		struct fuzz_run_report report;
+		CHECK(run_misbehaving(&m, persistent, &report));
+		CHECK(report.crash == report.fail);
+		CHECK(report.timeout == 0 && report.oom == 0);
+	}
+	return true;
+}
+
+static int
+report_post_run(const struct fuzz_post_run_info* info, void* env)
+{
+	struct fuzz_run_report* report = env;
+	*report                        = info->report;
+	return FUZZ_HOOK_RUN_CONTINUE;
+}
+
+// Run sometimes_fails as NAME, saving its dedup filter at PATH, and put
+// its counters in *REPORT.
+static bool
+run_dedup(const char* name, const char* path, struct fuzz_run_report* report)
+{
+	const struct fuzz_type_info* u64 =
+			fuzz_get_builtin_type_info(FUZZ_BUILTIN_uint64_t);
+	struct fuzz_run_config config = {
+			.name                 = name,
+			.prop1                = sometimes_fails,
+			.type_info            = {u64},
+			.trials               = 64,
+			.seed                 = 0x5eed,
+			.dedup_path           = path,
+			.hooks.pre_run        = quiet_pre_run,
+			.hooks.post_trial     = quiet_trial_post,
+			.hooks.counterexample = quiet_counterexample,
+			.hooks.post_run       = report_post_run,
+			.hooks.env            = report,
+	};
+	return fuzz_run(&config) == FUZZ_RESULT_FAIL;
+}
+
+// A run with the same dedup_path as an earlier one skips the arguments
+// that passed there, but tries the failing ones again. Filters saved by
+// another property, or cut short, are ignored.
+static bool
+test_dedup_saved_between_runs(void)
+{
+	char path[] = "/tmp/fuzz-test-dedup-XXXXXX";
+	int  fd     = mkstemp(path);
+	CHECK(fd != -1);
+	close(fd);
+	unlink(path);
+
+	struct fuzz_run_report first;
+	struct fuzz_run_report again;
+	CHECK(run_dedup("dedup", path, &first));
+	CHECK(first.pass > 0 && first.fail > 0);
+	CHECK(run_dedup("dedup", path, &again));
+	CHECK(again.pass == 0);
+	CHECK(again.dup == first.dup + first.pass);
+	CHECK(again.fail == first.fail);
+
+	// Another property's filter is ignored, and replaced by its own.
+	struct fuzz_run_report other;
+	CHECK(run_dedup("other", path, &other));
+	CHECK(other.pass == first.pass && other.dup == first.dup);
+	CHECK(run_dedup("dedup", path, &again));
+	CHECK(again.pass == first.pass && again.dup == first.dup);
+
+	// So is a truncated file.
+	struct stat st;
+	CHECK(stat(path, &st) == 0 && st.st_size > 1);
+	CHECK(truncate(path, st.st_size - 1) == 0);
+	CHECK(run_dedup("dedup", path, &again));
+	CHECK(again.pass == first.pass && again.dup == first.dup);
+
+	unlink(path);
+	return true;
+}
+
+static const struct {
+	const char* name;
+	bool (*fun)(void);
+} tests[] = {
+		{"report_merge_same_shard_twice",
+				test_report_merge_same_shard_twice},
+		{"report_read_old_versions", test_report_read_old_versions},
+		{"chained_seeds_match_earlier_runs",
+				test_chained_seeds_match_earlier_runs},
+		{"timeout_result", test_timeout_result},
+		{"oom_result", test_oom_result},
+		{"crash_result", test_crash_result},
+		{"dedup_saved_between_runs", test_dedup_saved_between_runs},
+};
+
+int
+main(void)
+{
+	int failed = 0;
+	for (size_t i = 0; i < sizeof(tests) / sizeof(tests[0]); i++) {
+		printf("%s\n", tests[i].name);
+		if (!tests[i].fun()) {
+			failed++;
+		}
+	}
+	printf("%d failed\n", failed);
+	return failed;
+}